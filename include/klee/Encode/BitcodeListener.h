@@ -48,6 +48,10 @@ public:
   virtual void afterExecuteInstruction(ExecutionState &state, KInstruction *ki) = 0;
   virtual void afterRunMethodAsMain(ExecutionState &state) = 0;
   virtual void executionFailed(ExecutionState &state, KInstruction *ki) = 0;
+
+  // drops the shadow objects and frames, which refer to memory objects of
+  // the execution
+  void releaseShadowMemory();
 };
 
 } // namespace klee
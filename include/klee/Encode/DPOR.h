@@ -0,0 +1,109 @@
+//===-- DPOR.h --------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Dynamic partial-order reduction over the trace of an execution. The events
+// of the path get vector clocks of the happens-before order made of program
+// order, thread creation and join, and the dependences between conflicting
+// events: accesses to one global variable of which one is a write, and the
+// operations on one mutex, condition variable or barrier. Two conflicting
+// events of different threads that are not ordered otherwise race. The
+// reversed race goes to the schedule set as a prefix: the path before the
+// first event, then the events the second one depends on, then the second
+// one. Races on variables and on the acquisition of a mutex are reversed, the
+// waits, signals and barriers only order the events.
+//
+// As in source-DPOR, a reversal is only worth a new execution if none of the
+// threads that may run first after the prefix, its initials, was explored at
+// the state before the race already. The coordinator keeps the backtrack set
+// of every such state, keyed by a hash of its steps: the thread the trace ran
+// there and the first initial of every reversal it scheduled there. Within a
+// trace, the reversals at one state and the threads asleep there are checked
+// as well. A DPOR prefix carries its sleep set to the execution it starts:
+// the threads already explored at its state whose next events commute with
+// the ones the prefix runs. A thread stays asleep until it runs or an event
+// conflicts with its next one, and no race is reversed towards it meanwhile.
+
+#ifndef LIB_ENCODE_DPOR_H_
+#define LIB_ENCODE_DPOR_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "klee/Encode/Prefix.h"
+#include "klee/Encode/RuntimeDataManager.h"
+#include "klee/Encode/Trace.h"
+#include "klee/Thread/VectorClock.h"
+
+namespace klee {
+
+class DPOR {
+private:
+  enum AccessKind { Read, Write, Lock, Unlock, Sync, None };
+  struct Access {
+    AccessKind kind;
+    unsigned object;
+  };
+  // the second event may run before the first one, after the events whose
+  // step in their thread is within limit
+  struct Race {
+    unsigned first;
+    unsigned second;
+    VectorClock limit;
+  };
+  // the latest events on an object before the current position of the path
+  struct ObjectState {
+    int lastWrite;
+    std::vector<unsigned> readsSinceWrite;
+    int lastLock;
+    int lastOperation; // the last lock, unlock or synchronization
+    ObjectState() : lastWrite(-1), lastLock(-1), lastOperation(-1) {}
+  };
+
+  RuntimeDataManager *runtimeData;
+  Trace *trace;
+  std::unordered_map<std::string, unsigned> objectIds;
+  std::vector<uint64_t> objectKeys;          // hash of the key of each object, the same in every trace
+  std::vector<std::vector<Access>> accesses; // by position in the path
+  std::vector<VectorClock> clocks;           // of the events with accesses
+  std::vector<unsigned> steps;               // step of every event in its thread, from 1
+  std::vector<Race> races;
+  std::vector<uint64_t> states; // hash of the visible steps before each position
+
+  unsigned getObjectId(const std::string &key);
+  void collectAccesses();
+  void computeRaces(unsigned from, unsigned reversed);
+  void computeStates();
+  void getKeptEvents(Race &race, std::vector<unsigned> &kept);
+  void getInitials(std::vector<unsigned> &kept, std::vector<unsigned> &initials);
+  bool conflicts(const Prefix::SleepAccess &sleeping, unsigned pos);
+  void wake(std::vector<Prefix::SleepAccess> &sleep, unsigned pos);
+  void addSleeping(std::vector<Prefix::SleepAccess> &sleep, unsigned threadId, unsigned from);
+  void addPrefix(Race &race, std::vector<unsigned> &kept, std::vector<unsigned> &initials,
+                 std::vector<Prefix::SleepAccess> &sleep);
+
+public:
+  DPOR(RuntimeDataManager *data);
+  virtual ~DPOR();
+  // Adds a prefix for the races of the current trace that lead to a new
+  // execution, prefix is the one the trace was replayed from, if any. The
+  // races among the events a flipped branch replays were reversed on the
+  // trace the prefix was computed from. A DPOR prefix reorders the events
+  // from the race it reverses on, their races are checked again except that
+  // race, which is not reversed back.
+  void addRacePrefixes(Prefix *prefix);
+  // number of races addRacePrefixes found, reversed or not
+  unsigned getRaceNumber();
+  // number of events of the path replayed by the given steps of a prefix
+  static unsigned getReplayedEvents(Trace *trace, unsigned prefixSteps);
+};
+
+} /* namespace klee */
+
+#endif /* LIB_ENCODE_DPOR_H_ */
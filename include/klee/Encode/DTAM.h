@@ -10,12 +10,16 @@
 #ifndef LIB_CORE_DTAM_
 #define LIB_CORE_DTAM_
 
-#include <map>
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <set>
 #include <string>
 #include <sys/time.h>
+#include <unordered_map>
+#include <vector>
 
-#include "klee/Encode/DTAMPoint.h"
+#include "klee/Encode/Event.h"
 #include "klee/Encode/FilterSymbolicExpr.h"
 #include "klee/Encode/RuntimeDataManager.h"
 #include "klee/Encode/Trace.h"
@@ -24,22 +28,40 @@ namespace klee {
 
 class DTAM {
 private:
+  // taint flows from a node to its targets, in compressed sparse row form:
+  // the targets of node n are targets[offsets[n]] to targets[offsets[n + 1] - 1]
+  struct Graph {
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+  };
+
   RuntimeDataManager *runtimeData;
   Trace *trace;
-  std::map<std::string, DTAMPoint *> allWrite;
-  std::map<std::string, DTAMPoint *> allRead;
+  // the nodes are the global reads, then the global writes, of the trace
+  std::vector<Event *> nodes;
+  unsigned readNum;
+  std::unordered_map<std::string, unsigned> readIds;
+  // a read taints the writes computed from it, a write taints the reads of its variable
+  std::vector<std::pair<unsigned, unsigned>> edges;
+  Graph parallelGraph;
+  Graph hybridGraph;
+  std::unique_ptr<std::atomic<bool>[]> taint;
   struct timeval start, finish;
   double cost;
   FilterSymbolicExpr filter;
 
+  void buildGraph(Graph &graph, const std::vector<bool> &keep);
+  void expand(const Graph &graph, const std::vector<unsigned> &frontier, std::size_t begin, std::size_t end,
+              std::vector<unsigned> &next);
+
 public:
   DTAM(RuntimeDataManager *data);
   virtual ~DTAM();
 
   void prepareDTAMParallel();
   void prepareDTAMhybrid();
-  void initTaint(std::vector<DTAMPoint *> &remainPoint);
-  void propagateTaint(std::vector<DTAMPoint *> &remainPoint);
+  void initTaint(std::vector<unsigned> &frontier);
+  void propagateTaint(const Graph &graph, std::vector<unsigned> &frontier);
   void logTaint(std::set<std::string> &taint);
   void work();
 };
@@ -10,15 +10,19 @@
 #ifndef ENCODE_H_
 #define ENCODE_H_
 
+#include <set>
 #include <stack>
+#include <unordered_map>
 #include <utility>
 #include <z3++.h>
 
 #include "klee/Encode/Event.h"
 #include "klee/Encode/FilterSymbolicExpr.h"
+#include "klee/Encode/IncrementalSolver.h"
 #include "klee/Encode/KQuery2Z3.h"
 #include "klee/Encode/RuntimeDataManager.h"
 #include "klee/Encode/Trace.h"
+#include "klee/Thread/VectorClock.h"
 #include "klee/Core/Interpreter.h"
 
 enum InstType { NormalOp, GlobalVarOp, ThreadOp };
@@ -28,27 +32,43 @@ using namespace std;
 namespace klee {
 
 class Encode {
+  // checks the private passes on hand-built traces
+  friend class EncodeTest;
+
 private:
   RuntimeDataManager *runtimeData;
   InterpreterHandler *interpreterHandler;
   // all data about encoding
   Trace *trace;
-  context z3_ctx;
-  solver z3_solver;
+  // context and solver shared with the encoders of other traces
+  IncrementalSolver *incrementalSolver;
+  context &z3_ctx;
+  solver &z3_solver;
   solver z3_taint_solver;
+  // translator of the symbolic expressions of this trace, caches shared subtrees
+  KQuery2Z3 kq;
+  // guards enabling the formulas of this trace in z3_solver, and the formulas themselves
+  expr_vector traceGuards;
+  vector<expr> traceFormulas;
+  std::set<unsigned> traceGuardIds;
   FilterSymbolicExpr filter;
   unsigned formulaNum;
+  unsigned reusedFormulaNum;
   unsigned solvingTimes;
 
 public:
-  Encode(RuntimeDataManager *data, InterpreterHandler *ih) : runtimeData(data), z3_solver(z3_ctx), z3_taint_solver(z3_ctx) {
+  Encode(RuntimeDataManager *data, InterpreterHandler *ih, IncrementalSolver *is)
+      : runtimeData(data), incrementalSolver(is), z3_ctx(is->getContext()), z3_solver(is->getSolver()),
+        z3_taint_solver(z3_ctx), kq(z3_ctx), traceGuards(z3_ctx) {
     interpreterHandler = ih;
     trace = data->getCurrentTrace();
     formulaNum = 0;
+    reusedFormulaNum = 0;
     solvingTimes = 0;
   }
   ~Encode() {
     runtimeData->allFormulaNum += formulaNum;
+    runtimeData->reusedFormulaNum += reusedFormulaNum;
     runtimeData->solvingTimes += solvingTimes;
   }
   void encodeTraceToFormulas();
@@ -82,16 +102,35 @@ private:
   void buildOutputFormula();
 
   expr buildExprForConstantValue(Value *V, bool isLeft, string prefix);
+  void addFormula(solver &s, const expr &formula);
 
   void concretizeReadValue(Event *curr);
 
+  // outcome of negating one branch
+  struct FlipResult {
+    bool presolve;           // false if the branch was filtered out before solving
+    bool solved;             // false if the solver threw
+    check_result result;
+    double cost;
+    vector<Event *> vecEvent; // prefix events if result is sat
+    std::string error;
+    FlipResult() : presolve(true), solved(false), result(z3::unknown), cost(0) {}
+  };
+  void buildFlipFormulas(vector<expr> &keepFormulas, vector<expr> &flipFormulas);
+  void flipIfBranchesInParallel(unsigned threadNum, vector<expr> &keepFormulas, vector<expr> &flipFormulas);
+  void flipIfBranch(unsigned i, solver &s, vector<expr> &assumptions, FlipResult &flip);
+  Prefix *reportFlipResult(unsigned i, FlipResult &flip);
+
 private:
   void markLatestWriteForGlobalVar();
 
   map<string, Event *> latestWriteOneThread;
   map<int, map<string, Event *>> allThreadLastWrite;
-  // int:eventid.add data in function buildMemoryModelFormula
-  map<string, expr> eventNameInZ3;
+  // key--orderId of the events ordered in buildMemoryModelFormula
+  unordered_map<unsigned, expr> eventOrderInZ3;
+  // order variables indexed by orderId, built on first use
+  vector<expr> orderExprs;
+  expr getOrderExpr(Event *event);
   z3::sort llvmTy_to_z3Ty(const Type *typ);
 
   // key--local var, value--index..like ssa
@@ -99,15 +138,21 @@ private:
   expr makeExprsOr(vector<expr> exprs);
   expr makeExprsSum(vector<expr> exprs);
   expr enumerateOrder(Event *read, Event *write, Event *anotherWrite);
+  // vector clocks of the happens-before relation every schedule of the trace
+  // respects, indexed by eventId; an empty clock means unknown
+  vector<VectorClock> mustClocks;
+  void computeMustHappenBefore();
+  bool mustHappenBefore(Event *first, Event *second);
+  bool pruneMayBeRead(Event *read, vector<Event *> &mayBeRead);
   expr readFromWriteFormula(Event *read, Event *write, string var);
   bool readFromInitFormula(Event *read, expr &ret);
 
   expr taintReadFromWriteFormula(Event *read, Event *write, string var);
   bool taintReadFromInitFormula(Event *read, expr &ret);
 
-  void computePrefix(vector<Event *> &vecEvent, Event *ifEvent);
+  void computePrefix(vector<Event *> &vecEvent, Event *ifEvent, model &m);
   void printAssertionInfo();
-  void printPrefixInfo(Prefix *prefix, Event *ifEvent);
+  void printPrefixInfo(Prefix *prefix, vector<Event *> &orderedEventList);
   void printSolvingSolution(Prefix *prefix, expr ifExpr);
 
   void printSourceLine(string fileName, vector<Event *> &trace);
@@ -13,6 +13,7 @@
 #include "klee/ADT/Ref.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Module/KInstruction.h"
+#include "klee/Thread/VectorClock.h"
 
 #include <llvm/IR/Function.h>
 
@@ -34,6 +35,8 @@ public:
   unsigned eventId;
   unsigned threadEventId;
   std::string eventName;
+  // id of the order variable named by eventName, shared by the events clustered into one step
+  unsigned orderId;
   KInstruction *inst;
   // name of load or store variable
   std::string name; 
@@ -48,11 +51,13 @@ public:
   bool isConditionInst; 
   // Br's condition          
   bool brCondition; 
+  // a step of the prefixes, see Executor::isVisibleInstruction
+  bool isVisible;
   // only use by call, whether the called function is defined by user              
   bool isFunctionWithSourceCode; 
   // set for called function. all callinst use it.@14.12.02 
   llvm::Function *calledFunction; 
-  std::vector<unsigned> vectorClock;
+  VectorClock vectorClock;
   std::vector<ref<klee::Expr>> instParameter;
   std::vector<ref<klee::Expr>> relatedSymbolicExpr;
 
@@ -61,6 +66,10 @@ public:
         std::string globalVarFullName, EventType eventType);
   virtual ~Event();
   std::string toString();
+  void shareOrderWith(Event *event) {
+    orderId = event->orderId;
+    eventName = event->eventName;
+  }
 };
 
 } /* namespace klee */
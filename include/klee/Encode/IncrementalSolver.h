@@ -0,0 +1,67 @@
+//===-- IncrementalSolver.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// A z3 context and solver shared by the Encode objects of all traces. Every
+// trace formula is asserted once as "guard => formula" and enabled per check
+// through the guard literal, so the formulas shared by consecutive traces (e.g.
+// the memory model and partial order of a common prefix) are not re-asserted
+// and the solver keeps what it has learnt about them.
+//
+// A guard that no trace has used for a while is retired by asserting its
+// negation, and once the retired guards outnumber the live ones the solver is
+// rebuilt from the live implications. So the solver follows the recent traces
+// instead of growing with every trace explored.
+
+#ifndef INCREMENTALSOLVER_H_
+#define INCREMENTALSOLVER_H_
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <z3++.h>
+
+namespace klee {
+
+class IncrementalSolver {
+private:
+  z3::context z3_ctx;
+  z3::solver z3_solver;
+  struct Guard {
+    z3::expr formula;
+    z3::expr literal;
+    unsigned lastUse; // number of the last trace that used the guard
+  };
+  // key--ast id of the formula
+  std::unordered_map<unsigned, Guard> guards;
+  // ast ids of the guards asserted in each open backtracking point
+  std::vector<std::vector<unsigned>> scopes;
+  unsigned nextGuardId;
+  unsigned traceNum;
+  unsigned retiredNum; // guards retired since the solver was last rebuilt
+
+  void rebuild();
+
+public:
+  IncrementalSolver();
+  ~IncrementalSolver();
+
+  z3::context &getContext();
+  z3::solver &getSolver();
+  // return the guard literal enabling formula, asserting the implication if it is new.
+  // isReused--whether the implication had been asserted before
+  z3::expr getGuard(const z3::expr &formula, bool &isReused);
+  // called before the encoding of every trace, retires the guards that were
+  // not used for -kleem-guard-lifetime traces
+  void startTrace();
+  void push();
+  void pop();
+};
+
+} // namespace klee
+
+#endif /* INCREMENTALSOLVER_H_ */
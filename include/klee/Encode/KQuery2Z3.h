@@ -20,6 +20,7 @@
 #include <assert.h>
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include <z3++.h>
 #include <z3.h>
@@ -35,11 +36,29 @@ typedef struct fraction {
 
 class KQuery2Z3 {
 private:
+  // a translated node, kept together with the float flags it was built with.
+  // The ref keeps the node alive so that its address is not reused.
+  struct CacheEntry {
+    ref<Expr> expr;
+    unsigned floatMask;
+    unsigned generation;
+    z3::expr result;
+    CacheEntry(const ref<Expr> &e, unsigned mask, unsigned gen, const z3::expr &r)
+        : expr(e), floatMask(mask), generation(gen), result(r) {}
+  };
+
   // preserve for some private variable and function
   std::vector<ref<Expr>> kqueryExpr;
-  // the parameter convert means convert a none float point to a float point.
+  // memoized translation, shared subtrees of a trace are converted only once
   z3::expr eachExprToZ3(ref<Expr> &ele);
+  // the parameter convert means convert a none float point to a float point.
+  z3::expr translate(ref<Expr> &ele);
+  void markFloat(ref<Expr> &e);
+  unsigned getFloatMask(const ref<Expr> &e);
   z3::context &z3_ctx;
+  std::unordered_map<const Expr *, CacheEntry> cache;
+  // bumped whenever a float flag is set, which invalidates the cache
+  unsigned generation;
   std::vector<z3::expr> vecZ3Expr;
   std::vector<z3::expr> vecZ3ExprTest;
   std::vector<ref<Expr>> kqueryExprTest;
@@ -10,6 +10,7 @@
 #ifndef LIB_CORE_LISTENERSERVICE_H_
 #define LIB_CORE_LISTENERSERVICE_H_
 
+#include <unordered_map>
 #include <vector>
 
 #include "../../lib/Core/ExecutionState.h"
@@ -19,6 +20,8 @@
 namespace klee {
 class DTAM;
 class Encode;
+class IncrementalSolver;
+class TraceLogWriter;
 } /* namespace klee */
 
 namespace klee {
@@ -30,10 +33,39 @@ private:
   RuntimeDataManager *rdManager;
   InterpreterHandler *interpreterHandler;
   Encode *encoder;
+  IncrementalSolver *incrementalSolver; // solver shared by the encoders of all traces
   DTAM *dtam;
+  TraceLogWriter *traceLog; // NULL unless -kleem-trace-log
   struct timeval start, finish;
   double cost;
 
+  // what the listeners' shadow execution does at a call site
+  enum CallKind {
+    DefinedCall,
+    PthreadCreateCall,
+    MallocCall,
+    FreeCall,
+    CallocCall,
+    ReallocCall,
+    ExternalCall,
+    VaStartCall,
+    IntrinsicCall
+  };
+  struct CallInfo {
+    llvm::Function *function;
+    CallKind kind;
+    bool isDebugInfo;
+    bool castArguments; // the called value has another type than the function
+  };
+  std::unordered_map<KInstruction *, CallInfo> callInfos;
+
+  const CallInfo &getCallInfo(Executor *executor, ExecutionState &state, KInstruction *ki);
+  void bindShadowArguments(Executor *executor, ExecutionState &state, KInstruction *ki, const CallInfo &call,
+                           BitcodeListener *listener);
+  void returnInShadow(Executor *executor, ExecutionState &state, KInstruction *ki);
+  void callInShadow(Executor *executor, ExecutionState &state, KInstruction *ki, const CallInfo &call,
+                    BitcodeListener *bit);
+
 public:
   ListenerService(Executor *executor);
   ~ListenerService();
@@ -54,7 +86,10 @@ public:
   void executionFailed(ExecutionState &state, KInstruction *ki);
 
   void startControl(Executor *executor);
+  void resumeControl(Executor *executor, unsigned step);
   void endControl(Executor *executor);
+  void releaseListeners();
+  void analyzeTrace(Executor *executor, bool isUntested);
 
   void taintAnalysis();
 };
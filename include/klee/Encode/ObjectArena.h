@@ -0,0 +1,71 @@
+//===-- ObjectArena.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Arena for the objects of one trace. Objects are constructed in place in
+// chunks of growing size and are all destroyed together, so a trace with
+// millions of events costs a few allocations instead of one per event.
+
+#ifndef LIB_ENCODE_OBJECTARENA_H_
+#define LIB_ENCODE_OBJECTARENA_H_
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+template <typename T> class ObjectArena {
+private:
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+  struct Chunk {
+    std::unique_ptr<Slot[]> slots;
+    unsigned size;
+    unsigned used;
+  };
+  std::vector<Chunk> chunks;
+
+  enum { firstChunkSize = 256, maxChunkSize = 65536 };
+
+public:
+  ObjectArena() {}
+  ObjectArena(const ObjectArena &) = delete;
+  ObjectArena &operator=(const ObjectArena &) = delete;
+
+  ~ObjectArena() {
+    clear();
+  }
+
+  template <typename... Args> T *create(Args &&... args) {
+    if (chunks.empty() || chunks.back().used == chunks.back().size) {
+      unsigned size = chunks.empty() ? firstChunkSize : std::min(2 * chunks.back().size, (unsigned)maxChunkSize);
+      Chunk chunk = {std::unique_ptr<Slot[]>(new Slot[size]), size, 0};
+      chunks.push_back(std::move(chunk));
+    }
+    Chunk &chunk = chunks.back();
+    T *object = new (&chunk.slots[chunk.used]) T(std::forward<Args>(args)...);
+    chunk.used++;
+    return object;
+  }
+
+  // destroys every object and releases the memory
+  void clear() {
+    for (auto &chunk : chunks) {
+      for (unsigned i = 0; i < chunk.used; i++) {
+        reinterpret_cast<T *>(&chunk.slots[i])->~T();
+      }
+    }
+    std::vector<Chunk>().swap(chunks);
+  }
+};
+
+} /* namespace klee */
+
+#endif /* LIB_ENCODE_OBJECTARENA_H_ */
@@ -6,6 +6,13 @@
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
+// A prefix is a schedule to replay: the threads to run as runs of (thread id,
+// number of instructions), the thread ids to give to the threads created on
+// the way, and the id of every instruction so that a replay that diverges is
+// noticed. It does not refer to the events of the trace it was computed from.
+//
+// Under -kleem-visible-scheduling only the visible events are steps, the
+// thread-local instructions between them are run without being recorded.
 
 #ifndef LIB_CORE_PREFIX_H_
 #define LIB_CORE_PREFIX_H_
@@ -14,39 +21,80 @@
 #include "klee/Module/KInstruction.h"
 #include <llvm/Support/raw_ostream.h>
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace klee {
 
 class Prefix {
 public:
-  typedef std::vector<Event *>::iterator EventIterator;
+  struct Run {
+    unsigned threadId;
+    unsigned count;
+  };
+  // an access of the next event of a thread asleep at the end of a DPOR
+  // prefix, see DPOR.h
+  struct SleepAccess {
+    unsigned threadId;
+    unsigned kind;
+    uint64_t object;
+  };
 
 private:
-  std::vector<Event *> eventList;
-  std::map<Event *, uint64_t> threadIdMap;
-  EventIterator position;
+  std::vector<Run> runs;
+  std::vector<unsigned> instIds;                         // InstructionInfo id of each step
+  std::vector<std::pair<unsigned, uint64_t>> children; // (step, child thread id), ordered by step
+  unsigned branchInstId;                                 // InstructionInfo id of the last event
+  bool brCondition;                                      // recorded direction of the last event
   std::string name;
 
+  // the race a DPOR prefix reverses
+  uint64_t dporState;                  // hash of the steps before the race
+  std::vector<unsigned> dporThreads;   // the thread the trace ran there, then those the prefix may run first
+  std::vector<SleepAccess> sleepSet;
+
+  // position of the replay
+  unsigned position;
+  unsigned runIndex;
+  unsigned runOffset;
+  unsigned childIndex;
+
+  void seek(unsigned position);
+
 public:
+  Prefix(std::string name);
   Prefix(std::vector<Event *> &eventList, std::map<Event *, uint64_t> &threadIdMap, std::string name);
   virtual ~Prefix();
-  std::vector<Event *> *getEventList();
   void increasePosition();
   void reuse();
+  void rebase(Prefix &other, unsigned position);
   bool isFinished();
-  EventIterator begin();
-  EventIterator end();
-  EventIterator current();
+  unsigned size();
+  unsigned getPosition();
+  const std::vector<Run> &getRuns();
+  unsigned getCurrentRun();
+  const std::vector<unsigned> &getInstIds();
+  const std::vector<std::pair<unsigned, uint64_t>> &getChildren();
+  unsigned getBranchInstId();
+  bool getBrCondition();
   uint64_t getNextThreadId();
   unsigned getCurrentEventThreadId();
+  unsigned getCurrentInstId();
   void print(std::ostream &out);
   void print(llvm::raw_ostream &out);
-  KInstruction *getCurrentInst();
   std::string getName();
+  void setDPOR(uint64_t state, std::vector<unsigned> &threads, std::vector<SleepAccess> &sleep);
+  uint64_t getDPORState();
+  const std::vector<unsigned> &getDPORThreads();
+  const std::vector<SleepAccess> &getSleepSet();
+
+  // binary form, for the worker pipes and for files
+  void write(std::ostream &out);
+  static Prefix *read(std::istream &in);
 };
 
 } /* namespace klee */
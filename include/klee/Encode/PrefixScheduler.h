@@ -0,0 +1,193 @@
+//===-- PrefixScheduler.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LIB_ENCODE_PREFIXSCHEDULER_H_
+#define LIB_ENCODE_PREFIXSCHEDULER_H_
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "Prefix.h"
+
+namespace klee {
+
+/**
+ * Decides which prefix of the schedule set is replayed next. Prefixes that
+ * lead to an assertion failure are always taken first.
+ */
+class PrefixScheduler {
+public:
+  PrefixScheduler();
+  virtual ~PrefixScheduler();
+  // returns false if the prefix is dropped, it is deleted then
+  virtual bool addItem(Prefix *item) = 0;
+  virtual Prefix *selectNextItem() = 0;
+  virtual unsigned itemNum() = 0;
+  virtual void clear() = 0;
+  virtual void printName(std::ostream &os) = 0;
+  virtual void printAllItem(std::ostream &os) = 0;
+  bool isSchedulerEmpty() {
+    return itemNum() == 0;
+  }
+
+  enum PrefixSchedulerType
+  {
+    FIFO,
+    Coverage,
+    Shortest,
+    Bounded,
+    Random
+  };
+
+  static bool isAssertionPrefix(Prefix *prefix);
+  static bool isDPORPrefix(Prefix *prefix);
+};
+
+PrefixScheduler *getPrefixSchedulerByType(PrefixScheduler::PrefixSchedulerType type, unsigned bound, unsigned seed);
+
+/**
+ * FIFO Scheduler, replays the prefixes in the order they are found
+ */
+class FIFOPrefixScheduler : public PrefixScheduler {
+private:
+  std::deque<Prefix *> assertQueue;
+  std::deque<Prefix *> queue;
+
+public:
+  FIFOPrefixScheduler();
+  ~FIFOPrefixScheduler();
+  void printName(std::ostream &os) {
+    os << "fifo";
+  }
+
+  bool addItem(Prefix *item);
+  Prefix *selectNextItem();
+  unsigned itemNum();
+  void clear();
+  void printAllItem(std::ostream &os);
+};
+
+/**
+ * Base of the schedulers ordered by a priority, smaller first and in arrival
+ * order among equals. A priority may only grow while the prefix waits; it is
+ * recomputed when the prefix reaches the top and the prefix is put back if
+ * it has grown.
+ */
+class PriorityPrefixScheduler : public PrefixScheduler {
+private:
+  struct Item {
+    uint64_t priority;
+    uint64_t order;
+    Prefix *prefix;
+    bool operator<(const Item &other) const {
+      // std::priority_queue keeps the largest on top
+      return priority != other.priority ? priority > other.priority : order > other.order;
+    }
+  };
+  std::priority_queue<Item> queue;
+  uint64_t nextOrder;
+
+protected:
+  virtual uint64_t getPriority(Prefix *prefix) = 0;
+  virtual void onSelect(Prefix *prefix) {}
+
+public:
+  PriorityPrefixScheduler();
+  ~PriorityPrefixScheduler();
+  bool addItem(Prefix *item);
+  Prefix *selectNextItem();
+  unsigned itemNum();
+  void clear();
+  void printAllItem(std::ostream &os);
+};
+
+/**
+ * Coverage Scheduler, prefers prefixes that flip a branch to a direction no
+ * scheduled prefix has flipped it to yet
+ */
+class CoveragePrefixScheduler : public PriorityPrefixScheduler {
+private:
+  std::unordered_set<uint64_t> coveredBranches;
+  static uint64_t getTargetBranch(Prefix *prefix);
+
+protected:
+  uint64_t getPriority(Prefix *prefix);
+  void onSelect(Prefix *prefix);
+
+public:
+  void printName(std::ostream &os) {
+    os << "coverage";
+  }
+};
+
+/**
+ * Shortest Scheduler, replays the prefix with the fewest events first
+ */
+class ShortestPrefixScheduler : public PriorityPrefixScheduler {
+protected:
+  uint64_t getPriority(Prefix *prefix);
+
+public:
+  void printName(std::ostream &os) {
+    os << "shortest";
+  }
+};
+
+/**
+ * Bounded Scheduler, replays the prefix with the fewest context switches
+ * first and drops prefixes with more than bound switches, 0 for no bound
+ */
+class BoundedPrefixScheduler : public PriorityPrefixScheduler {
+private:
+  unsigned bound;
+  static unsigned getContextSwitches(Prefix *prefix);
+
+protected:
+  uint64_t getPriority(Prefix *prefix);
+
+public:
+  BoundedPrefixScheduler(unsigned bound);
+  bool addItem(Prefix *item);
+  void printName(std::ostream &os) {
+    os << "bounded";
+  }
+};
+
+/**
+ * Random Scheduler, replays a prefix chosen uniformly at random, so that the
+ * search restarts from a different part of the schedule set each time
+ */
+class RandomPrefixScheduler : public PrefixScheduler {
+private:
+  std::deque<Prefix *> assertQueue;
+  std::vector<Prefix *> pool;
+  std::mt19937 rng;
+
+public:
+  RandomPrefixScheduler(unsigned seed);
+  ~RandomPrefixScheduler();
+  void printName(std::ostream &os) {
+    os << "random";
+  }
+
+  bool addItem(Prefix *item);
+  Prefix *selectNextItem();
+  unsigned itemNum();
+  void clear();
+  void printAllItem(std::ostream &os);
+};
+
+} /* namespace klee */
+
+#endif /* LIB_ENCODE_PREFIXSCHEDULER_H_ */
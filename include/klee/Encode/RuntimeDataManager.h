@@ -11,12 +11,14 @@
 #define RUNTIMEDATAMANAGER_H_
 
 #include <iostream>
-#include <list>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include <sys/time.h>
 
 #include "Prefix.h"
+#include "PrefixScheduler.h"
 #include "Trace.h"
 
 namespace klee {
@@ -24,13 +26,30 @@ namespace klee {
 class RuntimeDataManager {
 
 private:
-  std::vector<Trace *> traceList;    // store all traces;
+  std::vector<Trace *> traceList;    // unique traces, compacted once analyzed
+  unsigned traceNum;                 // number of traces ever created
   Trace *currentTrace;               // trace associated with current execution
   std::set<Trace *> testedTraceList; // traces which have been examined
-  std::list<Prefix *> scheduleSet;   // prefixes which have not been examined
+  std::unordered_multimap<std::size_t, Trace *> testedTraceIndex; // tested traces keyed by abstract signature
+  PrefixScheduler *scheduleSet;      // prefixes which have not been examined
+  // backtrack sets of DPOR: the threads run or scheduled first at every state
+  // a race was reversed at, keyed by the hash of the state
+  std::unordered_map<uint64_t, std::vector<unsigned>> dporBacktrack;
+
+  // statistics of the prefix scheduler
+  unsigned scheduledPrefixNum;
+  unsigned prunedPrefixNum;
+  unsigned maxPendingPrefixNum;
+  unsigned assertPrefixNum;
+  unsigned firstAssertPrefix; // ordinal of the first scheduled assertion prefix, 0 if none
+  double firstAssertTime;     // seconds from the start to the first scheduled assertion prefix
+  struct timeval startTime;
+
+  bool addToBacktrackSet(Prefix *prefix);
 
 public:
   unsigned allFormulaNum;
+  unsigned reusedFormulaNum;
   unsigned solvingTimes;
   unsigned allGlobal;
   unsigned brGlobal;
@@ -85,6 +104,7 @@ public:
 
   Trace *createNewTrace(unsigned traceId);
   Trace *getCurrentTrace();
+  void retireCurrentTrace();
   void addToScheduleSet(Prefix *prefix);
   void printCurrentTrace(bool toFile);
   Prefix *getNextPrefix();
@@ -94,6 +114,7 @@ public:
   void printAllTrace(std::ostream &out);
   std::string getResultString();
   unsigned getTestedPathsNumber();
+  unsigned getPrunedPrefixNumber();
 };
 
 } // namespace klee
@@ -46,8 +46,6 @@ private:
   Executor *executor;
   Event *currentEvent;
   FilterSymbolicExpr filter;
-
-  std::map<std::string, std::vector<unsigned>> assertMap;
   bool kleeBr;
 
 private:
@@ -11,16 +11,19 @@
 
 #include "klee/ADT/Ref.h"
 #include "klee/Encode/Event.h"
+#include "klee/Encode/ObjectArena.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Module/KInstruction.h"
 
 #include <llvm/IR/Constant.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <cstddef>
 #include <map>
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -42,6 +45,12 @@ struct LockPair {
 
 class Trace {
 
+private:
+  // the events and synchronization records of the trace live here
+  ObjectArena<Event> events;
+  ObjectArena<LockPair> lockPairs;
+  ObjectArena<Wait_Lock> waitLocks;
+
 public:
   enum TraceType
   {
@@ -131,8 +140,13 @@ public:
   void printExecutionTrace(raw_ostream &out);
   void printDetailedInfo(raw_ostream &out);
 
+  // drop everything but the abstract, once the trace has been analyzed
+  void compact();
+
   void createAbstract();
   bool isEqual(Trace *trace);
+  // hash of the abstract which does not depend on the order of threads
+  std::size_t getAbstractSignature();
 
   std::string getAssemblyLine(std::string name);
   std::string getLine(std::string name);
@@ -146,17 +160,17 @@ public:
   std::map<Event *, uint64_t> joinThreadPoint;
 
   // 全局变量读写操作数据-->生成读写关系约束
-  std::map<std::string, std::vector<Event *>> allReadSet;
-  std::map<std::string, std::vector<Event *>> allWriteSet;
+  std::unordered_map<std::string, std::vector<Event *>> allReadSet;
+  std::unordered_map<std::string, std::vector<Event *>> allWriteSet;
   // key--global variable, value--the whole events that read global vars.
-  std::map<std::string, std::vector<Event *>> readSet;
-  std::map<std::string, std::vector<Event *>> writeSet;
-  std::map<std::string, std::vector<Event *>> readSetRelatedToBranch;
-  std::map<std::string, std::vector<Event *>> writeSetRelatedToBranch;
+  std::unordered_map<std::string, std::vector<Event *>> readSet;
+  std::unordered_map<std::string, std::vector<Event *>> writeSet;
+  std::unordered_map<std::string, std::vector<Event *>> readSetRelatedToBranch;
+  std::unordered_map<std::string, std::vector<Event *>> writeSetRelatedToBranch;
 
   // 锁操作集合，以lock/unlock为对收集-->生成同步语义约束
   // key--mutex（锁名，一个地址就ok，每个锁全局必唯一）, value--the whole lock/unlock pairs with respect to one mutex
-  std::map<std::string, std::vector<LockPair *>> all_lock_unlock;
+  std::unordered_map<std::string, std::vector<LockPair *>> all_lock_unlock;
   // key--condition 变量标识, value--the whole wait events that wait this conditional var
   std::map<std::string, std::vector<Wait_Lock *>> all_wait;
   // key--condition 变量标识, value--the whole signal events that signal this conditional var
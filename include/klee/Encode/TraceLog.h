@@ -0,0 +1,132 @@
+//===-- TraceLog.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Binary, append-only log of the traces of a run. The file starts with a magic
+// word and holds records of (kind, size, payload), padded to 4 bytes from the
+// start of their trace. Numbers are stored in host byte order and strings as
+// a length and their bytes. A trace is logged as TraceBegin, its events in
+// execution order, its read and write sets, lock pairs, thread creations and
+// joins, and TraceEnd.
+//
+// The reader maps the file and hands out the records where they lie in the
+// mapping, so reloading a log copies nothing. It only hands out the records
+// of whole traces and skips a trace that a failed write left behind.
+
+#ifndef LIB_ENCODE_TRACELOG_H_
+#define LIB_ENCODE_TRACELOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+
+namespace klee {
+
+class Trace;
+
+namespace TraceLog {
+
+const uint32_t magic = 0x474c544b; // "KTLG"
+
+enum RecordKind : uint32_t
+{
+  TraceBegin = 1, // size of the trace in bytes, traceId, traceType (u8),
+                  // threadNum, eventNum
+  EventRecord,    // eventId, threadId, threadEventId, orderId, instId,
+                  // eventType, isGlobal, isConditionInst, brCondition (u8),
+                  // eventName, name, globalName
+  ReadSet,        // variable, eventNum, eventId...
+  WriteSet,       // variable, eventNum, eventId...
+  LockPair,       // mutex, threadId, lockEventId, unlockEventId
+  ThreadCreate,   // eventId, child thread id (u64)
+  ThreadJoin,     // eventId, joined thread id (u64)
+  TraceEnd
+};
+
+// id of a missing event or instruction
+const uint32_t none = ~0u;
+
+} // namespace TraceLog
+
+class TraceLogWriter {
+private:
+  int fd;
+  std::string buffer;
+  std::size_t recordStart;
+
+  void put(uint8_t value);
+  void put(uint32_t value);
+  void put(uint64_t value);
+  void put(const std::string &value);
+  void beginRecord(TraceLog::RecordKind kind);
+  void endRecord();
+
+public:
+  TraceLogWriter();
+  ~TraceLogWriter();
+  // opens path for appending, the magic word is written to a new file
+  bool open(const std::string &path);
+  bool isOpen();
+  // a trace goes to the file in one write, so the processes sharing the file
+  // do not interleave their traces
+  void write(Trace *trace);
+};
+
+class TraceLogReader {
+public:
+  struct Record {
+    TraceLog::RecordKind kind;
+    const char *data;
+    uint32_t size;
+  };
+
+  // reads the fields of a record payload in order
+  class Cursor {
+  private:
+    const char *pos;
+    const char *end;
+
+  public:
+    Cursor(const Record &record) : pos(record.data), end(record.data + record.size) {}
+    bool read(uint8_t &value);
+    bool read(uint32_t &value);
+    bool read(uint64_t &value);
+    // the string points into the mapping
+    bool read(llvm::StringRef &value);
+    bool atEnd() {
+      return pos == end;
+    }
+  };
+
+private:
+  const char *data;
+  std::size_t size;
+  std::size_t offset;
+  std::size_t traceEnd; // end of the trace the offset is in
+
+  // size of the whole trace at start, or 0 if there is none
+  std::size_t getTraceSize(std::size_t start);
+
+public:
+  TraceLogReader();
+  ~TraceLogReader();
+  TraceLogReader(const TraceLogReader &) = delete;
+  TraceLogReader &operator=(const TraceLogReader &) = delete;
+
+  // maps path and checks the magic word
+  bool open(const std::string &path);
+  void close();
+  // false at the end of the log
+  bool next(Record &record);
+  void rewind();
+};
+
+} /* namespace klee */
+
+#endif /* LIB_ENCODE_TRACELOG_H_ */
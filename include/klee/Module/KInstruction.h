@@ -41,6 +41,9 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// Whether this is a conditional branch on the source line of a call to
+    /// __assert_fail, i.e. the check of an assertion.
+    bool isAssertBranch = false;
 
   public:
     virtual ~KInstruction();
@@ -147,6 +147,9 @@ namespace klee {
     /// Run passes that check if module is valid LLVM IR and if invariants
     /// expected by KLEE's Executor hold.
     void checkModule();
+
+    /// Set KInstruction::isAssertBranch on the checks of the assertions.
+    void markAssertBranches();
   };
 } // End klee namespace
 
@@ -0,0 +1,109 @@
+//===-- AddressMap.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Open-addressing table from the address of a synchronization object to the
+// object that models it. The slots are probed linearly and the table doubles
+// at half load, so a lookup is a multiplication and a few adjacent compares.
+// Address 0 marks a free slot, no object lives there. Entries are never
+// removed and the table does not own the objects.
+
+#ifndef LIB_THREAD_ADDRESSMAP_H_
+#define LIB_THREAD_ADDRESSMAP_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace klee {
+
+template <typename T> class AddressMap {
+private:
+  struct Slot {
+    uint64_t address;
+    T *value;
+  };
+  std::vector<Slot> slots; // empty or a power of two
+  unsigned count;
+
+  static unsigned getIndex(uint64_t address, unsigned mask) {
+    return (unsigned)((address * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+  }
+
+  void place(uint64_t address, T *value) {
+    unsigned mask = slots.size() - 1;
+    unsigned i = getIndex(address, mask);
+    while (slots[i].address) {
+      i = (i + 1) & mask;
+    }
+    slots[i].address = address;
+    slots[i].value = value;
+  }
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    Slot empty = {0, NULL};
+    slots.assign(old.empty() ? 16 : 2 * old.size(), empty);
+    for (auto &slot : old) {
+      if (slot.address) {
+        place(slot.address, slot.value);
+      }
+    }
+  }
+
+public:
+  AddressMap() : count(0) {}
+
+  T *find(uint64_t address) const {
+    if (slots.empty()) {
+      return NULL;
+    }
+    unsigned mask = slots.size() - 1;
+    for (unsigned i = getIndex(address, mask);; i = (i + 1) & mask) {
+      if (slots[i].address == address) {
+        return slots[i].value;
+      }
+      if (!slots[i].address) {
+        return NULL;
+      }
+    }
+  }
+
+  // the address must not be in the table yet
+  void insert(uint64_t address, T *value) {
+    assert(address && !find(address));
+    if (2 * (count + 1) > slots.size()) {
+      grow();
+    }
+    place(address, value);
+    count++;
+  }
+
+  unsigned size() const {
+    return count;
+  }
+
+  // calls fn(address, value) for every entry, in no particular order
+  template <typename Fn> void forEach(Fn fn) const {
+    for (auto &slot : slots) {
+      if (slot.address) {
+        fn(slot.address, slot.value);
+      }
+    }
+  }
+
+  void clear() {
+    std::vector<Slot>().swap(slots);
+    count = 0;
+  }
+};
+
+} /* namespace klee */
+
+#endif /* LIB_THREAD_ADDRESSMAP_H_ */
@@ -10,23 +10,28 @@
 #ifndef BARRIERMANAGER_H_
 #define BARRIERMANAGER_H_
 
+#include "klee/Thread/AddressMap.h"
 #include "klee/Thread/Barrier.h"
-#include <map>
+#include <cstdint>
+#include <iostream>
 
 namespace klee {
 
+// Barriers are keyed by their address and added on their first use when they
+// were not found in the global initializers.
 class BarrierManager {
 private:
-  std::map<std::string, Barrier *> barrierPool;
+  AddressMap<Barrier> barrierPool;
 
 public:
   BarrierManager();
   virtual ~BarrierManager();
-  bool init(std::string barrierName, unsigned count, std::string &errorMsg);
-  bool wait(std::string barrierName, unsigned threadId, bool &isReleased, std::vector<unsigned> &blockedList,
+  bool init(uint64_t address, unsigned count, std::string &errorMsg);
+  bool wait(uint64_t address, unsigned threadId, bool &isReleased, std::vector<unsigned> &blockedList,
             std::string &errorMsg);
-  bool addBarrier(std::string barrierName, std::string &errorMsg);
-  Barrier *getBarrier(std::string barrierName);
+  bool addBarrier(uint64_t address, std::string &errorMsg);
+  Barrier *getBarrier(uint64_t address);
+  Barrier *getOrAddBarrier(uint64_t address);
   void clear();
   void print(std::ostream &out);
 };
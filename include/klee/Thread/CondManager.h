@@ -10,11 +10,12 @@
 #ifndef CONDMANAGER_H_
 #define CONDMANAGER_H_
 
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
 #include <vector>
 
+#include "klee/Thread/AddressMap.h"
 #include "klee/Thread/Condition.h"
 
 namespace klee {
@@ -23,25 +24,33 @@ class MutexManager;
 
 namespace klee {
 
+// Conditions are keyed by their address and added on their first use when
+// they were not found in the global initializers. Under a prefix they are
+// added with a guided scheduler.
 class CondManager {
 private:
-  std::map<std::string, Condition *> condPool;
+  AddressMap<Condition> condPool;
   MutexManager *mutexManager;
+  Prefix *prefix;
   unsigned nextConditionId;
 
 public:
   CondManager();
   CondManager(MutexManager *mutexManaget);
   virtual ~CondManager();
-  bool wait(std::string condName, std::string mutexName, unsigned threadId, std::string &errorMsg);
-  bool signal(std::string condName, unsigned &releasedThreadId, std::string &errorMsg);
-  bool broadcast(std::string condName, std::vector<unsigned> &threads, std::string &errorMsg);
-  bool addCondition(std::string condName, std::string &errorMsg);
-  bool addCondition(std::string condName, std::string &errorMsg, Prefix *prefix);
-  Condition *getCondition(std::string condName);
+  bool wait(uint64_t condAddress, uint64_t mutexAddress, unsigned threadId, std::string &errorMsg);
+  bool signal(uint64_t condAddress, unsigned &releasedThreadId, std::string &errorMsg);
+  bool broadcast(uint64_t condAddress, std::vector<unsigned> &threads, std::string &errorMsg);
+  bool addCondition(uint64_t condAddress, std::string &errorMsg);
+  bool addCondition(uint64_t condAddress, std::string &errorMsg, Prefix *prefix);
+  Condition *getCondition(uint64_t condAddress);
+  Condition *getOrAddCondition(uint64_t condAddress);
   void setMutexManager(MutexManager *mutexManager) {
     this->mutexManager = mutexManager;
   }
+  void setPrefix(Prefix *prefix) {
+    this->prefix = prefix;
+  }
   void clear();
   void print(std::ostream &out);
   unsigned getNextConditionId();
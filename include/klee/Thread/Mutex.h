@@ -10,6 +10,7 @@
 #define MUTEX_H_
 
 #include "klee/Thread/MutexScheduler.h"
+#include <deque>
 #include <string>
 
 namespace klee {
@@ -23,6 +24,9 @@ public:
 private:
   bool isLocked;
   unsigned lockedThreadId;
+  // threads taken off the scheduler until the mutex is unlocked, in the
+  // order they blocked
+  std::deque<unsigned> waitingThreads;
   // std::list<Thread*> blockedList;
   // unsigned lockedThread;
   // MutexScheduler* blockedList;
@@ -40,6 +44,11 @@ public:
   void unlock();
 
   bool isThreadOwnMutex(unsigned threadId);
+  void addWaitingThread(unsigned threadId);
+  void removeWaitingThread(unsigned threadId);
+  bool isThreadWaiting(unsigned threadId);
+  // the thread that waited longest, 0 if none
+  unsigned popWaitingThread();
   //	void addToBlockedList(Thread* thread);
   //	void removeFromBlockedList(Thread* thread);
 
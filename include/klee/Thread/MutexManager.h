@@ -10,34 +10,49 @@
 #ifndef MUTEXMANAGER_H_
 #define MUTEXMANAGER_H_
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "klee/Thread/AddressMap.h"
 #include "klee/Thread/Mutex.h"
 
 namespace klee {
 
+// Mutexes are keyed by their address. A mutex that was not found in the
+// global initializers, e.g. one on the heap, is added on its first use.
+//
+// A thread that fails to lock a mutex waits on it, off the scheduler, and an
+// unlock wakes the thread that waited longest. The woken thread tries again
+// when it is scheduled, so a thread that takes the mutex in between sends it
+// back to wait.
 class MutexManager {
 private:
-  std::map<std::string, Mutex *> mutexPool;
-  std::map<unsigned, Mutex *> blockedThreadPool;
+  AddressMap<Mutex> mutexPool;
+  std::map<unsigned, Mutex *> blockedThreadPool; // threads that still have to take a mutex
+  std::vector<unsigned> wokenThreads;            // woken by unlocks, not yet back on the scheduler
   unsigned nextMutexId;
 
 public:
   MutexManager();
   virtual ~MutexManager();
-  bool lock(std::string mutexName, unsigned threadId, bool &isBlocked, std::string &errorMsg);
+  bool lock(uint64_t address, unsigned threadId, bool &isBlocked, std::string &errorMsg);
   bool lock(Mutex *mutex, unsigned threadId, bool &isBlocked, std::string &errorMsg);
-  bool unlock(std::string mutexName, std::string &errorMsg);
+  bool unlock(uint64_t address, std::string &errorMsg);
   bool unlock(Mutex *mutex, std::string &errorMsg);
-  bool addMutex(std::string mutexName, std::string &errorMsg);
-  Mutex *getMutex(std::string mutexName);
+  bool addMutex(uint64_t address, std::string &errorMsg);
+  Mutex *getMutex(uint64_t address);
+  Mutex *getOrAddMutex(uint64_t address);
   void clear();
   void print(std::ostream &out);
   unsigned getNextMutexId();
-  void addBlockedThread(unsigned threadId, std::string mutexName);
+  void addBlockedThread(unsigned threadId, uint64_t address);
   bool tryToLockForBlockedThread(unsigned threadId, bool &isBlocked, std::string &errorMsg);
+  bool isThreadWaiting(unsigned threadId);
+  Mutex *getBlockingMutex(unsigned threadId);
+  void takeWokenThreads(std::vector<unsigned> &threads);
 };
 
 } // namespace klee
@@ -0,0 +1,81 @@
+//===-- VectorClock.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Vector clock that grows on demand. Components past the end of the storage
+// are implicitly zero, so a clock only holds entries up to the largest thread
+// id it has heard of. The loops over the storage have no early exits so that
+// the compiler can vectorize them.
+
+#ifndef LIB_THREAD_VECTORCLOCK_H_
+#define LIB_THREAD_VECTORCLOCK_H_
+
+#include <algorithm>
+#include <vector>
+
+namespace klee {
+
+class VectorClock {
+private:
+  std::vector<unsigned> clock;
+
+public:
+  VectorClock() {}
+
+  unsigned size() const {
+    return clock.size();
+  }
+
+  unsigned get(unsigned threadId) const {
+    return threadId < clock.size() ? clock[threadId] : 0;
+  }
+
+  // advance the component of threadId
+  void tick(unsigned threadId) {
+    if (threadId >= clock.size()) {
+      clock.resize(threadId + 1, 0);
+    }
+    clock[threadId]++;
+  }
+
+  // component-wise maximum with another clock
+  void merge(const VectorClock &other) {
+    if (other.clock.size() > clock.size()) {
+      clock.resize(other.clock.size(), 0);
+    }
+    unsigned *dst = clock.data();
+    const unsigned *src = other.clock.data();
+    unsigned n = other.clock.size();
+    for (unsigned i = 0; i < n; i++) {
+      dst[i] = std::max(dst[i], src[i]);
+    }
+  }
+
+  // true when every component is no smaller than the one of other and at
+  // least one is larger, i.e. other happens before this clock
+  bool dominates(const VectorClock &other) const {
+    unsigned common = std::min(clock.size(), other.clock.size());
+    const unsigned *a = clock.data();
+    const unsigned *b = other.clock.data();
+    bool before = false, after = false;
+    for (unsigned i = 0; i < common; i++) {
+      before |= a[i] < b[i];
+      after |= a[i] > b[i];
+    }
+    for (unsigned i = common; i < clock.size(); i++) {
+      after |= a[i] != 0;
+    }
+    for (unsigned i = common; i < other.clock.size(); i++) {
+      before |= b[i] != 0;
+    }
+    return after && !before;
+  }
+};
+
+} /* namespace klee */
+
+#endif /* LIB_THREAD_VECTORCLOCK_H_ */
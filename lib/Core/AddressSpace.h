@@ -68,6 +68,13 @@ namespace klee {
     AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
     ~AddressSpace() {}
 
+    /// Replace all bindings by those of `b`. Like the copy constructor,
+    /// the objects are shared and copied on their first write.
+    void copyFrom(const AddressSpace &b) {
+      cowKey = ++b.cowKey;
+      objects = b.objects;
+    }
+
     /// Resolve address to an ObjectPair in result.
     /// \return true iff an object was found.
     bool resolveOne(const ref<ConstantExpr> &address, 
@@ -30,6 +30,7 @@
 #include "klee/Thread/ThreadScheduler.h"
 #include "klee/Support/ErrorHandling.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <map>
@@ -72,6 +73,7 @@ ExecutionState::ExecutionState(KFunction *kf, Prefix *prefix)
       condManager() {
 
   condManager.setMutexManager(&mutexManager);
+  condManager.setPrefix(prefix);
   threadScheduler =
       new GuidedThreadScheduler(this, ThreadScheduler::FIFS, prefix);
   Thread *thread = new Thread(getNextThreadId(), NULL, kf, &addressSpace);
@@ -408,7 +410,6 @@ bool ExecutionState::examineAllThreadFinalState() {
 
 unsigned ExecutionState::getNextThreadId() {
 	unsigned threadId = nextThreadId++;
-	assert (nextThreadId < 17 && "vector clock 只有16个");
 	return threadId;
 }
 
@@ -422,7 +423,6 @@ Thread* ExecutionState::createThread(KFunction *kf) {
 Thread* ExecutionState::createThread(KFunction *kf, unsigned threadId) {
 	if (threadId >= nextThreadId) {
 		nextThreadId = threadId + 1;
-		assert (nextThreadId < 17 && "vector clock 只有16个");
 	}
 	Thread* newThread = new Thread(threadId, currentThread, kf, &addressSpace);
 	threadList.addThread(newThread);
@@ -486,3 +486,46 @@ void ExecutionState::switchThreadToRunnable(unsigned threadId) {
 void ExecutionState::reSchedule() {
 	threadScheduler->reSchedule();
 }
+
+void ExecutionState::swapInWokenThreads() {
+  std::vector<unsigned> threads;
+  mutexManager.takeWokenThreads(threads);
+  for (auto threadId : threads) {
+    swapInThread(threadId, false, true);
+  }
+}
+
+// A thread blocked on a mutex waits for its owner and a joining thread for
+// the joined one. Conditions and barriers have no single thread to wait for.
+Thread *ExecutionState::getWaitedThread(Thread *thread) {
+  if (thread->isMutexBlocked()) {
+    Mutex *mutex = mutexManager.getBlockingMutex(thread->threadId);
+    if (mutex && mutex->isMutexLocked()) {
+      return findThreadById(mutex->getLockedThread());
+    }
+  } else if (thread->isJoinBlocked()) {
+    for (auto &join : joinRecord) {
+      if (std::find(join.second.begin(), join.second.end(), thread->threadId) != join.second.end()) {
+        return findThreadById(join.first);
+      }
+    }
+  }
+  return NULL;
+}
+
+// Every blocked thread waits for at most one thread, and a new cycle of the
+// wait-for graph goes through the thread that blocked last. So it is enough
+// to follow the waits from there whenever a thread blocks.
+bool ExecutionState::findDeadlock(Thread *thread, std::vector<Thread *> &cycle) {
+  cycle.clear();
+  Thread *next = thread;
+  do {
+    cycle.push_back(next);
+    next = getWaitedThread(next);
+    // a chain that runs into an older cycle does not come back
+    if (!next || cycle.size() >= nextThreadId) {
+      return false;
+    }
+  } while (next != thread);
+  return true;
+}
@@ -267,6 +267,10 @@ public:
   void switchThreadToRunnable(Thread *thread);
   void switchThreadToRunnable(unsigned threadId);
   void reSchedule();
+  // puts the threads woken by mutex unlocks back on the scheduler
+  void swapInWokenThreads();
+  Thread *getWaitedThread(Thread *thread);
+  bool findDeadlock(Thread *thread, std::vector<Thread *> &cycle);
 };
 
 struct ExecutionStateIDCompare {
@@ -97,6 +97,8 @@ typedef unsigned TypeSize;
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <csignal>
+#include <cstddef>
 #include <cstring>
 #include <cxxabi.h>
 #include <fstream>
@@ -105,7 +107,12 @@ typedef unsigned TypeSize;
 #include <limits>
 #include <sstream>
 #include <string>
+#include <poll.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 using namespace llvm;
@@ -130,6 +137,9 @@ cl::OptionCategory
 cl::OptionCategory TestGenCat("Test generation options",
                               "These options impact test generation.");
 
+cl::OptionCategory KleemCat("KLEEM options",
+                            "These options control the exploration of thread schedules.");
+
 cl::opt<std::string> MaxTime(
     "max-time",
     cl::desc("Halt execution after the specified duration.  "
@@ -437,6 +447,34 @@ cl::opt<bool> DebugCheckForImpliedValues(
     cl::desc("Debug the implied value optimization"),
     cl::cat(DebugCat));
 
+cl::opt<unsigned> KleemWorkers(
+    "kleem-workers",
+    cl::desc("Replay prefixes in this many forked worker processes. Set to 1 to run serially (default=1)"),
+    cl::init(1),
+    cl::cat(KleemCat));
+
+cl::opt<unsigned> KleemSnapshots(
+    "kleem-snapshots",
+    cl::desc("Keep up to this many snapshot processes forked at conditional branches, and resume a prefix from "
+             "the deepest snapshot it extends instead of replaying it from main. Uses the worker processes of "
+             "-kleem-workers (default=0, disabled)"),
+    cl::init(0),
+    cl::cat(KleemCat));
+
+cl::opt<bool> KleemVisibleScheduling(
+    "kleem-visible-scheduling",
+    cl::desc("Switch threads only before visible operations, i.e. accesses to shared memory and calls to external "
+             "functions such as the pthread ones. A thread runs straight through its thread-local instructions and "
+             "the prefixes only hold the visible steps (default=false)"),
+    cl::init(false),
+    cl::cat(KleemCat));
+
+cl::opt<unsigned> KleemSnapshotInterval(
+    "kleem-snapshot-interval",
+    cl::desc("Take a snapshot at every n-th conditional branch executed after the prefix (default=1)"),
+    cl::init(1),
+    cl::cat(KleemCat));
+
 } // namespace
 
 // XXX hack
@@ -468,10 +506,11 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
     : Interpreter(opts), interpreterHandler(ih), searcher(0),
       externalDispatcher(new ExternalDispatcher(ctx)), statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0), timers{time::Span(TimerInterval)},
-      replayKTest(0), replayPath(0), usingSeeds(0),
+      initialArgvMO(0), replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
       ivcEnabled(false), debugLogBuffer(debugBufferString), 
-      isFinished(false), prefix(NULL), executionNum(0), execStatus(SUCCESS){
+      isFinished(false), prefix(NULL), isVisibleStep(true), executionNum(0), snapshotNum(0), snapshotBranchNum(0), workerIn(-1),
+      workerOut(-1), execStatus(SUCCESS){
 
 
   const time::Span maxTime{MaxTime};
@@ -593,6 +632,9 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
 }
 
 Executor::~Executor() {
+  // the images hold the global objects, release them before their manager
+  initialAddressSpace = nullptr;
+  initialShadowAddressSpace = nullptr;
   delete memory;
   delete externalDispatcher;
   delete specialFunctionHandler;
@@ -3787,7 +3829,19 @@ void Executor::run(ExecutionState &initialState) {
   // main interpreter loop
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
-    Thread *thread = state.getNextThread();
+    Thread *thread = state.currentThread;
+    // with -kleem-visible-scheduling, threads are only switched before a
+    // visible operation and the running thread goes on through its
+    // thread-local instructions without asking the scheduler
+    Thread *running = NULL;
+    isVisibleStep = true;
+    if (KleemVisibleScheduling && thread->isRunnable()) {
+      running = thread;
+      isVisibleStep = isVisibleInstruction(state, thread->pc);
+    }
+    if (isVisibleStep) {
+      thread = state.getNextThread();
+    }
     bool isAbleToRun = true;
     switch (thread->threadState) {
     case Thread::RUNNABLE: {
@@ -3795,44 +3849,46 @@ void Executor::run(ExecutionState &initialState) {
     }
 
     case Thread::MUTEX_BLOCKED: {
-      // TODO:　死锁检测可以完善
-      Thread *origin = thread;
-      bool deadlock = false;
+      // a thread that waits on a mutex is off the scheduler until an unlock
+      // wakes it, so only woken threads and the ones a prefix picks get here
       do {
         std::string errorMsg;
         bool isBlocked;
-        if (state.mutexManager.tryToLockForBlockedThread(thread->threadId,
-                                                         isBlocked, errorMsg)) {
-          if (isBlocked) {
-            if (prefix && !prefix->isFinished()) {
-              llvm::errs() << "thread" << thread->threadId << ": "
-                           << thread->pc->info->file << "/"
-                           << thread->pc->info->line << " "
-                           << thread->pc->inst->getOpcodeName() << "\n";
-              thread->pc->inst->print(llvm::errs());
-              llvm::errs() << "thread state is MUTEX_BLOCKED, try to get lock "
-                              "but failed\n";
-              isAbleToRun = false;
-              break;
-            }
-            state.reSchedule();
-            thread = state.getNextThread();
-            if (thread == origin) {
-              if (deadlock) {
-                llvm::errs() << "perhaps deadlock happen\n";
-                isAbleToRun = false;
-                break;
-              } else {
-                deadlock = true;
-              }
-            }
+        bool isWaiting = state.mutexManager.isThreadWaiting(thread->threadId);
+        if (!state.mutexManager.tryToLockForBlockedThread(thread->threadId,
+                                                          isBlocked, errorMsg)) {
+          llvm::errs() << errorMsg << "\n";
+          assert(0 && "try to get lock but failed");
+        }
+        if (!isBlocked) {
+          if (isWaiting) {
+            state.swapInThread(thread, true, false);
           } else {
             state.switchThreadToRunnable(thread);
           }
-        } else {
-          llvm::errs() << errorMsg << "\n";
-          assert(0 && "try to get lock but failed");
+          break;
+        }
+        if (prefix && !prefix->isFinished()) {
+          llvm::errs() << "thread" << thread->threadId << ": "
+                       << thread->pc->info->file << "/"
+                       << thread->pc->info->line << " "
+                       << thread->pc->inst->getOpcodeName() << "\n";
+          thread->pc->inst->print(llvm::errs());
+          llvm::errs() << "thread state is MUTEX_BLOCKED, try to get lock "
+                          "but failed\n";
+          isAbleToRun = false;
+          break;
         }
+        // another thread took the mutex first, wait for the next unlock
+        if (!isWaiting) {
+          state.swapOutThread(thread, false, false, false, false);
+          checkDeadlock(state, thread);
+        }
+        if (state.threadScheduler->isSchedulerEmpty()) {
+          isAbleToRun = false;
+          break;
+        }
+        thread = state.getNextThread();
       } while (!thread->isRunnable());
 
       break;
@@ -3853,30 +3909,44 @@ void Executor::run(ExecutionState &initialState) {
       break;
     }
     KInstruction *ki = thread->pc;
-    if (prefix && !prefix->isFinished() && ki != prefix->getCurrentInst()) {
-      std::string runInst, shouldInst;
-      raw_string_ostream runInstStream(runInst), shouldInstStream(shouldInst);
-      prefix->getCurrentInst()->inst->print(shouldInstStream);
+    if (KleemVisibleScheduling && thread != running) {
+      isVisibleStep = isVisibleInstruction(state, ki);
+    }
+    if (prefix && !prefix->isFinished() && isVisibleStep && ki->info->id != prefix->getCurrentInstId()) {
+      std::string runInst;
+      raw_string_ostream runInstStream(runInst);
       ki->inst->print(runInstStream);
-      kleem_note("Failed to match the prefix: on Thread %d, \nshould be %s, \nbut executed %s.", 
-                 thread->threadId, shouldInst.c_str(), runInst.c_str());
+      kleem_note("Failed to match the prefix: on Thread %d, \nshould be instruction %u, \nbut executed %s (%u).",
+                 thread->threadId, prefix->getCurrentInstId(), runInst.c_str(), ki->info->id);
       execStatus = IGNOREDERROR;
       terminateState(state);
       updateStates(&state);
       break;
     }
+    if (KleemSnapshots && isVisibleStep) {
+      ReplayStep step = {thread->threadId, ki->info->id, 0};
+      replaySteps.push_back(step);
+    }
     stepInstruction(state);
     listenerService->beforeExecuteInstruction(this, state, ki);
     executeInstruction(state, ki);
     listenerService->afterExecuteInstruction(this, state, ki);
 
-    if (prefix) {
+    if (prefix && isVisibleStep) {
       prefix->increasePosition();
     }
     if (execStatus != SUCCESS) {
       updateStates(&state);
       break;
     }
+    // steps inside the prefix are covered by the snapshots of the execution it was derived from
+    if (KleemSnapshots && workerOut >= 0 && prefix && prefix->isFinished() && snapshotNum < KleemSnapshots) {
+      BranchInst *bi = dyn_cast<BranchInst>(ki->inst);
+      if (bi && bi->isConditional() && ++snapshotBranchNum >= KleemSnapshotInterval) {
+        snapshotBranchNum = 0;
+        takeSnapshot();
+      }
+    }
     timers.invoke();
     if (::dumpStates)
       dumpStates();
@@ -4707,14 +4777,18 @@ void Executor::runFunctionAsMain(Function *f,
   if (ai!=ae) {
     arguments.push_back(ConstantExpr::alloc(argc, Expr::Int32));
     if (++ai!=ae) {
-      Instruction *first = &*(f->begin()->begin());
-      argvMO =
-          memory->allocate((argc + 1 + envc + 1 + 1) * NumPtrBytes,
-                           /*isLocal=*/false, /*isGlobal=*/true,
-                           /*allocSite=*/first, /*alignment=*/8);
+      if (initialAddressSpace) {
+        argvMO = initialArgvMO;
+      } else {
+        Instruction *first = &*(f->begin()->begin());
+        argvMO =
+            memory->allocate((argc + 1 + envc + 1 + 1) * NumPtrBytes,
+                             /*isLocal=*/false, /*isGlobal=*/true,
+                             /*allocSite=*/first, /*alignment=*/8);
 
-      if (!argvMO)
-        klee_error("Could not allocate memory for function arguments");
+        if (!argvMO)
+          klee_error("Could not allocate memory for function arguments");
+      }
 
       arguments.push_back(argvMO->getBaseExpr());
 
@@ -4748,49 +4822,55 @@ void Executor::runFunctionAsMain(Function *f,
   for (unsigned i = 0, e = f->arg_size(); i != e; ++i)
     bindArgument(kf, i, *state, arguments[i]);
 
-  if (argvMO) {
-    ObjectState *argvOS = bindObjectInState(*state, argvMO, false);
-
-    for (int i=0; i<argc+1+envc+1+1; i++) {
-      if (i==argc || i>=argc+1+envc) {
-        // Write NULL pointer
-        argvOS->write(i * NumPtrBytes, Expr::createPointer(0));
-      } else {
-        char *s = i<argc ? argv[i] : envp[i-(argc+1)];
-        int j, len = strlen(s);
-
-        MemoryObject *arg =
-            memory->allocate(len + 1, /*isLocal=*/false, /*isGlobal=*/true,
-                             /*allocSite=*/state->currentThread->pc->inst, /*alignment=*/8);
-        if (!arg)
-          klee_error("Could not allocate memory for function arguments");
-        ObjectState *os = bindObjectInState(*state, arg, false);
-        for (j=0; j<len+1; j++)
-          os->write8(j, s[j]);
+  if (initialAddressSpace) {
+    // argv and the globals are laid out as the first execution found them
+    state->addressSpace.copyFrom(*initialAddressSpace);
+  } else {
+    if (argvMO) {
+      ObjectState *argvOS = bindObjectInState(*state, argvMO, false);
 
-        // Write pointer to newly allocated and initialised argv/envp c-string
-        argvOS->write(i * NumPtrBytes, arg->getBaseExpr());
+      for (int i=0; i<argc+1+envc+1+1; i++) {
+        if (i==argc || i>=argc+1+envc) {
+          // Write NULL pointer
+          argvOS->write(i * NumPtrBytes, Expr::createPointer(0));
+        } else {
+          char *s = i<argc ? argv[i] : envp[i-(argc+1)];
+          int j, len = strlen(s);
+
+          MemoryObject *arg =
+              memory->allocate(len + 1, /*isLocal=*/false, /*isGlobal=*/true,
+                               /*allocSite=*/state->currentThread->pc->inst, /*alignment=*/8);
+          if (!arg)
+            klee_error("Could not allocate memory for function arguments");
+          ObjectState *os = bindObjectInState(*state, arg, false);
+          for (j=0; j<len+1; j++)
+            os->write8(j, s[j]);
+
+          // Write pointer to newly allocated and initialised argv/envp c-string
+          argvOS->write(i * NumPtrBytes, arg->getBaseExpr());
+        }
       }
     }
+
+    initializeGlobals(*state);
+    initialAddressSpace = std::make_unique<AddressSpace>(state->addressSpace);
+    initialArgvMO = argvMO;
+    // the objects of the image outlive the executions
+    memory->freeze();
   }
-  
-  initializeGlobals(*state);
   processTree = std::make_unique<PTree>(state);
   listenerService->beforeRunMethodAsMain(this, *state, f, argvMO, arguments, argc, argv, envp);
 
   run(*state);
   processTree = nullptr;
 
-  // hack to clear memory objects
-  delete memory;
-  memory = new MemoryManager(NULL);
-
-  globalObjects.clear();
-  globalAddresses.clear();
-
   if (statsTracker)
     statsTracker->done();
   listenerService->afterRunMethodAsMain(*state);
+
+  // release the objects of this execution, the image is kept for the next;
+  // the shadow address spaces of the listeners are empty by now
+  memory->reset();
 }
 
 unsigned Executor::getPathStreamID(const ExecutionState &state) {
@@ -5120,6 +5200,44 @@ bool Executor::isGlobalMO(const MemoryObject *mo) {
   return result;
 }
 
+// Visible operations are where the threads of an execution can interfere:
+// accesses to memory that isGlobalMO calls shared, as PSOListener does for
+// its events, and calls to functions without a body such as the pthread ones.
+// Any other instruction only touches the thread executing it.
+bool Executor::isVisibleInstruction(ExecutionState &state, KInstruction *ki) {
+  Instruction *inst = ki->inst;
+  switch (inst->getOpcode()) {
+    case Instruction::Load:
+    case Instruction::Store: {
+      ref<Expr> address = eval(ki, inst->getOpcode() == Instruction::Load ? 0 : 1, state).value;
+      ConstantExpr *realAddress = dyn_cast<ConstantExpr>(address);
+      ObjectPair op;
+      // a symbolic or unresolved address is left to the scheduler
+      if (!realAddress || !state.currentStack->addressSpace->resolveOne(realAddress, op)) {
+        return true;
+      }
+      return isGlobalMO(op.first);
+    }
+    case Instruction::Call: {
+      if (isa<DbgInfoIntrinsic>(inst)) {
+        return false;
+      }
+      CallSite cs(inst);
+      Function *f = getTargetFunction(cs.getCalledValue(), state);
+      return !f || f->isDeclaration();
+    }
+    case Instruction::Invoke:
+    case Instruction::AtomicRMW:
+    case Instruction::AtomicCmpXchg:
+    case Instruction::Fence: {
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
 bool Executor::isFunctionSpecial(Function *f) {
   if (specialFunctionHandler->handlers.find(f) == specialFunctionHandler->handlers.end()) {
     return false;
@@ -5130,6 +5248,11 @@ bool Executor::isFunctionSpecial(Function *f) {
 
 void Executor::runVerification(llvm::Function *f, int argc, char **argv, char **envp) {
   kleem_note("Start to exhaust thread schedules and branches under current input.");
+  if (KleemWorkers > 1 || KleemSnapshots) {
+    runParallelVerification(f, argc, argv, envp);
+    kleem_note("Exhaustive analysis terminated.");
+    return;
+  }
   // while (!isFinished && execStatus != RUNTIMEERROR) {
   while (!isFinished) {
     execStatus = SUCCESS;
@@ -5141,6 +5264,668 @@ void Executor::runVerification(llvm::Function *f, int argc, char **argv, char **
   kleem_note("Exhaustive analysis terminated.");
 }
 
+namespace {
+
+// Pipe protocol between the coordinator and a verification worker. A worker
+// replays one prefix and reports the abstract of its trace, the coordinator
+// answers whether the trace is a new path, and the worker then reports the
+// statistics and prefixes produced by encoding the trace. Prefixes travel in
+// their own binary form.
+//
+// With snapshots, a worker also forks a snapshot process at some conditional
+// branches. The snapshot connects to the coordinator's socket, sends the steps
+// executed so far and waits. To resume a prefix, the coordinator sends it to
+// the snapshot, which forks once more; that child switches to the prefix,
+// connects back as a worker and speaks the worker protocol from then on.
+
+struct WorkerStatistics {
+  unsigned allFormulaNum;
+  unsigned reusedFormulaNum;
+  unsigned solvingTimes;
+  unsigned allGlobal;
+  unsigned brGlobal;
+  unsigned satBranch;
+  unsigned unSatBranchBySolve;
+  unsigned unSatBranchByPreSolve;
+  double runningCost;
+  double solvingCost;
+  double satCost;
+  double unSatCost;
+};
+
+struct VerificationWorker {
+  pid_t pid;
+  int toWorker;
+  int fromWorker;
+  unsigned traceId;
+  bool analyzing; // the worker has got the verdict and is encoding its trace
+  bool connecting; // the worker is resumed from a snapshot and has not connected yet
+  bool resumed;    // forked by a snapshot, so not our child to wait for
+};
+
+struct VerificationSnapshot {
+  int fd;
+  std::vector<Executor::ReplayStep> steps;
+  unsigned lastUse; // for evicting the least recently used snapshot
+};
+
+// first byte sent on a connection to the coordinator socket, or from the
+// coordinator to a snapshot
+enum CoordinatorMessage : uint8_t { WORKER_HELLO = 1, SNAPSHOT_HELLO, SNAPSHOT_RESUME };
+
+bool writeWorkerData(int fd, const void *buf, size_t size) {
+  const char *data = (const char *)buf;
+  while (size) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool readWorkerData(int fd, void *buf, size_t size) {
+  char *data = (char *)buf;
+  while (size) {
+    ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool writeWorkerString(int fd, const std::string &str) {
+  uint32_t size = str.size();
+  return writeWorkerData(fd, &size, sizeof(size)) && writeWorkerData(fd, str.data(), size);
+}
+
+bool readWorkerString(int fd, std::string &str) {
+  uint32_t size;
+  if (!readWorkerData(fd, &size, sizeof(size)))
+    return false;
+  str.resize(size);
+  return readWorkerData(fd, &str[0], size);
+}
+
+WorkerStatistics getWorkerStatistics(RuntimeDataManager *rdManager) {
+  WorkerStatistics stats;
+  stats.allFormulaNum = rdManager->allFormulaNum;
+  stats.reusedFormulaNum = rdManager->reusedFormulaNum;
+  stats.solvingTimes = rdManager->solvingTimes;
+  stats.allGlobal = rdManager->allGlobal;
+  stats.brGlobal = rdManager->brGlobal;
+  stats.satBranch = rdManager->satBranch;
+  stats.unSatBranchBySolve = rdManager->unSatBranchBySolve;
+  stats.unSatBranchByPreSolve = rdManager->unSatBranchByPreSolve;
+  stats.runningCost = rdManager->runningCost;
+  stats.solvingCost = rdManager->solvingCost;
+  stats.satCost = rdManager->satCost;
+  stats.unSatCost = rdManager->unSatCost;
+  return stats;
+}
+
+void mergeWorkerStatistics(RuntimeDataManager *rdManager, const WorkerStatistics &stats) {
+  rdManager->allFormulaNum += stats.allFormulaNum;
+  rdManager->reusedFormulaNum += stats.reusedFormulaNum;
+  rdManager->solvingTimes += stats.solvingTimes;
+  rdManager->allGlobal += stats.allGlobal;
+  rdManager->brGlobal += stats.brGlobal;
+  rdManager->satBranch += stats.satBranch;
+  rdManager->unSatBranchBySolve += stats.unSatBranchBySolve;
+  rdManager->unSatBranchByPreSolve += stats.unSatBranchByPreSolve;
+  rdManager->runningCost += stats.runningCost;
+  rdManager->solvingCost += stats.solvingCost;
+  rdManager->satCost += stats.satCost;
+  rdManager->unSatCost += stats.unSatCost;
+}
+
+bool writeWorkerPrefix(int fd, Prefix *prefix) {
+  std::ostringstream out;
+  prefix->write(out);
+  return writeWorkerString(fd, out.str());
+}
+
+Prefix *readWorkerPrefix(int fd) {
+  std::string buffer;
+  if (!readWorkerString(fd, buffer))
+    return NULL;
+  std::istringstream in(buffer);
+  return Prefix::read(in);
+}
+
+// The coordinator socket lives in the abstract namespace, so there is no file
+// to clean up when the coordinator goes away.
+socklen_t getCoordinatorAddress(const std::string &name, struct sockaddr_un &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  size_t size = std::min(name.size(), sizeof(addr.sun_path) - 1);
+  memcpy(addr.sun_path + 1, name.data(), size);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + size;
+}
+
+int listenCoordinator(const std::string &name) {
+  struct sockaddr_un addr;
+  socklen_t size = getCoordinatorAddress(name, addr);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (bind(fd, (struct sockaddr *)&addr, size) || listen(fd, SOMAXCONN)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int connectCoordinator(const std::string &name) {
+  struct sockaddr_un addr;
+  socklen_t size = getCoordinatorAddress(name, addr);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, size)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// steps are plain data, the snapshot is forked from the same binary
+bool writeReplaySteps(int fd, const std::vector<Executor::ReplayStep> &steps) {
+  uint32_t size = steps.size();
+  return writeWorkerData(fd, &size, sizeof(size)) &&
+         writeWorkerData(fd, steps.data(), size * sizeof(Executor::ReplayStep));
+}
+
+bool readReplaySteps(int fd, std::vector<Executor::ReplayStep> &steps) {
+  uint32_t size;
+  if (!readWorkerData(fd, &size, sizeof(size)))
+    return false;
+  steps.resize(size);
+  return readWorkerData(fd, steps.data(), size * sizeof(Executor::ReplayStep));
+}
+
+// Returns the deepest snapshot whose steps are the first steps of prefix,
+// leaving at least one step to replay, or -1 if there is none.
+int findSnapshot(std::vector<VerificationSnapshot> &snapshots, Prefix *prefix) {
+  const std::vector<Prefix::Run> &runs = prefix->getRuns();
+  const std::vector<unsigned> &instIds = prefix->getInstIds();
+  const std::vector<std::pair<unsigned, uint64_t>> &children = prefix->getChildren();
+  int best = -1;
+  for (unsigned i = 0; i < snapshots.size(); i++) {
+    std::vector<Executor::ReplayStep> &steps = snapshots[i].steps;
+    if (steps.size() >= instIds.size() || (best >= 0 && steps.size() <= snapshots[best].steps.size()))
+      continue;
+    bool match = true;
+    unsigned run = 0, runEnd = runs[0].count, child = 0;
+    for (unsigned j = 0; j < steps.size() && match; j++) {
+      if (j == runEnd) {
+        runEnd += runs[++run].count;
+      }
+      match = runs[run].threadId == steps[j].threadId && instIds[j] == steps[j].instId;
+      if (match && steps[j].childThreadId) {
+        while (child < children.size() && children[child].first < j) {
+          child++;
+        }
+        match = child < children.size() && children[child].first == j &&
+                children[child].second == steps[j].childThreadId;
+      }
+    }
+    if (match) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// a resumed worker talks through one socket for both directions
+// A resumed worker that dies before it connects never shows up on the
+// coordinator socket, the coordinator looks for its pid instead. The snapshot
+// reaps its children so that a dead one leaves the process table.
+void reapResumedWorkers(int) {
+  int saved = errno;
+  while (waitpid(-1, NULL, WNOHANG) > 0) {
+  }
+  errno = saved;
+}
+
+bool isProcessGone(pid_t pid) {
+  return kill(pid, 0) && errno == ESRCH;
+}
+
+void closeWorker(VerificationWorker &worker) {
+  if (worker.toWorker >= 0) {
+    close(worker.toWorker);
+  }
+  if (worker.fromWorker >= 0 && worker.fromWorker != worker.toWorker) {
+    close(worker.fromWorker);
+  }
+}
+
+} // namespace
+
+// Replays the prefixes of the schedule set in up to KleemWorkers forked
+// processes. The coordinator keeps the schedule set and the tested traces, so
+// trace deduplication behaves exactly as in the serial mode. With snapshots, a
+// prefix is resumed from the deepest registered snapshot it extends.
+void Executor::runParallelVerification(llvm::Function *f, int argc, char **argv, char **envp) {
+  RuntimeDataManager *rdManager = listenerService->getRuntimeDataManager();
+  std::vector<VerificationWorker> workers;
+  std::vector<VerificationSnapshot> snapshots;
+  unsigned snapshotUse = 0;
+  int listenFd = -1;
+  bool initialRun = true;
+  // a worker or snapshot that went away must not kill us with SIGPIPE
+  signal(SIGPIPE, SIG_IGN);
+  if (KleemSnapshots) {
+    coordinatorName = "kleem-" + std::to_string(getpid());
+    listenFd = listenCoordinator(coordinatorName);
+    if (listenFd < 0) {
+      klee_error("cannot listen for snapshots: %s", strerror(errno));
+    }
+    kleem_note("Replay prefixes with %u worker processes, keeping up to %u snapshots.", (unsigned)KleemWorkers,
+               (unsigned)KleemSnapshots);
+  } else {
+    kleem_note("Replay prefixes with %u worker processes.", (unsigned)KleemWorkers);
+  }
+  while (true) {
+    while (workers.size() < KleemWorkers) {
+      Prefix *pref = NULL;
+      if (!initialRun) {
+        pref = rdManager->getNextPrefix();
+        if (!pref) {
+          break;
+        }
+      } else if (KleemSnapshots) {
+        // an empty prefix makes the initial run guided, so that its snapshots can be resumed
+        pref = new Prefix("initial");
+      }
+      initialRun = false;
+
+      int index = pref && !snapshots.empty() ? findSnapshot(snapshots, pref) : -1;
+      if (index >= 0) {
+        VerificationSnapshot &snapshot = snapshots[index];
+        uint8_t command = SNAPSHOT_RESUME;
+        uint32_t traceId = executionNum + 1;
+        int32_t child = 0;
+        if (writeWorkerData(snapshot.fd, &command, sizeof(command)) &&
+            writeWorkerData(snapshot.fd, &traceId, sizeof(traceId)) && writeWorkerPrefix(snapshot.fd, pref) &&
+            readWorkerData(snapshot.fd, &child, sizeof(child)) && child > 0) {
+          snapshot.lastUse = ++snapshotUse;
+          VerificationWorker worker;
+          worker.pid = child;
+          worker.toWorker = -1;
+          worker.fromWorker = -1;
+          worker.traceId = ++executionNum;
+          worker.analyzing = false;
+          worker.connecting = true;
+          worker.resumed = true;
+          workers.push_back(worker);
+          kleem_debug("Resume prefix %s from a snapshot at step %u.", pref->getName().c_str(),
+                      (unsigned)snapshot.steps.size());
+          delete pref;
+          continue;
+        }
+        // the snapshot is gone, replay the prefix from main
+        close(snapshot.fd);
+        snapshots.erase(snapshots.begin() + index);
+      }
+
+      int toWorker[2], fromWorker[2];
+      if (pipe(toWorker) || pipe(fromWorker)) {
+        klee_error("cannot create pipe for worker: %s", strerror(errno));
+      }
+      this->prefix = pref;
+      llvm::errs().flush();
+      fflush(NULL);
+      pid_t pid = ::fork();
+      if (pid < 0) {
+        klee_error("cannot fork worker: %s", strerror(errno));
+      }
+      if (pid == 0) {
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        for (auto &worker : workers) {
+          closeWorker(worker);
+        }
+        for (auto &snapshot : snapshots) {
+          close(snapshot.fd);
+        }
+        if (listenFd >= 0) {
+          close(listenFd);
+        }
+        runVerificationWorker(f, argc, argv, envp, toWorker[0], fromWorker[1]);
+        llvm::errs().flush();
+        fflush(NULL);
+        _exit(0);
+      }
+      close(toWorker[0]);
+      close(fromWorker[1]);
+      VerificationWorker worker;
+      worker.pid = pid;
+      worker.toWorker = toWorker[1];
+      worker.fromWorker = fromWorker[0];
+      worker.traceId = ++executionNum;
+      worker.analyzing = false;
+      worker.connecting = false;
+      worker.resumed = false;
+      workers.push_back(worker);
+      delete this->prefix;
+      this->prefix = NULL;
+    }
+    if (workers.empty()) {
+      break;
+    }
+
+    // connected workers first, then the coordinator socket, then the snapshots
+    std::vector<struct pollfd> fds;
+    int timeout = -1;
+    for (auto &worker : workers) {
+      struct pollfd pfd = {worker.fromWorker, POLLIN, 0};
+      fds.push_back(pfd);
+      if (worker.connecting) {
+        // check now and then that the pending worker is still alive
+        timeout = 100;
+      }
+    }
+    if (listenFd >= 0) {
+      struct pollfd pfd = {listenFd, POLLIN, 0};
+      fds.push_back(pfd);
+    }
+    for (auto &snapshot : snapshots) {
+      struct pollfd pfd = {snapshot.fd, POLLIN, 0};
+      fds.push_back(pfd);
+    }
+    if (poll(&fds[0], fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      klee_error("cannot poll workers: %s", strerror(errno));
+    }
+
+    if (listenFd >= 0) {
+      // a snapshot only talks when it is told to, anything else means it is gone
+      std::vector<VerificationSnapshot> alive;
+      for (unsigned i = 0; i < snapshots.size(); i++) {
+        if (fds[workers.size() + 1 + i].revents) {
+          close(snapshots[i].fd);
+        } else {
+          alive.push_back(snapshots[i]);
+        }
+      }
+      snapshots.swap(alive);
+
+      if (fds[workers.size()].revents) {
+        int fd = accept(listenFd, NULL, NULL);
+        uint8_t hello = 0;
+        if (fd >= 0 && readWorkerData(fd, &hello, sizeof(hello))) {
+          if (hello == WORKER_HELLO) {
+            uint32_t traceId = 0;
+            readWorkerData(fd, &traceId, sizeof(traceId));
+            for (auto &worker : workers) {
+              if (worker.connecting && worker.traceId == traceId) {
+                worker.toWorker = fd;
+                worker.fromWorker = fd;
+                worker.connecting = false;
+                fd = -1;
+                break;
+              }
+            }
+          } else if (hello == SNAPSHOT_HELLO) {
+            VerificationSnapshot snapshot;
+            snapshot.fd = fd;
+            snapshot.lastUse = ++snapshotUse;
+            if (readReplaySteps(fd, snapshot.steps)) {
+              snapshots.push_back(snapshot);
+              fd = -1;
+              if (snapshots.size() > KleemSnapshots) {
+                std::vector<VerificationSnapshot>::iterator lru = snapshots.begin();
+                for (auto si = snapshots.begin(), se = snapshots.end(); si != se; si++) {
+                  if (si->lastUse < lru->lastUse) {
+                    lru = si;
+                  }
+                }
+                close(lru->fd);
+                snapshots.erase(lru);
+              }
+            }
+          }
+        }
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+    }
+
+    std::vector<VerificationWorker> running;
+    for (unsigned i = 0; i < workers.size(); i++) {
+      VerificationWorker &worker = workers[i];
+      if (worker.connecting) {
+        if (isProcessGone(worker.pid)) {
+          kleem_debug("Trace%u died before it connected.", worker.traceId);
+          Trace *trace = rdManager->createNewTrace(worker.traceId);
+          trace->traceType = Trace::FAILED;
+          trace->isUntested = false;
+          rdManager->retireCurrentTrace();
+        } else {
+          running.push_back(worker);
+        }
+        continue;
+      }
+      if (!fds[i].revents) {
+        running.push_back(worker);
+        continue;
+      }
+      bool finished = true;
+      if (!worker.analyzing) {
+        uint8_t status = 0;
+        uint32_t size = 0;
+        bool success = readWorkerData(worker.fromWorker, &status, sizeof(status)) && status &&
+                       readWorkerData(worker.fromWorker, &size, sizeof(size));
+        Trace *trace = rdManager->createNewTrace(worker.traceId);
+        for (uint32_t j = 0; j < size && success; j++) {
+          std::string abstract;
+          success = readWorkerString(worker.fromWorker, abstract);
+          trace->abstract.push_back(abstract);
+        }
+        if (success) {
+          uint8_t verdict = rdManager->isCurrentTraceUntested();
+          trace->traceType = verdict ? Trace::UNIQUE : Trace::REDUNDANT;
+          worker.analyzing = writeWorkerData(worker.toWorker, &verdict, sizeof(verdict));
+          finished = !worker.analyzing;
+        } else {
+          trace->traceType = Trace::FAILED;
+          trace->isUntested = false;
+        }
+        rdManager->retireCurrentTrace();
+      } else {
+        WorkerStatistics stats;
+        uint32_t size = 0;
+        if (readWorkerData(worker.fromWorker, &stats, sizeof(stats)) &&
+            readWorkerData(worker.fromWorker, &size, sizeof(size))) {
+          mergeWorkerStatistics(rdManager, stats);
+          for (uint32_t j = 0; j < size; j++) {
+            Prefix *pref = readWorkerPrefix(worker.fromWorker);
+            if (!pref) {
+              break;
+            }
+            rdManager->addToScheduleSet(pref);
+          }
+        }
+      }
+      if (finished) {
+        closeWorker(worker);
+        if (!worker.resumed) {
+          waitpid(worker.pid, NULL, 0);
+        }
+      } else {
+        running.push_back(worker);
+      }
+    }
+    workers.swap(running);
+  }
+  // snapshots exit once their connection is closed
+  for (auto &snapshot : snapshots) {
+    close(snapshot.fd);
+  }
+  if (listenFd >= 0) {
+    close(listenFd);
+  }
+}
+
+// Body of a forked worker: replays this->prefix once and talks to the
+// coordinator through the pipes in and out.
+void Executor::runVerificationWorker(llvm::Function *f, int argc, char **argv, char **envp, int in, int out) {
+  RuntimeDataManager *rdManager = listenerService->getRuntimeDataManager();
+  // the prefixes inherited from the coordinator are not ours to replay
+  rdManager->clearAllPrefix();
+  WorkerStatistics before = getWorkerStatistics(rdManager);
+
+  // a process resumed from a snapshot returns from runFunctionAsMain with
+  // the connection it opened to the coordinator in workerIn and workerOut
+  workerIn = in;
+  workerOut = out;
+  replaySteps.clear();
+  snapshotNum = 0;
+  snapshotBranchNum = 0;
+
+  execStatus = SUCCESS;
+  listenerService->startControl(this);
+  runFunctionAsMain(f, argc, argv, envp);
+  in = workerIn;
+  out = workerOut;
+  uint8_t status = execStatus == SUCCESS;
+  if (!status) {
+    listenerService->endControl(this);
+    writeWorkerData(out, &status, sizeof(status));
+    return;
+  }
+
+  Trace *trace = rdManager->getCurrentTrace();
+  if (trace->abstract.empty()) {
+    trace->createAbstract();
+  }
+  uint32_t size = trace->abstract.size();
+  if (!writeWorkerData(out, &status, sizeof(status)) || !writeWorkerData(out, &size, sizeof(size))) {
+    return;
+  }
+  for (auto &abstract : trace->abstract) {
+    if (!writeWorkerString(out, abstract)) {
+      return;
+    }
+  }
+  uint8_t verdict;
+  if (!readWorkerData(in, &verdict, sizeof(verdict))) {
+    return;
+  }
+  trace->isUntested = verdict;
+  listenerService->analyzeTrace(this, verdict);
+
+  WorkerStatistics after = getWorkerStatistics(rdManager);
+  WorkerStatistics stats;
+  stats.allFormulaNum = after.allFormulaNum - before.allFormulaNum;
+  stats.reusedFormulaNum = after.reusedFormulaNum - before.reusedFormulaNum;
+  stats.solvingTimes = after.solvingTimes - before.solvingTimes;
+  stats.allGlobal = after.allGlobal - before.allGlobal;
+  stats.brGlobal = after.brGlobal - before.brGlobal;
+  stats.satBranch = after.satBranch - before.satBranch;
+  stats.unSatBranchBySolve = after.unSatBranchBySolve - before.unSatBranchBySolve;
+  stats.unSatBranchByPreSolve = after.unSatBranchByPreSolve - before.unSatBranchByPreSolve;
+  stats.runningCost = after.runningCost - before.runningCost;
+  stats.solvingCost = after.solvingCost - before.solvingCost;
+  stats.satCost = after.satCost - before.satCost;
+  stats.unSatCost = after.unSatCost - before.unSatCost;
+
+  std::vector<Prefix *> prefixes;
+  while (Prefix *pref = rdManager->getNextPrefix()) {
+    prefixes.push_back(pref);
+  }
+  size = prefixes.size();
+  if (!writeWorkerData(out, &stats, sizeof(stats)) || !writeWorkerData(out, &size, sizeof(size))) {
+    return;
+  }
+  for (auto pref : prefixes) {
+    if (!writeWorkerPrefix(out, pref)) {
+      return;
+    }
+  }
+}
+
+// Forks a snapshot of the current execution. The snapshot registers at the
+// coordinator and sleeps until it is asked to resume a prefix that extends
+// the steps executed so far. The forked child then returns from here with
+// that prefix and finishes the execution as a worker, while the snapshot
+// waits for the next request.
+void Executor::takeSnapshot() {
+  llvm::errs().flush();
+  fflush(NULL);
+  pid_t pid = ::fork();
+  if (pid != 0) {
+    // a failed snapshot only costs the replay of the prefix
+    snapshotNum++;
+    return;
+  }
+
+  close(workerIn);
+  close(workerOut);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = reapResumedWorkers;
+  action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigaction(SIGCHLD, &action, NULL);
+  int fd = connectCoordinator(coordinatorName);
+  uint8_t hello = SNAPSHOT_HELLO;
+  if (fd < 0 || !writeWorkerData(fd, &hello, sizeof(hello)) || !writeReplaySteps(fd, replaySteps)) {
+    _exit(0);
+  }
+  while (true) {
+    uint8_t command;
+    uint32_t traceId;
+    if (!readWorkerData(fd, &command, sizeof(command)) || command != SNAPSHOT_RESUME ||
+        !readWorkerData(fd, &traceId, sizeof(traceId))) {
+      _exit(0);
+    }
+    Prefix *pref = readWorkerPrefix(fd);
+    if (!pref) {
+      _exit(0);
+    }
+    llvm::errs().flush();
+    fflush(NULL);
+    pid_t child = ::fork();
+    if (child == 0) {
+      close(fd);
+      signal(SIGCHLD, SIG_DFL);
+      int worker = connectCoordinator(coordinatorName);
+      hello = WORKER_HELLO;
+      if (worker < 0 || !writeWorkerData(worker, &hello, sizeof(hello)) ||
+          !writeWorkerData(worker, &traceId, sizeof(traceId))) {
+        _exit(0);
+      }
+      workerIn = worker;
+      workerOut = worker;
+      unsigned step = replaySteps.size();
+      prefix->rebase(*pref, step);
+      delete pref;
+      executionNum = traceId;
+      snapshotNum = 0;
+      snapshotBranchNum = 0;
+      listenerService->resumeControl(this, step);
+      return;
+    }
+    delete pref;
+    // the coordinator waits for the child to connect as long as its pid lives
+    int32_t resumed = child > 0 ? child : 0;
+    if (!writeWorkerData(fd, &resumed, sizeof(resumed))) {
+      _exit(0);
+    }
+  }
+}
+
 void Executor::prepareNextExecution() {
   for (std::set<ExecutionState *>::const_iterator it = states.begin(), ie = states.end(); it != ie; ++it) {
     llvm::errs() << "=====================\n";
@@ -5224,12 +6009,11 @@ void Executor::printInstrcution(ExecutionState &state, KInstruction *ki) {
   }
 
   out.close();
-  if (prefix && prefix->current() + 1 == prefix->end()) {
+  if (prefix && prefix->getPosition() + 1 == prefix->size()) {
     inst->print(errs());
-    Event *event = *prefix->current();
     ref<Expr> param = eval(ki, 0, state).value;
     ConstantExpr *condition = dyn_cast<ConstantExpr>(param);
-    if (condition->getAPValue().getBoolValue() != event->brCondition) {
+    if (condition->getAPValue().getBoolValue() != prefix->getBrCondition()) {
       llvm::errs() << "\n前缀已被取反\n";
     } else {
       llvm::errs() << "\n前缀未被取反\n";
@@ -5271,10 +6055,11 @@ unsigned Executor::executePThreadCreate(ExecutionState &state, KInstruction *ki,
 
     // vector clock : creat
     Thread *thread = state.getCurrentThread();
-    for (unsigned i = 0; i < thread->vectorClock.size(); i++) {
-      newThread->vectorClock[i] = thread->vectorClock[i];
+    newThread->vectorClock = thread->vectorClock;
+    newThread->vectorClock.tick(newThread->threadId);
+    if (!replaySteps.empty()) {
+      replaySteps.back().childThreadId = newThread->threadId;
     }
-    newThread->vectorClock[newThread->threadId]++;
 
     state.currentStack = newThread->stack;
     bindArgument(kthreadEntrance, 0, state, arguments[3]);
@@ -5295,6 +6080,22 @@ unsigned Executor::executePThreadCreate(ExecutionState &state, KInstruction *ki,
   return 0;
 }
 
+bool Executor::checkDeadlock(ExecutionState &state, Thread *thread) {
+  std::vector<Thread *> cycle;
+  if (!state.findDeadlock(thread, cycle)) {
+    return false;
+  }
+  kleem_note("Deadlock of %u threads.", (unsigned)cycle.size());
+  for (auto waiting : cycle) {
+    std::string stack;
+    llvm::raw_string_ostream out(stack);
+    waiting->dumpStack(out);
+    kleem_note("Thread %u waits for Thread %u at:\n%s", waiting->threadId,
+               state.getWaitedThread(waiting)->threadId, out.str().c_str());
+  }
+  return true;
+}
+
 // execute pthread_join
 // if the first pointer is not point to a unsigned int, this function will crash
 unsigned Executor::executePThreadJoin(ExecutionState &state, KInstruction *ki, std::vector<ref<Expr>> &arguments) {
@@ -5314,7 +6115,7 @@ unsigned Executor::executePThreadJoin(ExecutionState &state, KInstruction *ki, s
           ji->second.push_back(state.currentThread->threadId);
         }
         state.swapOutThread(state.currentThread, false, false, true, false);
-        ;
+        checkDeadlock(state, state.currentThread);
       }
     } else {
       assert(0 && "thread not exist!");
@@ -5335,12 +6136,12 @@ unsigned Executor::executePThreadCondWait(ExecutionState &state, KInstruction *k
   if (!condAddress) {
     assert(0 && "cond address is not const");
   }
-  std::string condName = Transfer::uint64toString(condAddress->getZExtValue());
-  std::string mutexName = Transfer::uint64toString(mutexAddress->getZExtValue());
   std::string errorMsg;
-  bool isSuccess = state.condManager.wait(condName, mutexName, state.currentThread->threadId, errorMsg);
+  bool isSuccess = state.condManager.wait(condAddress->getZExtValue(), mutexAddress->getZExtValue(),
+                                          state.currentThread->threadId, errorMsg);
   if (isSuccess) {
     state.swapOutThread(state.currentThread, true, false, false, false);
+    state.swapInWokenThreads();
   } else {
     llvm::errs() << errorMsg << "\n";
     assert(0 && "wait error");
@@ -5355,10 +6156,9 @@ unsigned Executor::executePThreadCondSignal(ExecutionState &state, KInstruction
   if (!condAddress) {
     assert(0 && "cond address is not const");
   }
-  std::string condName = Transfer::uint64toString(condAddress->getZExtValue());
   std::string errorMsg;
   unsigned releasedThreadId;
-  bool isSuccess = state.condManager.signal(condName, releasedThreadId, errorMsg);
+  bool isSuccess = state.condManager.signal(condAddress->getZExtValue(), releasedThreadId, errorMsg);
   if (isSuccess) {
     if (releasedThreadId != 0) {
       state.swapInThread(releasedThreadId, false, true);
@@ -5366,12 +6166,8 @@ unsigned Executor::executePThreadCondSignal(ExecutionState &state, KInstruction
       // vector clock : signal
       Thread *thread = state.getCurrentThread();
       Thread *tthread = state.findThreadById(releasedThreadId);
-      for (unsigned i = 0; i < tthread->vectorClock.size(); i++) {
-        if (tthread->vectorClock[i] < thread->vectorClock[i]) {
-          tthread->vectorClock[i] = thread->vectorClock[i];
-        }
-      }
-      thread->vectorClock[thread->threadId]++;
+      tthread->vectorClock.merge(thread->vectorClock);
+      thread->vectorClock.tick(thread->threadId);
     }
   } else {
     llvm::errs() << errorMsg << "\n";
@@ -5387,10 +6183,9 @@ unsigned Executor::executePThreadCondBroadcast(ExecutionState &state, KInstructi
   if (!condAddress) {
     assert(0 && "cond address is not const");
   }
-  std::string condName = Transfer::uint64toString(condAddress->getZExtValue());
   std::vector<unsigned> threadList;
   std::string errorMsg;
-  bool isSuccess = state.condManager.broadcast(condName, threadList, errorMsg);
+  bool isSuccess = state.condManager.broadcast(condAddress->getZExtValue(), threadList, errorMsg);
   if (isSuccess) {
     std::vector<unsigned>::iterator ti, te;
     std::vector<bool>::iterator bi;
@@ -5400,12 +6195,8 @@ unsigned Executor::executePThreadCondBroadcast(ExecutionState &state, KInstructi
       // vector clock : signal
       Thread *thread = state.getCurrentThread();
       Thread *tthread = state.findThreadById(*ti);
-      for (unsigned i = 0; i < tthread->vectorClock.size(); i++) {
-        if (tthread->vectorClock[i] < thread->vectorClock[i]) {
-          tthread->vectorClock[i] = thread->vectorClock[i];
-        }
-      }
-      thread->vectorClock[thread->threadId]++;
+      tthread->vectorClock.merge(thread->vectorClock);
+      thread->vectorClock.tick(thread->threadId);
     }
   } else {
     llvm::errs() << errorMsg << "\n";
@@ -5420,13 +6211,15 @@ unsigned Executor::executePThreadMutexLock(ExecutionState &state, KInstruction *
   ConstantExpr *mutexAddress = dyn_cast<ConstantExpr>(address);
   // cerr << " lock param : " << mutexAddress->getZExtValue();
   if (mutexAddress) {
-    std::string key = Transfer::uint64toString(mutexAddress->getZExtValue());
     std::string errorMsg;
     bool isBlocked;
-    bool isSuccess = state.mutexManager.lock(key, state.currentThread->threadId, isBlocked, errorMsg);
+    bool isSuccess =
+        state.mutexManager.lock(mutexAddress->getZExtValue(), state.currentThread->threadId, isBlocked, errorMsg);
     if (isSuccess) {
       if (isBlocked) {
         state.switchThreadToMutexBlocked(state.currentThread);
+        state.swapOutThread(state.currentThread, false, false, false, false);
+        checkDeadlock(state, state.currentThread);
       }
     } else {
       llvm::errs() << errorMsg << "\n";
@@ -5444,13 +6237,13 @@ unsigned Executor::executePThreadMutexUnlock(ExecutionState &state, KInstruction
   ref<Expr> address = arguments[0];
   ConstantExpr *mutexAddress = dyn_cast<ConstantExpr>(address);
   if (mutexAddress) {
-    std::string key = Transfer::uint64toString(mutexAddress->getZExtValue());
     std::string errorMsg;
-    bool isSuccess = state.mutexManager.unlock(key, errorMsg);
+    bool isSuccess = state.mutexManager.unlock(mutexAddress->getZExtValue(), errorMsg);
     if (!isSuccess) {
       llvm::errs() << errorMsg << "\n";
       assert(0 && "unlock error");
     }
+    state.swapInWokenThreads();
   } else {
     assert(0 && "mutex address is not const");
   }
@@ -5468,9 +6261,8 @@ unsigned Executor::executePThreadBarrierInit(ExecutionState &state, KInstruction
   if (!count) {
     assert(0 && "count is not const");
   }
-  std::string barrierName = Transfer::uint64toString(barrierAddress->getZExtValue());
   std::string errorMsg;
-  bool isSuccess = state.barrierManager.init(barrierName, count->getZExtValue(), errorMsg);
+  bool isSuccess = state.barrierManager.init(barrierAddress->getZExtValue(), count->getZExtValue(), errorMsg);
   if (!isSuccess) {
     llvm::errs() << errorMsg << "\n";
     assert(0 && "barrier init error");
@@ -5485,12 +6277,11 @@ unsigned Executor::executePThreadBarrierWait(ExecutionState &state, KInstruction
   if (!barrierAddress) {
     assert(0 && "barrier address is not const");
   }
-  std::string barrierName = Transfer::uint64toString(barrierAddress->getZExtValue());
   std::vector<unsigned> blockedList;
   bool isReleased = false;
   std::string errorMsg;
-  bool isSuccess =
-      state.barrierManager.wait(barrierName, state.currentThread->threadId, isReleased, blockedList, errorMsg);
+  bool isSuccess = state.barrierManager.wait(barrierAddress->getZExtValue(), state.currentThread->threadId, isReleased,
+                                             blockedList, errorMsg);
   if (isSuccess) {
     if (isReleased) {
       // may be a bottleneck as time complexity is O(n*n)
@@ -5587,20 +6378,17 @@ void Executor::createSpecialElement(ExecutionState &state, Type *type, uint64_t
           startAddress = (startAddress / alignment + 1) * alignment;
         }
         if (type->getStructName() == "union.pthread_mutex_t") {
-          std::string mutexName = Transfer::uint64toString(startAddress);
-          state.mutexManager.addMutex(mutexName, errorMsg);
-          // llvm::errs() << "mutexName : " << mutexName << "\n";
+          state.mutexManager.addMutex(startAddress, errorMsg);
           startAddress += kmodule->targetData->getTypeSizeInBits(type) / 8;
         } else if (type->getStructName() == "union.pthread_cond_t") {
-          std::string condName = Transfer::uint64toString(startAddress);
           if (prefix) {
-            state.condManager.addCondition(condName, errorMsg, prefix);
+            state.condManager.addCondition(startAddress, errorMsg, prefix);
           } else {
-            state.condManager.addCondition(condName, errorMsg);
+            state.condManager.addCondition(startAddress, errorMsg);
           }
           startAddress += kmodule->targetData->getTypeSizeInBits(type) / 8;
         } else if (type->getStructName() == "union.pthread_barrier_t") {
-          state.barrierManager.addBarrier(Transfer::uint64toString(startAddress), errorMsg);
+          state.barrierManager.addBarrier(startAddress, errorMsg);
           startAddress += kmodule->targetData->getTypeSizeInBits(type) / 8;
         } else {
           unsigned num = type->getStructNumElements();
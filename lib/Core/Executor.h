@@ -127,6 +127,14 @@ public:
 
   enum ExecStatus { SUCCESS, IGNOREDERROR, RUNTIMEERROR };
 
+  // an executed instruction, recorded when snapshots are enabled so that a
+  // prefix can be matched against the steps a snapshot has executed
+  struct ReplayStep {
+    unsigned threadId;
+    unsigned instId; // InstructionInfo id
+    uint64_t childThreadId; // thread created by this step, 0 if none
+  };
+
 private:
   static const char *TerminateReasonNames[];
 
@@ -175,6 +183,17 @@ private:
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
 
+  /// Address space holding argv and the initialized globals. It is built
+  /// by the first execution and copied into the initial state of the
+  /// later ones, whose objects are shared until they are written.
+  std::unique_ptr<AddressSpace> initialAddressSpace;
+
+  /// The argv object bound in initialAddressSpace, if main takes one.
+  MemoryObject *initialArgvMO;
+
+  /// The same image for the shadow address spaces of the listeners.
+  std::unique_ptr<AddressSpace> initialShadowAddressSpace;
+
   /// When non-null the bindings that will be used for calls to
   /// klee_make_symbolic in order replay.
   const struct KTest *replayKTest;
@@ -240,8 +259,20 @@ private:
 
   Prefix *prefix; // prefix used to guide execution
 
+  bool isVisibleStep; // the executing instruction is a step of the prefixes
+
   unsigned executionNum; // total number of execution
 
+  std::vector<ReplayStep> replaySteps; // steps of the current execution, only kept for snapshots
+
+  unsigned snapshotNum; // snapshots taken in the current execution
+
+  unsigned snapshotBranchNum; // conditional branches executed after the prefix
+
+  int workerIn, workerOut; // channel of a worker process to the coordinator
+
+  std::string coordinatorName; // abstract socket on which the coordinator accepts snapshots
+
   ExecStatus execStatus;
 
   static bool hasInitialized;
@@ -539,6 +570,9 @@ private:
   unsigned executePThreadBarrierDestory(ExecutionState &state, KInstruction *ki,
                                         std::vector<ref<Expr>> &arguments);
 
+  // reports a cycle of the wait-for graph through a thread that just blocked
+  bool checkDeadlock(ExecutionState &state, Thread *thread);
+
   void handleInitializers(ExecutionState &initialState);
 
   void createSpecialElement(ExecutionState &state, llvm::Type *type,
@@ -626,9 +660,13 @@ public:
                        AddressSpace *addressSpace, ref<Expr> address);
 
   bool isGlobalMO(const MemoryObject *mo);
+  bool isVisibleInstruction(ExecutionState &state, KInstruction *ki);
   TimingSolver *getTimeSolver() { return solver; }
   bool isFunctionSpecial(llvm::Function *f);
   void runVerification(llvm::Function *f, int argc, char **argv, char **envp);
+  void runParallelVerification(llvm::Function *f, int argc, char **argv, char **envp);
+  void runVerificationWorker(llvm::Function *f, int argc, char **argv, char **envp, int in, int out);
+  void takeSnapshot();
   void prepareNextExecution();
   void prepareNewPrefix();
   void printInstrcution(ExecutionState &state, KInstruction *ki);
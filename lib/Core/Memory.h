@@ -38,6 +38,7 @@ class MemoryObject {
   friend class ExecutionState;
   friend class ref<MemoryObject>;
   friend class ref<const MemoryObject>;
+  friend class MemoryManager;
 
 private:
   static int counter;
@@ -61,7 +61,7 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
 /***/
 MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     : arrayCache(_arrayCache), deterministicSpace(0), nextFreeSlot(0),
-      spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
+      frozenFreeSlot(0), spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
   if (DeterministicAllocation) {
     // Page boundary
     void *expectedAddress = (void *)DeterministicStartAddress.getValue();
@@ -80,6 +80,7 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     klee_message("Deterministic memory allocation starting from %p", newSpace);
     deterministicSpace = newSpace;
     nextFreeSlot = newSpace;
+    frozenFreeSlot = newSpace;
   }
 }
 
@@ -182,9 +183,42 @@ void MemoryManager::markFreed(MemoryObject *mo) {
     if (!mo->isFixed && !DeterministicAllocation)
       free((void *)mo->address);
     objects.erase(mo);
+    frozenObjects.erase(mo);
   }
 }
 
+void MemoryManager::freeze() {
+  frozenObjects = objects;
+  frozenFreeSlot = nextFreeSlot;
+}
+
+void MemoryManager::reset() {
+  bool referenced = false;
+  for (objects_ty::iterator it = objects.begin(); it != objects.end();) {
+    MemoryObject *mo = *it;
+    if (frozenObjects.count(mo)) {
+      ++it;
+      continue;
+    }
+    // an object something still refers to is released with its last
+    // reference, through markFreed
+    if (mo->_refCount.getCount()) {
+      referenced = true;
+      ++it;
+      continue;
+    }
+    if (!mo->isFixed && !DeterministicAllocation)
+      free((void *)mo->address);
+    it = objects.erase(it);
+    delete mo;
+  }
+
+  // the deterministic space above the frozen objects is handed out again,
+  // unless an object of this execution still lives there
+  if (DeterministicAllocation && !referenced)
+    nextFreeSlot = frozenFreeSlot;
+}
+
 size_t MemoryManager::getUsedDeterministicSize() {
   return nextFreeSlot - deterministicSpace;
 }
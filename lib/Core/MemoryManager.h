@@ -26,10 +26,12 @@ class MemoryManager {
 private:
   typedef std::set<MemoryObject *> objects_ty;
   objects_ty objects;
+  objects_ty frozenObjects;
   ArrayCache *const arrayCache;
 
   char *deterministicSpace;
   char *nextFreeSlot;
+  char *frozenFreeSlot;
   size_t spaceSize;
 
 public:
@@ -48,6 +50,14 @@ public:
   void markFreed(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
 
+  /// Keep the objects allocated so far across calls to reset().
+  void freeze();
+
+  /// Release every object allocated since freeze(), as deleting and
+  /// recreating the manager would do for them. An object that is still
+  /// referenced is left to its last reference.
+  void reset();
+
   /*
    * Returns the size used by deterministic allocation in bytes
    */
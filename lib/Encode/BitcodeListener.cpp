@@ -19,4 +19,11 @@ BitcodeListener::BitcodeListener(RuntimeDataManager *rdManager) : kind(defaultKi
 
 BitcodeListener::~BitcodeListener() {}
 
+void BitcodeListener::releaseShadowMemory() {
+  for (auto &item : stack) {
+    item.second->realStack.clear();
+  }
+  addressSpace.objects = MemoryMap();
+}
+
 } // namespace klee
@@ -0,0 +1,392 @@
+//===-- DPOR.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+#include "klee/Encode/DPOR.h"
+#include "klee/Encode/PrefixScheduler.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Support/ErrorHandling.h"
+
+using namespace ::std;
+
+namespace klee {
+
+DPOR::DPOR(RuntimeDataManager *data) : runtimeData(data), trace(data->getCurrentTrace()) {}
+
+DPOR::~DPOR() {}
+
+unsigned DPOR::getObjectId(const std::string &key) {
+  auto result = objectIds.insert(make_pair(key, (unsigned)objectIds.size()));
+  if (result.second) {
+    objectKeys.push_back(hash<string>()(key));
+  }
+  return result.first->second;
+}
+
+// The keys get a letter for their kind, a mutex is also a global variable.
+void DPOR::collectAccesses() {
+  vector<Event *> &path = trace->path;
+  unordered_map<Event *, unsigned> positions;
+  positions.reserve(path.size());
+  for (unsigned i = 0; i < path.size(); i++) {
+    positions[path[i]] = i;
+  }
+  accesses.assign(path.size(), vector<Access>());
+  auto add = [&](Event *event, AccessKind kind, unsigned object) {
+    // the VIRTUAL events are not in the path
+    auto pi = event ? positions.find(event) : positions.end();
+    if (pi != positions.end()) {
+      Access access = {kind, object};
+      accesses[pi->second].push_back(access);
+    }
+  };
+
+  // the filter of the encoder keeps the whole sets in allReadSet and allWriteSet
+  const unordered_map<string, vector<Event *>> &reads = trace->allReadSet.empty() ? trace->readSet : trace->allReadSet;
+  const unordered_map<string, vector<Event *>> &writes =
+      trace->allWriteSet.empty() ? trace->writeSet : trace->allWriteSet;
+  for (auto &read : reads) {
+    unsigned id = getObjectId("v" + read.first);
+    for (auto event : read.second) {
+      add(event, Read, id);
+    }
+  }
+  for (auto &write : writes) {
+    unsigned id = getObjectId("v" + write.first);
+    for (auto event : write.second) {
+      add(event, Write, id);
+    }
+  }
+  for (auto &mutex : trace->all_lock_unlock) {
+    unsigned id = getObjectId("m" + mutex.first);
+    for (auto lockPair : mutex.second) {
+      add(lockPair->lockEvent, Lock, id);
+      add(lockPair->unlockEvent, Unlock, id);
+    }
+  }
+  for (auto &cond : trace->all_wait) {
+    unsigned id = getObjectId("c" + cond.first);
+    for (auto wait : cond.second) {
+      add(wait->wait, Sync, id);
+    }
+  }
+  for (auto &cond : trace->all_signal) {
+    unsigned id = getObjectId("c" + cond.first);
+    for (auto event : cond.second) {
+      add(event, Sync, id);
+    }
+  }
+  for (auto &barrier : trace->all_barrier) {
+    unsigned id = getObjectId("b" + barrier.first);
+    for (auto event : barrier.second) {
+      add(event, Sync, id);
+    }
+  }
+}
+
+// One pass over the path. The clock of an event is built from the clock of
+// its thread, the events it conflicts with, the last operation on its mutex
+// or synchronization object and the thread it joins. The conflicting events
+// are merged latest first: an event that is not yet covered when it is merged
+// is ordered with the current one only through the conflict, so they race.
+// The races of the events before from were checked on an earlier trace, and
+// the event at reversed is the second one of the race a DPOR prefix reversed.
+void DPOR::computeRaces(unsigned from, unsigned reversed) {
+  vector<Event *> &path = trace->path;
+  vector<VectorClock> threadClocks;
+  vector<ObjectState> objects(objectIds.size());
+  clocks.assign(path.size(), VectorClock());
+  steps.assign(path.size(), 0);
+  vector<unsigned> candidates;
+  for (unsigned pos = 0; pos < path.size(); pos++) {
+    Event *event = path[pos];
+    unsigned threadId = event->threadId;
+    if (threadId >= threadClocks.size()) {
+      threadClocks.resize(threadId + 1);
+    }
+    VectorClock &clock = threadClocks[threadId];
+
+    candidates.clear();
+    for (auto &access : accesses[pos]) {
+      ObjectState &object = objects[access.object];
+      if ((access.kind == Read || access.kind == Write) && object.lastWrite >= 0) {
+        candidates.push_back(object.lastWrite);
+      }
+      if (access.kind == Write) {
+        candidates.insert(candidates.end(), object.readsSinceWrite.begin(), object.readsSinceWrite.end());
+      }
+      if (access.kind == Lock && object.lastLock >= 0) {
+        candidates.push_back(object.lastLock);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(), greater<unsigned>());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for (auto candidate : candidates) {
+      unsigned other = path[candidate]->threadId;
+      if (other != threadId && clock.get(other) < steps[candidate] && pos >= from && candidate != reversed) {
+        Race race = {candidate, pos, clock};
+        races.push_back(race);
+      }
+      clock.merge(clocks[candidate]);
+    }
+
+    for (auto &access : accesses[pos]) {
+      ObjectState &object = objects[access.object];
+      if (access.kind != Read && access.kind != Write && object.lastOperation >= 0) {
+        clock.merge(clocks[object.lastOperation]);
+      }
+    }
+    auto ji = trace->joinThreadPoint.find(event);
+    if (ji != trace->joinThreadPoint.end() && ji->second < threadClocks.size()) {
+      clock.merge(threadClocks[ji->second]);
+    }
+    clock.tick(threadId);
+    steps[pos] = clock.get(threadId);
+    if (!accesses[pos].empty()) {
+      clocks[pos] = clock;
+    }
+    auto ci = trace->createThreadPoint.find(event);
+    if (ci != trace->createThreadPoint.end()) {
+      if (ci->second >= threadClocks.size()) {
+        threadClocks.resize(ci->second + 1);
+      }
+      threadClocks[ci->second].merge(threadClocks[threadId]);
+    }
+
+    for (auto &access : accesses[pos]) {
+      ObjectState &object = objects[access.object];
+      switch (access.kind) {
+        case Read: {
+          object.readsSinceWrite.push_back(pos);
+          break;
+        }
+        case Write: {
+          object.lastWrite = pos;
+          object.readsSinceWrite.clear();
+          break;
+        }
+        case Lock: {
+          object.lastLock = pos;
+          object.lastOperation = pos;
+          break;
+        }
+        default: {
+          object.lastOperation = pos;
+          break;
+        }
+      }
+    }
+  }
+}
+
+// The steps of the prefixes are the visible events, two paths with the same
+// steps before a position reach the same state there.
+void DPOR::computeStates() {
+  vector<Event *> &path = trace->path;
+  states.assign(path.size(), 0);
+  uint64_t state = 0xcbf29ce484222325ULL;
+  for (unsigned pos = 0; pos < path.size(); pos++) {
+    states[pos] = state;
+    Event *event = path[pos];
+    if (event->isVisible) {
+      state = (state ^ ((uint64_t)event->threadId << 32 | event->inst->info->id)) * 0x100000001b3ULL;
+    }
+  }
+}
+
+// The events between the two of the race that the second one depends on keep
+// their order, the first one and whatever follows it in its thread are left
+// to the free scheduling after the prefix.
+void DPOR::getKeptEvents(Race &race, vector<unsigned> &kept) {
+  vector<Event *> &path = trace->path;
+  unsigned threadId = path[race.second]->threadId;
+  kept.clear();
+  for (unsigned pos = race.first; pos <= race.second; pos++) {
+    unsigned other = path[pos]->threadId;
+    if (steps[pos] <= race.limit.get(other) + (other == threadId)) {
+      kept.push_back(pos);
+    }
+  }
+}
+
+// The threads whose first kept event depends on no other kept event. The
+// clock of an event without accesses is not kept, such an event only counts
+// if it is the first one, which leaves out initials but never adds one.
+void DPOR::getInitials(vector<unsigned> &kept, vector<unsigned> &initials) {
+  vector<Event *> &path = trace->path;
+  vector<unsigned> seen;
+  initials.clear();
+  for (unsigned i = 0; i < kept.size(); i++) {
+    unsigned pos = kept[i];
+    unsigned threadId = path[pos]->threadId;
+    if (find(seen.begin(), seen.end(), threadId) != seen.end()) {
+      continue;
+    }
+    seen.push_back(threadId);
+    bool initial = i == 0 || !accesses[pos].empty();
+    for (unsigned j = 0; j < i && initial; j++) {
+      initial = clocks[pos].get(path[kept[j]]->threadId) < steps[kept[j]];
+    }
+    if (initial) {
+      initials.push_back(threadId);
+    }
+  }
+}
+
+bool DPOR::conflicts(const Prefix::SleepAccess &sleeping, unsigned pos) {
+  if (sleeping.kind == None) {
+    return false;
+  }
+  for (auto &access : accesses[pos]) {
+    if (objectKeys[access.object] == sleeping.object && (access.kind != Read || sleeping.kind != Read)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the threads asleep before the event at pos that it wakes: its own thread
+// and those whose next event conflicts with it
+void DPOR::wake(vector<Prefix::SleepAccess> &sleep, unsigned pos) {
+  unsigned threadId = trace->path[pos]->threadId;
+  vector<unsigned> woken(1, threadId);
+  for (auto &sleeping : sleep) {
+    if (conflicts(sleeping, pos)) {
+      woken.push_back(sleeping.threadId);
+    }
+  }
+  sleep.erase(remove_if(sleep.begin(), sleep.end(),
+                        [&](const Prefix::SleepAccess &sleeping) {
+                          return find(woken.begin(), woken.end(), sleeping.threadId) != woken.end();
+                        }),
+              sleep.end());
+}
+
+// puts threadId to sleep with the accesses of its first event from the given
+// position on
+void DPOR::addSleeping(vector<Prefix::SleepAccess> &sleep, unsigned threadId, unsigned from) {
+  vector<Event *> &path = trace->path;
+  for (auto &sleeping : sleep) {
+    if (sleeping.threadId == threadId) {
+      return;
+    }
+  }
+  unsigned pos = from;
+  while (pos < path.size() && path[pos]->threadId != threadId) {
+    pos++;
+  }
+  if (pos == path.size()) {
+    return;
+  }
+  for (auto &access : accesses[pos]) {
+    Prefix::SleepAccess sleeping = {threadId, (unsigned)access.kind, objectKeys[access.object]};
+    sleep.push_back(sleeping);
+  }
+  if (accesses[pos].empty()) {
+    Prefix::SleepAccess sleeping = {threadId, (unsigned)None, 0};
+    sleep.push_back(sleeping);
+  }
+}
+
+void DPOR::addPrefix(Race &race, vector<unsigned> &kept, vector<unsigned> &initials,
+                     vector<Prefix::SleepAccess> &sleep) {
+  vector<Event *> &path = trace->path;
+  vector<Event *> events(path.begin(), path.begin() + race.first);
+  for (auto pos : kept) {
+    events.push_back(path[pos]);
+  }
+  stringstream name;
+  name << "dpor_Trace" << trace->Id << "#" << path[race.first]->eventName << "-" << path[race.second]->eventName;
+  Prefix *prefix = new Prefix(events, trace->createThreadPoint, name.str());
+  vector<unsigned> threads(1, path[race.first]->threadId);
+  threads.insert(threads.end(), initials.begin(), initials.end());
+  prefix->setDPOR(states[race.first], threads, sleep);
+  runtimeData->addToScheduleSet(prefix);
+}
+
+// The races are taken by the position of their first event, so that the
+// sleep set is carried along the path once. Before the end of the prefix the
+// sleep set is not known, those states only check their own reversals.
+void DPOR::addRacePrefixes(Prefix *prefix) {
+  unsigned replayed = prefix ? getReplayedEvents(trace, prefix->size()) : 0;
+  bool isReversal = prefix && PrefixScheduler::isDPORPrefix(prefix);
+  collectAccesses();
+  computeStates();
+  // a DPOR prefix keeps the path before the race it reverses, the events
+  // after that may race in their new order
+  unsigned from = replayed, last = trace->path.size();
+  if (isReversal && replayed) {
+    from = find(states.begin(), states.begin() + replayed, prefix->getDPORState()) - states.begin();
+    last = replayed - 1;
+  }
+  computeRaces(from, last);
+  stable_sort(races.begin(), races.end(), [](const Race &a, const Race &b) { return a.first < b.first; });
+
+  vector<Prefix::SleepAccess> sleep, none;
+  if (isReversal) {
+    sleep = prefix->getSleepSet();
+  }
+  unsigned pos = replayed, state = trace->path.size(), reversed = 0;
+  vector<unsigned> explored, kept, initials;
+  for (auto &race : races) {
+    for (; pos < race.first; pos++) {
+      wake(sleep, pos);
+    }
+    if (race.first != state) {
+      state = race.first;
+      explored.clear();
+    }
+    vector<Prefix::SleepAccess> &asleep = race.first < replayed ? none : sleep;
+    getKeptEvents(race, kept);
+    getInitials(kept, initials);
+    bool redundant = false;
+    for (auto threadId : initials) {
+      redundant |= find(explored.begin(), explored.end(), threadId) != explored.end();
+      for (auto &sleeping : asleep) {
+        redundant |= sleeping.threadId == threadId;
+      }
+    }
+    if (redundant) {
+      continue;
+    }
+
+    vector<Prefix::SleepAccess> next = asleep;
+    addSleeping(next, trace->path[race.first]->threadId, race.first);
+    for (auto threadId : explored) {
+      addSleeping(next, threadId, race.first);
+    }
+    for (auto kpos : kept) {
+      wake(next, kpos);
+    }
+    explored.push_back(initials[0]);
+    addPrefix(race, kept, initials, next);
+    reversed++;
+  }
+  kleem_exploration("Reverse %u of %u races of Trace%u.", reversed, (unsigned)races.size(), trace->Id);
+}
+
+unsigned DPOR::getRaceNumber() {
+  return races.size();
+}
+
+unsigned DPOR::getReplayedEvents(Trace *trace, unsigned prefixSteps) {
+  unsigned pos = 0, visible = 0;
+  while (pos < trace->path.size() && visible < prefixSteps) {
+    if (trace->path[pos]->isVisible) {
+      visible++;
+    }
+    pos++;
+  }
+  return pos;
+}
+
+} /* namespace klee */
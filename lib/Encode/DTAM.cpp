@@ -7,152 +7,173 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <llvm/Support/CommandLine.h>
+
 #include "klee/ADT/Ref.h"
 #include "klee/Encode/DTAM.h"
 #include "klee/Encode/Event.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Support/OptionCategories.h"
+
+namespace {
+llvm::cl::opt<unsigned> DTAMThreads("kleem-dtam-threads",
+                                    llvm::cl::desc("Propagate the taint of a trace with this many threads (default=1)"),
+                                    llvm::cl::init(1), llvm::cl::cat(klee::KleemCat));
+} // namespace
 
 namespace klee {
 
-DTAM::DTAM(RuntimeDataManager *data) : runtimeData(data) {
+// a frontier smaller than this per thread is expanded serially
+static const std::size_t minFrontierPerThread = 1024;
+
+DTAM::DTAM(RuntimeDataManager *data) : runtimeData(data), readNum(0) {
   trace = runtimeData->getCurrentTrace();
   cost = 0;
 }
 
-DTAM::~DTAM() {
-  for (auto &it : allWrite) {
-    delete it.second;
-  }
-  for (auto &it : allRead) {
-    delete it.second;
-  }
-}
+DTAM::~DTAM() {}
 
 void DTAM::prepareDTAMParallel() {
-
-  for (std::map<std::string, std::vector<Event *>>::iterator it = trace->allReadSet.begin(),
-                                                             ie = trace->allReadSet.end();
-       it != ie; it++) {
-    std::vector<Event *> var = (*it).second;
-    for (std::vector<Event *>::iterator itt = var.begin(), iee = var.end(); itt != iee; itt++) {
-      std::string globalVarFullName = (*itt)->globalName;
-      DTAMPoint *point = new DTAMPoint(globalVarFullName, (*itt)->vectorClock);
-      allRead[globalVarFullName] = point;
+  nodes.clear();
+  readIds.clear();
+  edges.clear();
+  for (auto &var : trace->allReadSet) {
+    for (auto read : var.second) {
+      if (readIds.insert(std::make_pair(read->globalName, nodes.size())).second) {
+        nodes.push_back(read);
+      }
     }
   }
-
-  for (std::map<std::string, std::vector<Event *>>::iterator it = trace->allWriteSet.begin(),
-                                                             ie = trace->allWriteSet.end();
-       it != ie; it++) {
-    std::vector<Event *> var = (*it).second;
-    for (std::vector<Event *>::iterator itt = var.begin(), iee = var.end(); itt != iee; itt++) {
-      std::string globalVarFullName = (*itt)->globalName;
-      DTAMPoint *point = new DTAMPoint(globalVarFullName, (*itt)->vectorClock);
-      for (std::vector<ref<klee::Expr>>::iterator ittt = (*itt)->relatedSymbolicExpr.begin(),
-                                                  ieee = (*itt)->relatedSymbolicExpr.end();
-           ittt != ieee; ittt++) {
-        std::string value = FilterSymbolicExpr::getGlobalName(*ittt);
-        point->affectedPoint.push_back(allRead[value]);
-        allRead[value]->affectingPoint.push_back(point);
+  readNum = nodes.size();
+
+  std::unordered_map<std::string, unsigned> writeIds;
+  for (auto &var : trace->allWriteSet) {
+    for (auto write : var.second) {
+      std::pair<std::unordered_map<std::string, unsigned>::iterator, bool> inserted =
+          writeIds.insert(std::make_pair(write->globalName, nodes.size()));
+      if (inserted.second) {
+        nodes.push_back(write);
       }
-      std::string varName = (*itt)->name;
-      for (std::vector<Event *>::iterator ittt = trace->allReadSet[varName].begin(),
-                                          ieee = trace->allReadSet[varName].end();
-           ittt != ieee; ittt++) {
-        std::string value = (*ittt)->globalName;
-        point->affectingPoint.push_back(allRead[value]);
-        allRead[value]->affectedPoint.push_back(point);
+      unsigned id = inserted.first->second;
+      for (auto &related : write->relatedSymbolicExpr) {
+        std::unordered_map<std::string, unsigned>::iterator read =
+            readIds.find(FilterSymbolicExpr::getGlobalName(related));
+        if (read != readIds.end()) {
+          edges.push_back(std::make_pair(read->second, id));
+        }
+      }
+      std::unordered_map<std::string, std::vector<Event *>>::iterator reads = trace->allReadSet.find(write->name);
+      if (reads == trace->allReadSet.end()) {
+        continue;
+      }
+      for (auto read : reads->second) {
+        edges.push_back(std::make_pair(id, readIds[read->globalName]));
       }
-      allWrite[globalVarFullName] = point;
     }
   }
+  buildGraph(parallelGraph, std::vector<bool>(edges.size(), true));
+
+  taint.reset(new std::atomic<bool>[nodes.size()]);
 }
 
+// a write cannot affect a read that happens before it
 void DTAM::prepareDTAMhybrid() {
-
-  for (std::map<std::string, DTAMPoint *>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-    DTAMPoint *point = (*it).second;
-    std::string name = point->name;
-    for (std::vector<DTAMPoint *>::iterator itt = point->affectingPoint.begin(); itt < point->affectingPoint.end();) {
-      if ((*point) <= (*itt)) {
-        itt++;
-      } else {
-        for (std::vector<DTAMPoint *>::iterator ittt = (*itt)->affectingPoint.begin();
-             ittt < (*itt)->affectingPoint.end(); ittt++) {
-          if (*ittt == point) {
-            (*itt)->affectedPoint.erase(ittt);
-          }
-        }
-        point->affectingPoint.erase(itt);
-      }
+  std::vector<bool> keep(edges.size(), true);
+  for (std::size_t i = 0, size = edges.size(); i < size; i++) {
+    unsigned from = edges[i].first, to = edges[i].second;
+    if (from >= readNum && to < readNum) {
+      keep[i] = !nodes[from]->vectorClock.dominates(nodes[to]->vectorClock);
     }
   }
+  buildGraph(hybridGraph, keep);
 }
 
-void DTAM::initTaint(std::vector<DTAMPoint *> &remainPoint) {
-
-  remainPoint.clear();
-
-  for (std::map<std::string, DTAMPoint *>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-    DTAMPoint *point = (*it).second;
-    std::string name = point->name;
-    if (trace->DTAMSerial.find(name) != trace->DTAMSerial.end()) {
-      point->isTaint = true;
-      remainPoint.push_back(point);
-    } else {
-      point->isTaint = false;
+void DTAM::buildGraph(Graph &graph, const std::vector<bool> &keep) {
+  unsigned nodeNum = nodes.size();
+  graph.offsets.assign(nodeNum + 1, 0);
+  for (std::size_t i = 0, size = edges.size(); i < size; i++) {
+    if (keep[i]) {
+      graph.offsets[edges[i].first + 1]++;
     }
   }
-
-  for (std::map<std::string, DTAMPoint *>::iterator it = allRead.begin(), ie = allRead.end(); it != ie; it++) {
-    DTAMPoint *point = (*it).second;
-    std::string name = point->name;
-    if (trace->DTAMSerial.find(name) != trace->DTAMSerial.end()) {
-      point->isTaint = true;
-      remainPoint.push_back(point);
-    } else {
-      point->isTaint = false;
+  for (unsigned n = 0; n < nodeNum; n++) {
+    graph.offsets[n + 1] += graph.offsets[n];
+  }
+  graph.targets.resize(graph.offsets[nodeNum]);
+  std::vector<unsigned> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+  for (std::size_t i = 0, size = edges.size(); i < size; i++) {
+    if (keep[i]) {
+      graph.targets[fill[edges[i].first]++] = edges[i].second;
     }
   }
 }
 
-void DTAM::propagateTaint(std::vector<DTAMPoint *> &remainPoint) {
+void DTAM::initTaint(std::vector<unsigned> &frontier) {
+  frontier.clear();
+  for (unsigned n = 0, size = nodes.size(); n < size; n++) {
+    bool isTaint = trace->DTAMSerial.find(nodes[n]->globalName) != trace->DTAMSerial.end();
+    taint[n].store(isTaint, std::memory_order_relaxed);
+    if (isTaint) {
+      frontier.push_back(n);
+    }
+  }
+}
 
-  std::vector<DTAMPoint *>::iterator it;
-  while (!remainPoint.empty()) {
-    it = remainPoint.end();
-    it--;
-    DTAMPoint *point = (*it);
-    remainPoint.pop_back();
-    for (auto point : point->affectingPoint) {
-      if (point->isTaint) {
-        continue;
+void DTAM::expand(const Graph &graph, const std::vector<unsigned> &frontier, std::size_t begin, std::size_t end,
+                  std::vector<unsigned> &next) {
+  for (std::size_t i = begin; i < end; i++) {
+    unsigned node = frontier[i];
+    for (unsigned e = graph.offsets[node], ee = graph.offsets[node + 1]; e < ee; e++) {
+      unsigned target = graph.targets[e];
+      if (!taint[target].load(std::memory_order_relaxed) &&
+          !taint[target].exchange(true, std::memory_order_relaxed)) {
+        next.push_back(target);
       }
-      point->isTaint = true;
-      remainPoint.push_back(point);
     }
   }
 }
 
-void DTAM::logTaint(std::set<std::string> &taint) {
-  for (std::map<std::string, DTAMPoint *>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-    DTAMPoint *point = (*it).second;
-    if (point->isTaint == true) {
-      std::string name = point->name;
-      taint.insert(name);
+// breadth-first, a level of the frontier is split among the threads
+void DTAM::propagateTaint(const Graph &graph, std::vector<unsigned> &frontier) {
+  std::vector<unsigned> next;
+  while (!frontier.empty()) {
+    next.clear();
+    std::size_t threadNum = std::min<std::size_t>(DTAMThreads, frontier.size() / minFrontierPerThread);
+    if (threadNum <= 1) {
+      expand(graph, frontier, 0, frontier.size(), next);
+    } else {
+      std::vector<std::vector<unsigned>> nexts(threadNum);
+      std::vector<std::thread> threads;
+      std::size_t chunk = (frontier.size() + threadNum - 1) / threadNum;
+      for (std::size_t t = 0; t < threadNum; t++) {
+        std::size_t begin = std::min(t * chunk, frontier.size());
+        std::size_t end = std::min(begin + chunk, frontier.size());
+        threads.push_back(std::thread([this, &graph, &frontier, &nexts, t, begin, end]() {
+          expand(graph, frontier, begin, end, nexts[t]);
+        }));
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      for (auto &part : nexts) {
+        next.insert(next.end(), part.begin(), part.end());
+      }
     }
+    frontier.swap(next);
   }
+}
 
-  for (std::map<std::string, DTAMPoint *>::iterator it = allRead.begin(), ie = allRead.end(); it != ie; it++) {
-    DTAMPoint *point = (*it).second;
-    if (point->isTaint == true) {
-      std::string name = point->name;
-      taint.insert(name);
+void DTAM::logTaint(std::set<std::string> &taint) {
+  for (unsigned n = 0, size = nodes.size(); n < size; n++) {
+    if (this->taint[n].load(std::memory_order_relaxed)) {
+      taint.insert(nodes[n]->globalName);
     }
   }
 }
@@ -167,9 +188,9 @@ void DTAM::work() {
 
   gettimeofday(&start, NULL);
   prepareDTAMParallel();
-  std::vector<DTAMPoint *> remainPoint;
-  initTaint(remainPoint);
-  propagateTaint(remainPoint);
+  std::vector<unsigned> frontier;
+  initTaint(frontier);
+  propagateTaint(parallelGraph, frontier);
   logTaint(trace->DTAMParallel);
   for (auto name : trace->DTAMParallel) {
     runtimeData->allDTAMParallelMap.insert(trace->getAssemblyLine(name));
@@ -185,8 +206,8 @@ void DTAM::work() {
 
   gettimeofday(&start, NULL);
   prepareDTAMhybrid();
-  initTaint(remainPoint);
-  propagateTaint(remainPoint);
+  initTaint(frontier);
+  propagateTaint(hybridGraph, frontier);
   logTaint(trace->DTAMhybrid);
   for (auto name : trace->DTAMhybrid) {
     runtimeData->allDTAMhybridMap.insert(trace->getAssemblyLine(name));
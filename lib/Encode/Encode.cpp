@@ -19,10 +19,13 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
@@ -31,10 +34,13 @@
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
 #include <sys/time.h>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "klee/ADT/Ref.h"
@@ -46,6 +52,7 @@
 #include "klee/Module/KInstruction.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/FileHandling.h"
+#include "klee/Support/OptionCategories.h"
 
 #define BUFFERSIZE 300
 #define BIT_WIDTH 64
@@ -53,8 +60,25 @@
 using namespace llvm;
 using namespace std;
 using namespace z3;
+
+namespace {
+cl::opt<unsigned> FlipThreads("kleem-flip-threads",
+                              cl::desc("Flip the branches of a trace with this many solver threads (default=1)"),
+                              cl::init(1), cl::cat(klee::KleemCat));
+} // namespace
+
 namespace klee {
 
+// reads the value of the order variable of event from the model
+static int64_t getOrderValue(model &m, Event *event) {
+  expr value = m.eval(m.ctx().int_const(event->eventName.c_str()), true);
+  int64_t result = 0;
+  bool isNumeral = value.is_numeral_i64(result);
+  assert(isNumeral && "order variable without a value");
+  (void)isNumeral;
+  return result;
+}
+
 void Encode::encodeTraceToFormulas() {
 #if PRINT_FORMULA
   kleem_debug("Display kinds of constaint formulas.");
@@ -72,7 +96,7 @@ void Encode::encodeTraceToFormulas() {
 #if CHECK_BUILD
   check_result result;
   try {
-    result = z3_solver.check();
+    result = z3_solver.check(traceGuards);
     if (result == z3::sat) {
       kleem_note("ncodeTraceToFormulas success.");
     } else {
@@ -99,15 +123,18 @@ void Encode::buildPTSFormula() {
 }
 
 // true :: assert can't be violated. false :: assert can be violated.
+// All the assertions are checked in one solver call: some assertion fails at
+// the point E_ASSERT and every branch before that point keeps its direction.
+// In a model of it, the earliest failing assertion has all the assertions and
+// branches before it holding, so it is the one reported.
 bool Encode::verifyAssertion() {
-  KQuery2Z3 *kq = new KQuery2Z3(z3_ctx);
   unsigned int totalAssertEvent = trace->assertEvent.size();
   unsigned int totalAssertSymbolic = trace->assertSymbolicExpr.size();
   assert(totalAssertEvent == totalAssertSymbolic && "the number of brEvent is not equal to brSymbolic");
   z3::expr res = z3_ctx.bool_val(true);
   for (unsigned int i = 0; i < totalAssertEvent; i++) {
     Event *event = trace->assertEvent[i];
-    res = kq->getZ3Expr(trace->assertSymbolicExpr[i]);
+    res = kq.getZ3Expr(trace->assertSymbolicExpr[i]);
     unsigned line = event->inst->info->line;
     if (line != 0)
       assertFormula.push_back(make_pair(event, res));
@@ -115,73 +142,81 @@ bool Encode::verifyAssertion() {
 #if PRINT_ASSERT_INFO
   printAssertionInfo();
 #endif
-  z3_solver.push(); // backtrack 1
   kleem_verifyassert("The number of assertions: %ld.", assertFormula.size());
-  for (unsigned i = 0; i < assertFormula.size(); i++) {
-    z3_solver.push(); // backtrack point 2
-    encodeTraceToFormulas();
+  if (assertFormula.empty()) {
+    return true;
+  }
+  incrementalSolver->push(); // backtrack 1
 
+  // a branch clustered with an assertion into one order variable is before it by eventId
+  unordered_map<unsigned, vector<unsigned>> clusteredIfs;
+  for (unsigned j = 0; j < ifFormula.size(); j++) {
+    clusteredIfs[ifFormula[j].first->orderId].push_back(j);
+  }
+  expr failPoint = z3_ctx.int_const("E_ASSERT");
+  vector<expr> failures;
+  expr_vector failAtPoint(z3_ctx);
+  for (unsigned i = 0; i < assertFormula.size(); i++) {
     Event *currAssert = assertFormula[i].first;
-    z3_solver.add(!assertFormula[i].second);
-    // 发生在当前assert语句之前的assert语句要保证不能failed
-    for (unsigned j = 0; j < assertFormula.size(); j++) {
-      if (j == i) {
-        continue;
-      }
-      Event *temp = assertFormula[j].first;
-      expr currIf = z3_ctx.int_const(currAssert->eventName.c_str());
-      expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-      expr constraint = z3_ctx.bool_val(1);
-      if (currAssert->threadId == temp->threadId) {
-        if (currAssert->eventId > temp->eventId)
-          constraint = assertFormula[j].second;
-      } else {
-        constraint = implies(tempIf < currIf, assertFormula[j].second);
+    expr failure = !assertFormula[i].second;
+    unordered_map<unsigned, vector<unsigned>>::iterator clustered = clusteredIfs.find(currAssert->orderId);
+    if (clustered != clusteredIfs.end()) {
+      for (auto j : clustered->second) {
+        Event *temp = ifFormula[j].first;
+        if (temp->threadId == currAssert->threadId && temp->eventId < currAssert->eventId)
+          failure = failure && ifFormula[j].second;
       }
-      z3_solver.add(constraint);
-    }
-    // 发生在当前assert语句之前的if分支要保证不变
-    for (unsigned j = 0; j < ifFormula.size(); j++) {
-      Event *temp = ifFormula[j].first;
-      expr currIf = z3_ctx.int_const(currAssert->eventName.c_str());
-      expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-      expr constraint = z3_ctx.bool_val(1);
-      if (currAssert->threadId == temp->threadId) {
-        if (currAssert->eventId > temp->eventId)
-          constraint = ifFormula[j].second;
-      } else
-        constraint = implies(tempIf < currIf, ifFormula[j].second);
-      z3_solver.add(constraint);
     }
-    formulaNum = formulaNum + ifFormula.size() - 1;
-    check_result result = z3_solver.check();
-    solvingTimes++;
-
-    if (result == z3::sat) {
-      vector<Event *> vecEvent;
-      computePrefix(vecEvent, assertFormula[i].first);
-      Prefix *prefix = new Prefix(vecEvent, trace->createThreadPoint, "assert_" + assertFormula[i].first->eventName);
-      runtimeData->addToScheduleSet(prefix);
-      kleem_verifyassert("Assertion Failure at %s:L%d", assertFormula[i].first->inst->info->file.c_str(),
-                         assertFormula[i].first->inst->info->line);
-#if PRINT_SOLVING_RESULT
-      printPrefixInfo(prefix, assertFormula[i].first);
-      printSolvingSolution(prefix, assertFormula[i].second);
+    failures.push_back(failure);
+    failAtPoint.push_back(failure && failPoint == getOrderExpr(currAssert));
+  }
+  z3_solver.add(mk_or(failAtPoint));
+  // 发生在assert失败点之前的if分支要保证不变
+  for (unsigned j = 0; j < ifFormula.size(); j++) {
+    z3_solver.add(implies(getOrderExpr(ifFormula[j].first) < failPoint, ifFormula[j].second));
+  }
+  formulaNum = formulaNum + ifFormula.size() + 1;
+  check_result result = z3_solver.check(traceGuards);
+  solvingTimes++;
+#if PRINT_ASSERT_INFO
+  kleem_verifyassert("Verify %ld assertions on Trace%u: %s", assertFormula.size(), trace->Id,
+                     solvingInfo(result).c_str());
 #endif
-      // Once a assertion is failed, exit the verification.
-      return false;
+
+  if (result == z3::sat) {
+    model m = z3_solver.get_model();
+    int64_t failValue = 0;
+    failPoint = m.eval(failPoint, true);
+    failPoint.is_numeral_i64(failValue);
+    // the earliest assertion failing no later than E_ASSERT
+    unsigned failed = assertFormula.size();
+    int64_t failedOrder = 0;
+    for (unsigned i = 0; i < assertFormula.size(); i++) {
+      int64_t order = getOrderValue(m, assertFormula[i].first);
+      if (order > failValue || !m.eval(failures[i], true).is_true())
+        continue;
+      if (failed == assertFormula.size() || order < failedOrder ||
+          (order == failedOrder && assertFormula[i].first->eventId < assertFormula[failed].first->eventId)) {
+        failed = i;
+        failedOrder = order;
+      }
     }
-    z3_solver.pop(); // backtrack point 2
-#if PRINT_ASSERT_INFO
-    stringstream ss;
-    ss << "Trace" << trace->Id << "#" << assertFormula[i].first->inst->info->line << "#"
-       << assertFormula[i].first->eventName << "#" << assertFormula[i].first->brCondition << "-"
-       << !(assertFormula[i].first->brCondition) << "assert_bug";
-    kleem_verifyassert("Verify assert %d @%s: %s", i + 1, ss.str().c_str(), solvingInfo(result).c_str());
+    assert(failed < assertFormula.size() && "no assertion fails in the model");
+    vector<Event *> vecEvent;
+    computePrefix(vecEvent, assertFormula[failed].first, m);
+    Prefix *prefix = new Prefix(vecEvent, trace->createThreadPoint, "assert_" + assertFormula[failed].first->eventName);
+    runtimeData->addToScheduleSet(prefix);
+    kleem_verifyassert("Assertion Failure at %s:L%d", assertFormula[failed].first->inst->info->file.c_str(),
+                       assertFormula[failed].first->inst->info->line);
+#if PRINT_SOLVING_RESULT
+    printPrefixInfo(prefix, vecEvent);
+    printSolvingSolution(prefix, assertFormula[failed].second);
 #endif
   }
-  z3_solver.pop(); // backtrack 1
-  return true;
+  // the solver is shared with later traces, leave it as it was
+  incrementalSolver->pop(); // backtrack 1
+  // Once a assertion is failed, exit the verification.
+  return result != z3::sat;
 }
 
 std::string Encode::solvingInfo(check_result result) {
@@ -198,87 +233,228 @@ std::string Encode::solvingInfo(check_result result) {
 
 void Encode::flipIfBranches() {
   kleem_exploration("Start to filp the branches on trace, totally %lu branches.", ifFormula.size());
+  unsigned threadNum = FlipThreads;
+#if O3 || PRINT_SOLVING_RESULT
+  // concretizeReadValue and the solving printers work on z3_solver, flip serially
+  threadNum = 1;
+#endif
+  vector<expr> keepFormulas, flipFormulas;
+  buildFlipFormulas(keepFormulas, flipFormulas);
+  // statics
+  formulaNum += keepFormulas.size();
+  if (threadNum > 1 && ifFormula.size() > 1) {
+    flipIfBranchesInParallel(threadNum, keepFormulas, flipFormulas);
+    return;
+  }
+
+  // all the formulas are asserted once behind guards, a flip only picks its guards as assumptions
+  vector<expr> assumptions;
+  for (unsigned i = 0; i < traceGuards.size(); i++) {
+    assumptions.push_back(traceGuards[i]);
+  }
+  bool isReused;
+  for (unsigned j = 0; j < keepFormulas.size(); j++) {
+    assumptions.push_back(incrementalSolver->getGuard(keepFormulas[j], isReused));
+  }
+  vector<expr> flipGuards;
+  for (unsigned i = 0; i < flipFormulas.size(); i++) {
+    flipGuards.push_back(incrementalSolver->getGuard(flipFormulas[i], isReused));
+  }
+
   for (unsigned i = 0; i < ifFormula.size(); i++) {
-    stringstream ss;
-    ss << "Trace" << trace->Id << "-L" << ifFormula[i].first->inst->info->line << "-" << ifFormula[i].first->eventName
-       << "-" << ifFormula[i].first->brCondition << "-" << !(ifFormula[i].first->brCondition);
-    std::string prefixName = ss.str();
-    // create a backstracking point
-    z3_solver.push();
+    FlipResult flip;
 #if O2
-    bool presolve = filter.filterUselessWithSet(trace, trace->brRelatedSymbolicExpr[i]);
+    flip.presolve = filter.filterUselessWithSet(trace, trace->brRelatedSymbolicExpr[i]);
 #else
-    bool presolve = true;
+    flip.presolve = true;
 #endif
-    if (presolve) {
-      Event *curr = ifFormula[i].first;
+    if (flip.presolve) {
 #if O3
-      concretizeReadValue(curr);
+      // create a backstracking point
+      incrementalSolver->push();
+      concretizeReadValue(ifFormula[i].first);
 #endif
-      z3_solver.add(!ifFormula[i].second);
-      for (unsigned j = 0; j < ifFormula.size(); j++) {
-        if (j == i) {
-          continue;
-        }
-        Event *temp = ifFormula[j].first;
-        expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-        expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-        expr constraint = z3_ctx.bool_val(1);
-        if (curr->threadId == temp->threadId) {
-          if (curr->eventId > temp->eventId)
-            constraint = ifFormula[j].second;
-        } else {
-          constraint = implies(tempIf < currIf, ifFormula[j].second);
-        }
-        z3_solver.add(constraint);
-      }
-      // statics
-      formulaNum = formulaNum + ifFormula.size() - 1;
-      struct timeval start, finish;
-      gettimeofday(&start, NULL);
-      check_result result;
-      try {
-        result = z3_solver.check();
-      } catch (z3::exception &ex) {
-        kleem_exploration("Flip branch %s, unexpected solving error: %s", prefixName.c_str(), ex.msg());
-        continue;
-      }
-      gettimeofday(&finish, NULL);
-      double cost =
-          (double)(finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
-
-      solvingTimes++;
-      if (result == z3::sat) {
-        vector<Event *> vecEvent;
-        computePrefix(vecEvent, ifFormula[i].first);
-        Prefix *prefix = new Prefix(vecEvent, trace->createThreadPoint, prefixName);
-        runtimeData->addToScheduleSet(prefix);
-        runtimeData->satBranch++;
-        runtimeData->satCost += cost;
+      assumptions.push_back(flipGuards[i]);
+      flipIfBranch(i, z3_solver, assumptions, flip);
+      assumptions.pop_back();
+    }
+    Prefix *prefix = reportFlipResult(i, flip);
 #if PRINT_SOLVING_RESULT
-        printPrefixInfo(prefix, ifFormula[i].first);
-        printSolvingSolution(prefix, ifFormula[i].second);
+    if (prefix) {
+      printPrefixInfo(prefix, flip.vecEvent);
+      printSolvingSolution(prefix, ifFormula[i].second);
+    }
+#else
+    (void)prefix;
 #endif
-      } else {
-        runtimeData->unSatBranchBySolve++;
-        runtimeData->unSatCost += cost;
+#if O3
+    if (flip.presolve) {
+      // backstracking
+      incrementalSolver->pop();
+    }
+#endif
+  }
+}
+
+// Branch j keeps its direction if it happens before the flipped branch, whose order is E_FLIP:
+// keepFormulas[j] = (E_j < E_FLIP => ifFormula[j]). flipFormulas[i] pins E_FLIP to branch i and
+// negates it. Branches of the same thread before branch i are ordered before it by the memory model,
+// except those folded into the same event by controlGranularity, which flipFormulas[i] keeps itself.
+// This replaces the n - 1 implications built per flip with n + n formulas per trace.
+void Encode::buildFlipFormulas(vector<expr> &keepFormulas, vector<expr> &flipFormulas) {
+  expr flipOrder = z3_ctx.int_const("E_FLIP");
+  unordered_map<unsigned, vector<unsigned>> sameEventBranches;
+  for (unsigned j = 0; j < ifFormula.size(); j++) {
+    Event *temp = ifFormula[j].first;
+    expr tempIf = getOrderExpr(temp);
+    keepFormulas.push_back(implies(tempIf < flipOrder, ifFormula[j].second));
+    sameEventBranches[temp->orderId].push_back(j);
+  }
+  for (unsigned i = 0; i < ifFormula.size(); i++) {
+    Event *curr = ifFormula[i].first;
+    vector<expr> flip;
+    flip.push_back(flipOrder == getOrderExpr(curr));
+    flip.push_back(!ifFormula[i].second);
+    for (auto j : sameEventBranches[curr->orderId]) {
+      Event *temp = ifFormula[j].first;
+      if (j != i && curr->threadId == temp->threadId && curr->eventId > temp->eventId) {
+        flip.push_back(ifFormula[j].second);
       }
+    }
+    flipFormulas.push_back(makeExprsAnd(flip));
+  }
+}
 
-      if (result == z3::sat) {
-        kleem_exploration("Flip branch %s, spent %lf(s), Successful.", prefixName.c_str(), cost);
-      } else if (result == z3::unsat) {
-        kleem_exploration("Flip branch %s, spent %lf(s), Failed.", prefixName.c_str(), cost);
-      } else {
-        kleem_exploration("Flip branch %s, spent %lf(s), Unknown.", prefixName.c_str(), cost);
+// z3 contexts are not thread safe: every thread solves in its own context, into which the
+// formulas of the trace are translated beforehand.
+void Encode::flipIfBranchesInParallel(unsigned threadNum, vector<expr> &keepFormulas, vector<expr> &flipFormulas) {
+  unsigned size = ifFormula.size();
+  vector<FlipResult> flips(size);
+  for (unsigned i = 0; i < size; i++) {
+#if O2
+    flips[i].presolve = filter.filterUselessWithSet(trace, trace->brRelatedSymbolicExpr[i]);
+#else
+    flips[i].presolve = true;
+#endif
+  }
+  if (threadNum > size) {
+    threadNum = size;
+  }
+
+  struct FlipWorker {
+    context ctx;
+    solver s;
+    vector<expr> flipGuards;
+    FlipWorker() : s(ctx) {}
+  };
+  vector<std::unique_ptr<FlipWorker>> workers;
+  for (unsigned w = 0; w < threadNum; w++) {
+    std::unique_ptr<FlipWorker> worker(new FlipWorker());
+    for (unsigned i = 0; i < traceFormulas.size(); i++) {
+      worker->s.add(expr(worker->ctx, Z3_translate(z3_ctx, traceFormulas[i], worker->ctx)));
+    }
+    for (unsigned j = 0; j < keepFormulas.size(); j++) {
+      worker->s.add(expr(worker->ctx, Z3_translate(z3_ctx, keepFormulas[j], worker->ctx)));
+    }
+    for (unsigned i = 0; i < size; i++) {
+      stringstream ss;
+      ss << "flip!" << i;
+      expr guard = worker->ctx.bool_const(ss.str().c_str());
+      worker->s.add(implies(guard, expr(worker->ctx, Z3_translate(z3_ctx, flipFormulas[i], worker->ctx))));
+      worker->flipGuards.push_back(guard);
+    }
+    workers.push_back(std::move(worker));
+  }
+
+  std::atomic<unsigned> next(0);
+  vector<std::thread> threads;
+  for (unsigned w = 0; w < threadNum; w++) {
+    FlipWorker *worker = workers[w].get();
+    threads.push_back(std::thread([this, worker, &next, &flips, size]() {
+      vector<expr> assumptions;
+      for (unsigned i = next++; i < size; i = next++) {
+        if (!flips[i].presolve) {
+          continue;
+        }
+        assumptions.push_back(worker->flipGuards[i]);
+        flipIfBranch(i, worker->s, assumptions, flips[i]);
+        assumptions.pop_back();
       }
-    } else {
-      runtimeData->unSatBranchByPreSolve++;
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // report in the order of branches so that the schedule set does not depend on thread timing
+  for (unsigned i = 0; i < size; i++) {
+    reportFlipResult(i, flips[i]);
+  }
+}
+
+// Solve the flip of ifFormula[i] on s, the last assumption being the guard of its flip formula.
+// Only reads the trace, so it can run on several threads with different contexts. Nothing may
+// escape from here: on a solver thread an exception would terminate the process.
+void Encode::flipIfBranch(unsigned i, solver &s, vector<expr> &assumptions, FlipResult &flip) {
+  struct timeval start, finish;
+  try {
+    gettimeofday(&start, NULL);
+    flip.result = s.check(assumptions.size(), &assumptions[0]);
+    gettimeofday(&finish, NULL);
+    flip.cost =
+        (double)(finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+    if (flip.result == z3::sat) {
+      model m = s.get_model();
+      computePrefix(flip.vecEvent, ifFormula[i].first, m);
     }
-    // backstracking
-    z3_solver.pop();
+    flip.solved = true;
+  } catch (z3::exception &ex) {
+    flip.error = ex.msg();
+    flip.vecEvent.clear();
+  } catch (std::exception &ex) {
+    flip.error = ex.what();
+    flip.vecEvent.clear();
   }
 }
 
+// Collect the statistics and the new prefix of a flip, return the prefix if there is one.
+Prefix *Encode::reportFlipResult(unsigned i, FlipResult &flip) {
+  stringstream ss;
+  ss << "Trace" << trace->Id << "-L" << ifFormula[i].first->inst->info->line << "-" << ifFormula[i].first->eventName
+     << "-" << ifFormula[i].first->brCondition << "-" << !(ifFormula[i].first->brCondition);
+  std::string prefixName = ss.str();
+  if (!flip.presolve) {
+    runtimeData->unSatBranchByPreSolve++;
+    return NULL;
+  }
+  // statics
+  formulaNum++;
+  if (!flip.solved) {
+    kleem_exploration("Flip branch %s, unexpected solving error: %s", prefixName.c_str(), flip.error.c_str());
+    return NULL;
+  }
+  solvingTimes++;
+  Prefix *prefix = NULL;
+  if (flip.result == z3::sat) {
+    prefix = new Prefix(flip.vecEvent, trace->createThreadPoint, prefixName);
+    runtimeData->addToScheduleSet(prefix);
+    runtimeData->satBranch++;
+    runtimeData->satCost += flip.cost;
+  } else {
+    runtimeData->unSatBranchBySolve++;
+    runtimeData->unSatCost += flip.cost;
+  }
+
+  if (flip.result == z3::sat) {
+    kleem_exploration("Flip branch %s, spent %lf(s), Successful.", prefixName.c_str(), flip.cost);
+  } else if (flip.result == z3::unsat) {
+    kleem_exploration("Flip branch %s, spent %lf(s), Failed.", prefixName.c_str(), flip.cost);
+  } else {
+    kleem_exploration("Flip branch %s, spent %lf(s), Unknown.", prefixName.c_str(), flip.cost);
+  }
+  return prefix;
+}
+
 void Encode::concretizeReadValue(Event *curr) {
   //添加读写的解
   std::set<std::string> &RelatedSymbolicExpr = trace->RelatedSymbolicExpr;
@@ -289,8 +465,8 @@ void Encode::concretizeReadValue(Event *curr) {
     varName = filter.getName(rwSymbolicExpr[j]->getKid(1));
     if (RelatedSymbolicExpr.find(varName) == RelatedSymbolicExpr.end()) {
       Event *temp = rwFormula[j].first;
-      expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-      expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
+      expr currIf = getOrderExpr(curr);
+      expr tempIf = getOrderExpr(temp);
       expr constraint = z3_ctx.bool_val(1);
       if (curr->threadId == temp->threadId) {
         if (curr->eventId > temp->eventId)
@@ -350,8 +526,8 @@ void Encode::symbolicTaintAnalysis() {
     Event *curr = trace->getEvent((*it));
     for (unsigned j = 0; j < ifFormula.size(); j++) {
       Event *temp = ifFormula[j].first;
-      expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-      expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
+      expr currIf = getOrderExpr(curr);
+      expr tempIf = getOrderExpr(temp);
       expr constraint = z3_ctx.bool_val(1);
       if (curr->threadId == temp->threadId) {
         if (curr->eventId > temp->eventId) {
@@ -419,52 +595,47 @@ void Encode::symbolicTaintAnalysis() {
   runtimeData->TaintAndPTSMap.push_back(trace->taintMap.size());
 }
 
-void Encode::computePrefix(vector<Event *> &vecEvent, Event *ifEvent) {
-  vector<pair<int, Event *>> eventOrderPair;
+// m may come from another context than z3_ctx, so the order variables are looked up by name in the
+// context of m. eventOrderInZ3 is only read here.
+void Encode::computePrefix(vector<Event *> &vecEvent, Event *ifEvent, model &m) {
+  vector<pair<int64_t, Event *>> eventOrderPair;
   // get the order of event
-  map<string, expr>::iterator it = eventNameInZ3.find(ifEvent->eventName);
-  assert(it != eventNameInZ3.end());
-  model m = z3_solver.get_model();
-  stringstream ss;
-  ss << m.eval(it->second);
-  long ifEventOrder = atoi(ss.str().c_str());
+  unordered_map<unsigned, expr>::iterator it = eventOrderInZ3.find(ifEvent->orderId);
+  assert(it != eventOrderInZ3.end());
+  int64_t ifEventOrder = getOrderValue(m, ifEvent);
   for (unsigned tid = 0; tid < trace->eventList.size(); tid++) {
     std::vector<Event *> &thread = trace->eventList[tid];
-    if (thread.empty())
-      continue;
+    // events clustered into one order variable are consecutive in a thread
+    unsigned lastOrderId = 0;
+    int64_t order = 0;
     for (unsigned index = 0, size = thread.size(); index < size; index++) {
-      if (thread.at(index)->eventType == Event::VIRTUAL)
-        continue;
-
-      it = eventNameInZ3.find(thread.at(index)->eventName);
-      assert(it != eventNameInZ3.end());
-      stringstream ss;
-      ss << m.eval(it->second);
-      long order = atoi(ss.str().c_str());
-      // cut off segment behind the negated branch
+      Event *event = thread[index];
+      if (index == 0 || event->orderId != lastOrderId) {
+        it = eventOrderInZ3.find(event->orderId);
+        assert(it != eventOrderInZ3.end());
+        order = getOrderValue(m, event);
+        lastOrderId = event->orderId;
+      }
+      // cut off segment behind the negated branch, the orders of a thread
+      // never decrease so the rest of it is behind as well
       if (order > ifEventOrder)
+        break;
+      if (event->eventType == Event::VIRTUAL)
         continue;
-      if (order == ifEventOrder && thread.at(index)->threadId != ifEvent->threadId)
+      if (order == ifEventOrder && event->threadId != ifEvent->threadId)
         continue;
-      if (thread.at(index)->eventName == ifEvent->eventName && thread.at(index)->eventId > ifEvent->eventId)
+      if (event->orderId == ifEvent->orderId && event->eventId > ifEvent->eventId)
         continue;
-      eventOrderPair.push_back(make_pair(order, thread.at(index)));
+      eventOrderPair.push_back(make_pair(order, event));
     }
   }
 
-  // sort all events according to order
-  unsigned size = eventOrderPair.size();
-  for (unsigned i = 0; i < size - 1; i++) {
-    for (unsigned j = 0; j < size - i - 1; j++) {
-      if (eventOrderPair[j].first > eventOrderPair[j + 1].first) {
-        auto temp = eventOrderPair[j];
-        eventOrderPair[j] = eventOrderPair[j + 1];
-        eventOrderPair[j + 1] = temp;
-      }
-    }
-  }
+  // sort all events according to order, keeping thread order among equals
+  std::stable_sort(eventOrderPair.begin(), eventOrderPair.end(),
+                   [](const pair<int64_t, Event *> &a, const pair<int64_t, Event *> &b) { return a.first < b.first; });
 
   // put the ordered events to vecEvent.
+  vecEvent.reserve(vecEvent.size() + eventOrderPair.size());
   for (unsigned i = 0; i < eventOrderPair.size(); i++) {
     vecEvent.push_back(eventOrderPair[i].second);
   }
@@ -497,15 +668,15 @@ void Encode::printAssertionInfo() {
   out_file->flush();
 }
 
-void Encode::printPrefixInfo(Prefix *prefix, Event *ifEvent) {
-  vector<Event *> *orderedEventList = prefix->getEventList();
-  unsigned size = orderedEventList->size();
+// the prefix only keeps the schedule, so the events it was computed from are passed along
+void Encode::printPrefixInfo(Prefix *prefix, vector<Event *> &orderedEventList) {
+  unsigned size = orderedEventList.size();
   model m = z3_solver.get_model();
   // print counterexample at bitcode level
   auto os = interpreterHandler->openKleemOutputFile(prefix->getName() + ".bitcode");
   assert(os && "Failed to create file.");
   for (unsigned i = 0; i < size; i++) {
-    Event *currEvent = orderedEventList->at(i);
+    Event *currEvent = orderedEventList.at(i);
     *os << currEvent->threadId << "---" << currEvent->eventName << "---"
         << currEvent->inst->inst->getParent()->getParent()->getName().str() << "---" << currEvent->inst->info->line
         << "---" << currEvent->brCondition << "---";
@@ -663,7 +834,7 @@ void Encode::logThreadStatisticsInfo() {
   }
   unsigned lockNumber = trace->all_lock_unlock.size();
   unsigned lockPairNumber = 0;
-  std::map<std::string, std::vector<LockPair *>>::iterator it = trace->all_lock_unlock.begin();
+  std::unordered_map<std::string, std::vector<LockPair *>>::iterator it = trace->all_lock_unlock.begin();
   for (; it != trace->all_lock_unlock.end(); it++) {
     lockPairNumber += it->second.size();
   }
@@ -699,7 +870,7 @@ void Encode::buildInitValueFormula(solver z3_solver_init) {
     string str = gvi->first + "_Init";
     expr lhs = z3_ctx.constant(str.c_str(), varType);
     expr rhs = buildExprForConstantValue(gvi->second, false, "");
-    z3_solver_init.add(lhs == rhs);
+    addFormula(z3_solver_init, lhs == rhs);
 
 #if PRINT_FORMULA
     std::cerr << (lhs == rhs) << "\n";
@@ -744,12 +915,12 @@ void Encode::buildOutputFormula() {
         expr write = z3_ctx.constant(maybeRead[i]->globalName.c_str(), varType); // used write event
         expr eq = (lhs == write);
         // build the constrait of equation
-        expr writeOrder = z3_ctx.int_const(maybeRead[i]->eventName.c_str());
+        expr writeOrder = getOrderExpr(maybeRead[i]);
         vector<expr> beforeRelation;
         for (unsigned j = 0; j < maybeRead.size(); j++) {
           if (j == i)
             continue;
-          expr otherWriteOrder = z3_ctx.int_const(maybeRead[j]->eventName.c_str());
+          expr otherWriteOrder = getOrderExpr(maybeRead[j]);
           expr temp = (otherWriteOrder < writeOrder);
           beforeRelation.push_back(temp);
         }
@@ -803,11 +974,10 @@ void Encode::buildPathCondition(solver z3_solver_pc) {
   std::cerr << "\nPath Condition:\n";
 #endif
 
-  KQuery2Z3 *kq = new KQuery2Z3(z3_ctx);
   unsigned int totalExpr = trace->pathConditionRelatedToBranch.size();
   for (unsigned int i = 0; i < totalExpr; i++) {
-    z3::expr temp = kq->getZ3Expr(trace->pathConditionRelatedToBranch[i]);
-    z3_solver_pc.add(temp);
+    z3::expr temp = kq.getZ3Expr(trace->pathConditionRelatedToBranch[i]);
+    addFormula(z3_solver_pc, temp);
 #if PRINT_FORMULA
     std::cerr << temp << "\n";
 #endif
@@ -832,20 +1002,19 @@ void Encode::constraintEncoding() {
   }
   runtimeData->brGlobal += brGlobal;
 
-  KQuery2Z3 *kq = new KQuery2Z3(z3_ctx);
   for (unsigned int i = 0; i < trace->brEvent.size(); i++) {
     Event *event = trace->brEvent[i];
-    z3::expr res = kq->getZ3Expr(trace->brSymbolicExpr[i]);
+    z3::expr res = kq.getZ3Expr(trace->brSymbolicExpr[i]);
     if (event->isConditionInst == true) {
       ifFormula.push_back(make_pair(event, res));
     } else if (event->isConditionInst == false) {
-      z3_solver.add(res);
+      addFormula(z3_solver, res);
     }
   }
 
   for (unsigned int i = 0; i < trace->rwSymbolicExpr.size(); i++) {
     Event *event = trace->rwEvent[i];
-    z3::expr res = kq->getZ3Expr(trace->rwSymbolicExpr[i]);
+    z3::expr res = kq.getZ3Expr(trace->rwSymbolicExpr[i]);
     rwFormula.push_back(make_pair(event, res));
   }
   encodeTraceToFormulas();
@@ -913,6 +1082,23 @@ expr Encode::buildExprForConstantValue(Value *V, bool isLeft, string currInstPre
   return ret;
 }
 
+// formulas of the shared solver are added behind a guard, see IncrementalSolver
+void Encode::addFormula(solver &s, const expr &formula) {
+  if ((Z3_solver)s != (Z3_solver)z3_solver) {
+    s.add(formula);
+    return;
+  }
+  bool isReused;
+  expr guard = incrementalSolver->getGuard(formula, isReused);
+  if (isReused) {
+    reusedFormulaNum++;
+  }
+  if (traceGuardIds.insert(Z3_get_ast_id(z3_ctx, guard)).second) {
+    traceGuards.push_back(guard);
+    traceFormulas.push_back(formula);
+  }
+}
+
 z3::sort Encode::llvmTy_to_z3Ty(const Type *typ) {
   switch (typ->getTypeID()) {
     case Type::VoidTyID:
@@ -987,11 +1173,23 @@ z3::sort Encode::llvmTy_to_z3Ty(const Type *typ) {
 #endif
 } //
 
+expr Encode::getOrderExpr(Event *event) {
+  unsigned id = event->orderId;
+  if (id >= orderExprs.size()) {
+    orderExprs.resize(std::max<size_t>(id + 1, trace->nextEventId), expr(z3_ctx));
+  }
+  expr &order = orderExprs[id];
+  if (!(Z3_ast)order) {
+    order = z3_ctx.int_const(event->eventName.c_str());
+  }
+  return order;
+}
+
 void Encode::buildMemoryModelFormula(solver z3_solver_mm) {
 #if PRINT_FORMULA
   std::cerr << "\nMemory Model Formula:\n";
 #endif
-  z3_solver_mm.add(z3_ctx.int_const("E_INIT") == 0);
+  addFormula(z3_solver_mm, z3_ctx.int_const("E_INIT") == 0);
   // statics
   formulaNum++;
   // initial and final
@@ -1002,22 +1200,22 @@ void Encode::buildMemoryModelFormula(solver z3_solver_mm) {
     // initial
     Event *firstEvent = thread.at(0);
     expr init = z3_ctx.int_const("E_INIT");
-    expr firstEventExpr = z3_ctx.int_const(firstEvent->eventName.c_str());
+    expr firstEventExpr = getOrderExpr(firstEvent);
     expr temp1 = (init < firstEventExpr);
 #if PRINT_FORMULA
     std::cerr << temp1 << "\n";
 #endif
-    z3_solver_mm.add(temp1);
+    addFormula(z3_solver_mm, temp1);
 
     // final
     Event *finalEvent = thread.back();
     expr final = z3_ctx.int_const("E_FINAL");
-    expr finalEventExpr = z3_ctx.int_const(finalEvent->eventName.c_str());
+    expr finalEventExpr = getOrderExpr(finalEvent);
     expr temp2 = (finalEventExpr < final);
 #if PRINT_FORMULA
     std::cerr << temp2 << "\n";
 #endif
-    z3_solver_mm.add(temp2);
+    addFormula(z3_solver_mm, temp2);
     // statics
     formulaNum += 2;
   }
@@ -1032,25 +1230,25 @@ void Encode::buildMemoryModelFormula(solver z3_solver_mm) {
       Event *pre = thread.at(index);
       Event *post = thread.at(index + 1);
       // by clustering
-      if (pre->eventName == post->eventName)
+      if (pre->orderId == post->orderId)
         continue;
       uniqueEvent++;
-      expr preExpr = z3_ctx.int_const(pre->eventName.c_str());
-      expr postExpr = z3_ctx.int_const(post->eventName.c_str());
+      expr preExpr = getOrderExpr(pre);
+      expr postExpr = getOrderExpr(post);
       expr temp = (preExpr < postExpr);
 #if PRINT_FORMULA
       std::cerr << temp << "\n";
 #endif
-      z3_solver_mm.add(temp);
+      addFormula(z3_solver_mm, temp);
       // statics
       formulaNum++;
 
-      // eventNameInZ3 will be used at flipIfBranches
-      eventNameInZ3.insert(map<string, expr>::value_type(pre->eventName, preExpr));
-      eventNameInZ3.insert(map<string, expr>::value_type(post->eventName, postExpr));
+      // eventOrderInZ3 will be used at flipIfBranches
+      eventOrderInZ3.insert(std::make_pair(pre->orderId, preExpr));
+      eventOrderInZ3.insert(std::make_pair(post->orderId, postExpr));
     }
   }
-  z3_solver_mm.add(z3_ctx.int_const("E_FINAL") == z3_ctx.int_val(uniqueEvent) + 100);
+  addFormula(z3_solver_mm, z3_ctx.int_const("E_FINAL") == z3_ctx.int_val(uniqueEvent) + 100);
   // statics
   formulaNum++;
 }
@@ -1068,7 +1266,7 @@ void Encode::controlGranularity(int level) {
       Event *pre = thread.at(0);
       int preLineNum = pre->inst->info->line;
       InstType preInstType = getInstOpType(thread.at(0));
-      string preEventName = thread.at(0)->eventName;
+      Event *preEvent = thread.at(0);
 
       for (unsigned index = 1, size = thread.size(); index < size; index++) {
         Event *curr = thread.at(index);
@@ -1089,20 +1287,20 @@ void Encode::controlGranularity(int level) {
 
         if (currLineNum == preLineNum) {
           if (preInstType == NormalOp) {
-            curr->eventName = preEventName;
+            curr->shareOrderWith(preEvent);
             preInstType = currInstType;
           } else {
             if (currInstType == NormalOp) {
-              curr->eventName = preEventName;
+              curr->shareOrderWith(preEvent);
             } else {
               preInstType = currInstType;
-              preEventName = curr->eventName;
+              preEvent = curr;
             }
           }
         } else {
           preLineNum = currLineNum;
           preInstType = currInstType;
-          preEventName = curr->eventName;
+          preEvent = curr;
         }
       }
     }
@@ -1113,7 +1311,7 @@ void Encode::controlGranularity(int level) {
         continue;
       Event *pre = thread.at(0);
       InstType preInstType = getInstOpType(pre);
-      string preEventName = pre->eventName;
+      Event *preEvent = pre;
 
       for (unsigned index = 1, size = thread.size(); index < size; index++) {
         Event *curr = thread.at(index);
@@ -1129,9 +1327,9 @@ void Encode::controlGranularity(int level) {
         //					std::cerr << "ThreadOp!\n";
 
         if (preInstType == NormalOp) {
-          curr->eventName = preEventName;
+          curr->shareOrderWith(preEvent);
         } else {
-          preEventName = curr->eventName;
+          preEvent = curr;
         }
         preInstType = currInstType;
       }
@@ -1178,17 +1376,17 @@ void Encode::buildPartialOrderFormula(solver z3_solver_po) {
   std::map<Event *, uint64_t>::iterator itc = trace->createThreadPoint.begin();
   for (; itc != trace->createThreadPoint.end(); itc++) {
     // the event is at the point of creating thread
-    string creatPoint = itc->first->eventName;
+    Event *creatPoint = itc->first;
     // the event is the first step of created thread
     if (trace->eventList[itc->second].size() != 0) {
-      string firstStep = trace->eventList[itc->second].at(0)->eventName;
-      expr prev = z3_ctx.int_const(creatPoint.c_str());
-      expr back = z3_ctx.int_const(firstStep.c_str());
+      Event *firstStep = trace->eventList[itc->second].at(0);
+      expr prev = getOrderExpr(creatPoint);
+      expr back = getOrderExpr(firstStep);
       expr twoEventOrder = (prev < back);
 #if PRINT_FORMULA
       std::cerr << twoEventOrder << "\n";
 #endif
-      z3_solver_po.add(twoEventOrder);
+      addFormula(z3_solver_po, twoEventOrder);
     }
   }
   // statics
@@ -1200,46 +1398,131 @@ void Encode::buildPartialOrderFormula(solver z3_solver_po) {
   std::map<Event *, uint64_t>::iterator itj = trace->joinThreadPoint.begin();
   for (; itj != trace->joinThreadPoint.end(); itj++) {
     // the event is at the point of joining thread
-    string joinPoint = itj->first->eventName;
+    Event *joinPoint = itj->first;
     // the event is the last step of joined thread
-    string lastStep = trace->eventList[itj->second].back()->eventName;
-    expr prev = z3_ctx.int_const(lastStep.c_str());
-    expr back = z3_ctx.int_const(joinPoint.c_str());
+    Event *lastStep = trace->eventList[itj->second].back();
+    expr prev = getOrderExpr(lastStep);
+    expr back = getOrderExpr(joinPoint);
     expr twoEventOrder = (prev < back);
 #if PRINT_FORMULA
-    std::cerr << "Jion Point: " << joinPoint << ", ";
-    std::cerr << "Last Step: " << lastStep << " => ";
+    std::cerr << "Jion Point: " << joinPoint->eventName << ", ";
+    std::cerr << "Last Step: " << lastStep->eventName << " => ";
     std::cerr << twoEventOrder << "\n";
 #endif
-    z3_solver_po.add(twoEventOrder);
+    addFormula(z3_solver_po, twoEventOrder);
   }
   // statics
   formulaNum += trace->joinThreadPoint.size();
 }
 
+// Vector clocks over program order, thread creation and join, the orders
+// buildMemoryModelFormula and buildPartialOrderFormula impose on every schedule.
+// A thread's component of the clock of its k-th event is k.
+void Encode::computeMustHappenBefore() {
+  mustClocks.assign(trace->nextEventId, VectorClock());
+  unsigned threadNum = trace->eventList.size();
+  vector<Event *> creator(threadNum, NULL);
+  for (auto &create : trace->createThreadPoint) {
+    if (create.second < threadNum) {
+      creator[create.second] = create.first;
+    }
+  }
+  // a thread can only go on once its creator, or the thread it joins, has got its clock
+  vector<unsigned> next(threadNum, 0);
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (unsigned tid = 0; tid < threadNum; tid++) {
+      vector<Event *> &thread = trace->eventList[tid];
+      for (; next[tid] < thread.size(); next[tid]++) {
+        unsigned index = next[tid];
+        Event *event = thread[index];
+        VectorClock clock;
+        if (index) {
+          clock = mustClocks[thread[index - 1]->eventId];
+        } else if (creator[tid]) {
+          if (!mustClocks[creator[tid]->eventId].size())
+            break;
+          clock = mustClocks[creator[tid]->eventId];
+        }
+        std::map<Event *, uint64_t>::iterator join = trace->joinThreadPoint.find(event);
+        if (join != trace->joinThreadPoint.end() && join->second < threadNum &&
+            !trace->eventList[join->second].empty()) {
+          Event *lastStep = trace->eventList[join->second].back();
+          if (!mustClocks[lastStep->eventId].size())
+            break;
+          clock.merge(mustClocks[lastStep->eventId]);
+        }
+        clock.tick(tid);
+        mustClocks[event->eventId] = clock;
+        progress = true;
+      }
+    }
+  }
+}
+
+bool Encode::mustHappenBefore(Event *first, Event *second) {
+  if (first == second)
+    return false;
+  VectorClock &firstClock = mustClocks[first->eventId];
+  VectorClock &secondClock = mustClocks[second->eventId];
+  if (!firstClock.size() || !secondClock.size())
+    return false;
+  return firstClock.get(first->threadId) <= secondClock.get(first->threadId);
+}
+
+// Drops the writes read can take its value from in no schedule: those that
+// must happen after it, and those that must be overwritten by another
+// candidate before it. The order of the rest is kept. Returns false if some
+// candidate must happen before read, which rules out the initial value.
+bool Encode::pruneMayBeRead(Event *read, vector<Event *> &mayBeRead) {
+  vector<Event *> before;
+  for (auto write : mayBeRead) {
+    if (mustHappenBefore(write, read)) {
+      before.push_back(write);
+    }
+  }
+  unsigned kept = 0;
+  for (unsigned i = 0; i < mayBeRead.size(); i++) {
+    Event *write = mayBeRead[i];
+    bool impossible = mustHappenBefore(read, write);
+    for (unsigned j = 0; j < before.size() && !impossible; j++) {
+      impossible = mustHappenBefore(write, before[j]);
+    }
+    if (!impossible) {
+      mayBeRead[kept++] = write;
+    }
+  }
+  mayBeRead.resize(kept);
+  return before.empty();
+}
+
 void Encode::buildReadWriteFormula(solver z3_solver_rw) {
 #if PRINT_FORMULA
   std::cerr << "\nRead-Write Formula:\n";
 #endif
   // prepare
   markLatestWriteForGlobalVar();
+  if (mustClocks.empty()) {
+    computeMustHappenBefore();
+  }
   //	std::cerr << "size : " << trace->readSet.size()<<"\n";
   //	std::cerr << "size : " << trace->writeSet.size()<<"\n";
-  map<string, vector<Event *>>::iterator read;
-  map<string, vector<Event *>>::iterator write;
+  unordered_map<string, vector<Event *>>::iterator read;
+  unordered_map<string, vector<Event *>>::iterator write;
 
-  map<string, vector<Event *>>::iterator ir = trace->readSetRelatedToBranch.begin(); // key--variable,
+  unordered_map<string, vector<Event *>>::iterator ir = trace->readSetRelatedToBranch.begin(); // key--variable,
   Event *currentRead;
   Event *currentWrite;
   for (; ir != trace->readSetRelatedToBranch.end(); ir++) {
-    map<string, vector<Event *>>::iterator iw = trace->writeSetRelatedToBranch.find(ir->first);
+    unordered_map<string, vector<Event *>>::iterator iw = trace->writeSetRelatedToBranch.find(ir->first);
     // maybe use the initial value from Initialization.@2014.4.16
     // if(iw == writeSet.end())
     // continue;
     for (unsigned k = 0; k < ir->second.size(); k++) {
       vector<expr> oneVarAllRead;
       currentRead = ir->second[k];
-      expr r = z3_ctx.int_const(currentRead->eventName.c_str());
+      expr r = getOrderExpr(currentRead);
 
       // compute the write set that may be used by currentRead;
       vector<Event *> mayBeRead;
@@ -1256,7 +1539,9 @@ void Encode::buildReadWriteFormula(solver z3_solver_rw) {
         //					llvm::errs() << "currentRead->latestWriteEventInSameThread : " <<
         // currentRead->latestWriteEventInSameThread->globalName << "\n";
         mayBeRead.push_back(currentRead->latestWriteEventInSameThread);
-      } else {
+      }
+      bool mayReadInit = pruneMayBeRead(currentRead, mayBeRead);
+      if (currentRead->latestWriteEventInSameThread == NULL && mayReadInit) {
         // if this read don't have the corresponding write, it may use from Initialization operation.
         // so, build the formula constrainting this read uses from Initialization operation
 
@@ -1269,7 +1554,7 @@ void Encode::buildReadWriteFormula(solver z3_solver_rw) {
           oneVarOneRead.push_back(equal);
           for (unsigned j = 0; j < mayBeRead.size(); j++) {
             currentWrite = mayBeRead[j];
-            expr w = z3_ctx.int_const(currentWrite->eventName.c_str());
+            expr w = getOrderExpr(currentWrite);
             expr order = r < w;
             oneVarOneRead.push_back(order);
           }
@@ -1289,7 +1574,7 @@ void Encode::buildReadWriteFormula(solver z3_solver_rw) {
         expr equal = readFromWriteFormula(currentRead, currentWrite, ir->first);
         oneVarOneRead.push_back(equal);
 
-        expr w = z3_ctx.int_const(currentWrite->eventName.c_str());
+        expr w = getOrderExpr(currentWrite);
         expr rw = (w < r);
         // statics
         formulaNum += 2;
@@ -1297,7 +1582,7 @@ void Encode::buildReadWriteFormula(solver z3_solver_rw) {
         // the next write in the same thread must be behind this read.
         if (i + 1 <= mayBeRead.size() - 1 && // short-circuit
             mayBeRead[i + 1]->threadId == currentWriteThreadId) {
-          expr nextw = z3_ctx.int_const(mayBeRead[i + 1]->eventName.c_str());
+          expr nextw = getOrderExpr(mayBeRead[i + 1]);
           // statics
           formulaNum++;
           rw = (rw && (r < nextw));
@@ -1325,7 +1610,7 @@ void Encode::buildReadWriteFormula(solver z3_solver_rw) {
 #if PRINT_FORMULA
         std::cerr << oneReadExprs << "\n";
 #endif
-        z3_solver_rw.add(oneReadExprs);
+        addFormula(z3_solver_rw, oneReadExprs);
       }
     }
   }
@@ -1394,9 +1679,9 @@ bool Encode::taintReadFromInitFormula(Event *read, expr &ret) {
 }
 
 expr Encode::enumerateOrder(Event *read, Event *write, Event *anotherWrite) {
-  expr prev = z3_ctx.int_const(write->eventName.c_str());
-  expr back = z3_ctx.int_const(read->eventName.c_str());
-  expr another = z3_ctx.int_const(anotherWrite->eventName.c_str());
+  expr prev = getOrderExpr(write);
+  expr back = getOrderExpr(read);
+  expr another = getOrderExpr(anotherWrite);
   expr o = another < prev || another > back;
   return o;
 }
@@ -1408,7 +1693,7 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
 #endif
 
   // lock/unlock
-  map<string, vector<LockPair *>>::iterator it = trace->all_lock_unlock.begin();
+  unordered_map<string, vector<LockPair *>>::iterator it = trace->all_lock_unlock.begin();
   for (; it != trace->all_lock_unlock.end(); it++) {
     vector<LockPair *> tempVec = it->second;
     int size = tempVec.size();
@@ -1423,28 +1708,28 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
     }
     /////////////////////debug/////////////////////////////
     for (int i = 0; i < size - 1; i++) {
-      expr oneLock = z3_ctx.int_const(tempVec[i]->lockEvent->eventName.c_str());
+      expr oneLock = getOrderExpr(tempVec[i]->lockEvent);
       if (tempVec[i]->unlockEvent == NULL) { // imcomplete lock pair
         continue;
       }
-      expr oneUnlock = z3_ctx.int_const(tempVec[i]->unlockEvent->eventName.c_str());
+      expr oneUnlock = getOrderExpr(tempVec[i]->unlockEvent);
       for (int j = i + 1; j < size; j++) {
         if (tempVec[i]->threadId == tempVec[j]->threadId)
           continue;
 
-        expr twoLock = z3_ctx.int_const(tempVec[j]->lockEvent->eventName.c_str());
+        expr twoLock = getOrderExpr(tempVec[j]->lockEvent);
         expr twinLockPairOrder = z3_ctx.bool_val(1);
         if (tempVec[j]->unlockEvent == NULL) { // imcomplete lock pair
           twinLockPairOrder = oneUnlock < twoLock;
           // statics
           formulaNum++;
         } else {
-          expr twoUnlock = z3_ctx.int_const(tempVec[j]->unlockEvent->eventName.c_str());
+          expr twoUnlock = getOrderExpr(tempVec[j]->unlockEvent);
           twinLockPairOrder = (oneUnlock < twoLock) || (twoUnlock < oneLock);
           // statics
           formulaNum += 2;
         }
-        z3_solver_sync.add(twinLockPairOrder);
+        addFormula(z3_solver_sync, twinLockPairOrder);
 #if PRINT_FORMULA
         std::cerr << twinLockPairOrder << "\n";
 #endif
@@ -1470,13 +1755,13 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
     for (unsigned i = 0; i < waitSet.size(); i++) {
       vector<expr> possibleMap;
       vector<expr> possibleValue;
-      expr wait = z3_ctx.int_const(waitSet[i]->wait->eventName.c_str());
-      expr lock_wait = z3_ctx.int_const(waitSet[i]->lock_by_wait->eventName.c_str());
+      expr wait = getOrderExpr(waitSet[i]->wait);
+      expr lock_wait = getOrderExpr(waitSet[i]->lock_by_wait);
       vector<Event *> signalSet = it_signal->second;
       for (unsigned j = 0; j < signalSet.size(); j++) {
         if (waitSet[i]->wait->threadId == signalSet[j]->threadId)
           continue;
-        expr signal = z3_ctx.int_const(signalSet[j]->eventName.c_str());
+        expr signal = getOrderExpr(signalSet[j]);
         // Event_wait < Event_signal < lock_wait
         expr exprs_0 = wait < signal && signal < lock_wait;
 
@@ -1498,8 +1783,8 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
 #if PRINT_FORMULA
       std::cerr << one_wait << "\n";
 #endif
-      z3_solver_sync.add(one_wait);
-      z3_solver_sync.add(wait_value);
+      addFormula(z3_solver_sync, one_wait);
+      addFormula(z3_solver_sync, wait_value);
     }
   }
 
@@ -1523,7 +1808,7 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
       }
       expr sum = makeExprsSum(mapLabel);
       expr relation = (sum <= 1);
-      z3_solver_sync.add(relation);
+      addFormula(z3_solver_sync, relation);
     }
   }
 
@@ -1547,7 +1832,7 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
       }
       expr sum = makeExprsSum(mapLabel);
       expr relation = (sum >= 1);
-      z3_solver_sync.add(relation);
+      addFormula(z3_solver_sync, relation);
     }
   }
 
@@ -1568,7 +1853,7 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
           stringstream ss;
           ss << currCond << "_" << currWaitName << "_" << signalSet[j]->eventName;
           expr map_wait_signal = z3_ctx.int_const(ss.str().c_str());
-          z3_solver_sync.add(map_wait_signal == 0);
+          addFormula(z3_solver_sync, map_wait_signal == 0);
         }
       }
     }
@@ -1584,14 +1869,14 @@ void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
     for (unsigned i = 0; i < temp.size() - 1; i++) {
       if (temp[i]->threadId == temp[i + 1]->threadId)
         assert(0 && "Two barrier event can't be in a same thread!");
-      expr exp1 = z3_ctx.int_const(temp[i]->eventName.c_str());
-      expr exp2 = z3_ctx.int_const(temp[i + 1]->eventName.c_str());
+      expr exp1 = getOrderExpr(temp[i]);
+      expr exp2 = getOrderExpr(temp[i + 1]);
       expr relation = (exp1 == exp2);
 
 #if PRINT_FORMULA
       std::cerr << relation << "\n";
 #endif
-      z3_solver_sync.add(relation);
+      addFormula(z3_solver_sync, relation);
     }
   }
 }
@@ -1644,7 +1929,7 @@ void Encode::buildInitTaintFormula(solver z3_solver_it) {
     string str = gvi->first + "_Init_tag";
     expr lhs = z3_ctx.bool_const(str.c_str());
     expr rhs = z3_ctx.bool_val(false);
-    z3_solver_it.add(lhs == rhs);
+    addFormula(z3_solver_it, lhs == rhs);
 #if PRINT_FORMULA
     std::cerr << (lhs == rhs) << "\n";
 #endif
@@ -1656,8 +1941,8 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
   std::cerr << "\nTaint Match Formula:\n";
 #endif
 
-  map<string, vector<Event *>>::iterator read;
-  map<string, vector<Event *>>::iterator write;
+  unordered_map<string, vector<Event *>>::iterator read;
+  unordered_map<string, vector<Event *>>::iterator write;
 
   // debug
   // print out all the read and write insts of global vars.
@@ -1680,17 +1965,17 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
 
   std::set<std::string> &potentialTaintSymbolicExpr = trace->potentialTaint;
 
-  map<string, vector<Event *>>::iterator ir = trace->allReadSet.begin(); // key--variable,
+  unordered_map<string, vector<Event *>>::iterator ir = trace->allReadSet.begin(); // key--variable,
   Event *currentRead;
   Event *currentWrite;
   for (; ir != trace->allReadSet.end(); ir++) {
     if (potentialTaintSymbolicExpr.find(ir->first) != potentialTaintSymbolicExpr.end()) {
       //			std::cerr << "trace->allReadSet : " << ir->first << "\n";
-      map<string, vector<Event *>>::iterator iw = trace->allWriteSet.find(ir->first);
+      unordered_map<string, vector<Event *>>::iterator iw = trace->allWriteSet.find(ir->first);
       for (unsigned k = 0; k < ir->second.size(); k++) {
         vector<expr> oneVarAllRead;
         currentRead = ir->second[k];
-        expr r = z3_ctx.int_const(currentRead->eventName.c_str());
+        expr r = getOrderExpr(currentRead);
         // compute the write set that may be used by currentRead;
         vector<Event *> mayBeRead;
         unsigned currentWriteThreadId;
@@ -1717,7 +2002,7 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
             oneVarOneRead.push_back(equal);
             for (unsigned j = 0; j < mayBeRead.size(); j++) {
               currentWrite = mayBeRead[j];
-              expr w = z3_ctx.int_const(currentWrite->eventName.c_str());
+              expr w = getOrderExpr(currentWrite);
               expr order = r < w;
               oneVarOneRead.push_back(order);
             }
@@ -1737,7 +2022,7 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
           expr equal = taintReadFromWriteFormula(currentRead, currentWrite, ir->first);
           oneVarOneRead.push_back(equal);
 
-          expr w = z3_ctx.int_const(currentWrite->eventName.c_str());
+          expr w = getOrderExpr(currentWrite);
           expr rw = (w < r);
           // statics
           formulaNum += 2;
@@ -1745,7 +2030,7 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
           // the next write in the same thread must be behind this read.
           if (i + 1 <= mayBeRead.size() - 1 && // short-circuit
               mayBeRead[i + 1]->threadId == currentWriteThreadId) {
-            expr nextw = z3_ctx.int_const(mayBeRead[i + 1]->eventName.c_str());
+            expr nextw = getOrderExpr(mayBeRead[i + 1]);
             // statics
             formulaNum++;
             rw = (rw && (r < nextw));
@@ -1768,7 +2053,7 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
 #if PRINT_FORMULA
         std::cerr << oneReadExprs << "\n";
 #endif
-        z3_solver_tm.add(oneReadExprs);
+        addFormula(z3_solver_tm, oneReadExprs);
       }
     } else {
       // std::cerr << "not find : " << ir->first << "\n";
@@ -1777,7 +2062,7 @@ void Encode::buildTaintMatchFormula(solver z3_solver_tm) {
         // std::cerr << "varName : " << varName << "\n";
         expr lhs = z3_ctx.bool_const(varName.c_str());
         expr rhs = z3_ctx.bool_val(false);
-        z3_solver_tm.add(lhs == rhs);
+        addFormula(z3_solver_tm, lhs == rhs);
       }
     }
   }
@@ -1797,13 +2082,13 @@ void Encode::buildTaintProgatationFormula(solver z3_solver_tp) {
       expr rhs = z3_ctx.bool_const(varTaintName.c_str());
       expr lhs = z3_ctx.bool_val(true);
       // td::cerr << lhs << " = " << rhs << " initTaintSymbolicExpr\n";
-      z3_solver_tp.add(lhs == rhs);
+      addFormula(z3_solver_tp, lhs == rhs);
     } else {
       ref<klee::Expr> left = value->getKid(0);
       expr rhs = z3_ctx.bool_const(varTaintName.c_str());
       expr lhs = makeOrTaint(left);
       // std::cerr << lhs << " = " << rhs << "\n";
-      z3_solver_tp.add(lhs == rhs);
+      addFormula(z3_solver_tp, lhs == rhs);
     }
   }
 }
@@ -15,6 +15,8 @@
 #include <iterator>
 #include <map>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include <llvm/IR/Constant.h>
@@ -37,14 +39,9 @@ std::string FilterSymbolicExpr::getName(ref<klee::Expr> value) {
 }
 
 std::string FilterSymbolicExpr::getName(std::string globalName) {
-  std::stringstream name;
-  name.str("");
-  unsigned int i = 0;
-  while ((globalName.at(i) != 'S') && (globalName.at(i) != 'L')) {
-    name << globalName.at(i);
-    i++;
-  }
-  return name.str();
+  std::string::size_type end = globalName.find_first_of("SL");
+  assert(end != std::string::npos && "global name without S/L");
+  return globalName.substr(0, end);
 }
 
 std::string FilterSymbolicExpr::getGlobalName(ref<klee::Expr> value) {
@@ -61,25 +58,27 @@ std::string FilterSymbolicExpr::getGlobalName(ref<klee::Expr> value) {
   return globalName;
 }
 
-void FilterSymbolicExpr::resolveSymbolicExpr(ref<klee::Expr> symbolicExpr, std::set<std::string> &relatedSymbolicExpr) {
+// expressions are DAGs, every shared node is walked once
+static void resolveSymbolicExpr(const ref<klee::Expr> &symbolicExpr, std::set<std::string> &relatedSymbolicExpr,
+                                std::unordered_set<const klee::Expr *> &visited) {
+  if (!visited.insert(symbolicExpr.get()).second) {
+    return;
+  }
   if (symbolicExpr->getKind() == Expr::Read) {
-    std::string name = getName(symbolicExpr);
-    if (relatedSymbolicExpr.find(name) == relatedSymbolicExpr.end()) {
-      relatedSymbolicExpr.insert(name);
-    }
+    relatedSymbolicExpr.insert(FilterSymbolicExpr::getName(symbolicExpr));
     return;
-  } else {
-    unsigned kidsNum = symbolicExpr->getNumKids();
-    if (kidsNum == 2 && symbolicExpr->getKid(0) == symbolicExpr->getKid(1)) {
-      resolveSymbolicExpr(symbolicExpr->getKid(0), relatedSymbolicExpr);
-    } else {
-      for (unsigned int i = 0; i < kidsNum; i++) {
-        resolveSymbolicExpr(symbolicExpr->getKid(i), relatedSymbolicExpr);
-      }
-    }
+  }
+  unsigned kidsNum = symbolicExpr->getNumKids();
+  for (unsigned int i = 0; i < kidsNum; i++) {
+    resolveSymbolicExpr(symbolicExpr->getKid(i), relatedSymbolicExpr, visited);
   }
 }
 
+void FilterSymbolicExpr::resolveSymbolicExpr(ref<klee::Expr> symbolicExpr, std::set<std::string> &relatedSymbolicExpr) {
+  std::unordered_set<const klee::Expr *> visited;
+  klee::resolveSymbolicExpr(symbolicExpr, relatedSymbolicExpr, visited);
+}
+
 void FilterSymbolicExpr::resolveTaintExpr(ref<klee::Expr> taintExpr, std::vector<ref<klee::Expr>> &relatedTaintExpr,
                                           bool &isTaint) {
   if (taintExpr->getKind() == Expr::Concat || taintExpr->getKind() == Expr::Read) {
@@ -169,13 +168,13 @@ bool FilterSymbolicExpr::isRelated(std::string varName) {
 }
 
 void FilterSymbolicExpr::prepareData(Trace *trace) {
-std::string name;
-  std::vector<std::pair<std::string, ref<klee::Expr>>> remainingExprs;
+  std::string name;
+  // stores not yet taken into the path condition, by variable in trace order
+  std::unordered_map<std::string, std::vector<ref<klee::Expr>>> remainingExprs;
   allRelatedSymbolicExprSet.clear();
   allRelatedSymbolicExprVector.clear();
-  for (auto it : trace->storeSymbolicExpr) {
-    name = getName(it.get()->getKid(1));
-    remainingExprs.push_back(make_pair(name, it.get()));
+  for (auto &it : trace->storeSymbolicExpr) {
+    remainingExprs[getName(it->getKid(1))].push_back(it);
   }
 
   // Log all the variables name use in branches.
@@ -203,27 +202,21 @@ std::string name;
 #endif
     if (remainingExprs.empty())
       break;
-    auto it = remainingExprs.begin();
-    for (; it != remainingExprs.end(); ) {
-      if (name != it->first) {
-        ++it;
-        continue;
-      }
+    auto bucket = remainingExprs.find(name);
+    if (bucket == remainingExprs.end())
+      continue;
+    std::set<std::string> &relatedExprs = trace->allRelatedSymbolicExprs[name];
+    for (auto &storeExpr : bucket->second) {
 #if FILTER_USELESS_DEBUG
-      llvm::errs() << it->second << "\n";
+      llvm::errs() << storeExpr << "\n";
 #endif
-      trace->pathCondition.push_back(it->second);
+      trace->pathCondition.push_back(storeExpr);
       std::set<std::string> tempSymbolicExpr;
-      resolveSymbolicExpr(it->second, tempSymbolicExpr);
+      resolveSymbolicExpr(storeExpr, tempSymbolicExpr);
       addExprToRelate(tempSymbolicExpr);
-
-      if (trace->allRelatedSymbolicExprs.find(name) != trace->allRelatedSymbolicExprs.end()) {
-        addExprToSet(tempSymbolicExpr, trace->allRelatedSymbolicExprs[name]);
-      } else {
-        trace->allRelatedSymbolicExprs[name] = tempSymbolicExpr;
-      }
-      it = remainingExprs.erase(it);
+      relatedExprs.insert(tempSymbolicExpr.begin(), tempSymbolicExpr.end());
     }
+    remainingExprs.erase(bucket);
   }
 
 #if FILTER_USELESS_DEBUG
@@ -235,8 +228,8 @@ std::string name;
 
   std::map<std::string, long> &varThread = trace->varThread;
 
-  std::map<std::string, std::vector<Event *>> usefulReadSet;
-  std::map<std::string, std::vector<Event *>> &readSet = trace->readSet;
+  std::unordered_map<std::string, std::vector<Event *>> usefulReadSet;
+  std::unordered_map<std::string, std::vector<Event *>> &readSet = trace->readSet;
   for (auto oneVarReads : readSet) {
     trace->allReadSet.insert(oneVarReads);
     name = oneVarReads.first;
@@ -264,9 +257,9 @@ std::string name;
     readSet.insert(UR);
   }
 
-  std::map<std::string, std::vector<Event *>> usefulWriteSet;
-  std::map<std::string, std::vector<Event *>> &writeSet = trace->writeSet;
-  std::map<std::string, std::vector<Event *>> &allWriteSet = trace->allWriteSet;
+  std::unordered_map<std::string, std::vector<Event *>> usefulWriteSet;
+  std::unordered_map<std::string, std::vector<Event *>> &writeSet = trace->writeSet;
+  std::unordered_map<std::string, std::vector<Event *>> &allWriteSet = trace->allWriteSet;
   usefulWriteSet.clear();
   for (auto oneVarWrites : writeSet) {
     allWriteSet.insert(oneVarWrites);
@@ -0,0 +1,116 @@
+//===-- IncrementalSolver.cpp -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Encode/IncrementalSolver.h"
+#include "klee/Support/OptionCategories.h"
+
+#include <cassert>
+#include <sstream>
+
+#include "llvm/Support/CommandLine.h"
+
+using namespace std;
+using namespace z3;
+
+namespace {
+llvm::cl::opt<unsigned> KleemGuardLifetime("kleem-guard-lifetime",
+                                           llvm::cl::desc("Retire the formulas of the shared solver that were not "
+                                                          "used by this many traces (default=8)"),
+                                           llvm::cl::init(8), llvm::cl::cat(klee::KleemCat));
+
+// the solver is not rebuilt for fewer retired guards
+const unsigned minRebuildGuards = 256;
+} // namespace
+
+namespace klee {
+
+IncrementalSolver::IncrementalSolver() : z3_solver(z3_ctx), nextGuardId(0), traceNum(0), retiredNum(0) {}
+
+IncrementalSolver::~IncrementalSolver() {
+  // release all the asts before the context is destroyed
+  guards.clear();
+}
+
+context &IncrementalSolver::getContext() {
+  return z3_ctx;
+}
+
+solver &IncrementalSolver::getSolver() {
+  return z3_solver;
+}
+
+expr IncrementalSolver::getGuard(const expr &formula, bool &isReused) {
+  // z3 shares structurally equal asts, so the same formula of a later trace has the same id.
+  // The map holds a reference to the formula, thus its id can't be recycled while it is cached.
+  unsigned id = Z3_get_ast_id(z3_ctx, formula);
+  unordered_map<unsigned, Guard>::iterator gi = guards.find(id);
+  isReused = gi != guards.end();
+  if (isReused) {
+    gi->second.lastUse = traceNum;
+    return gi->second.literal;
+  }
+  stringstream ss;
+  ss << "guard!" << nextGuardId++;
+  expr literal = z3_ctx.bool_const(ss.str().c_str());
+  z3_solver.add(implies(literal, formula));
+  Guard guard = {formula, literal, traceNum};
+  guards.insert(make_pair(id, guard));
+  if (!scopes.empty()) {
+    scopes.back().push_back(id);
+  }
+  return literal;
+}
+
+void IncrementalSolver::startTrace() {
+  traceNum++;
+  // the guards of open scopes go with their pop
+  if (!scopes.empty() || !KleemGuardLifetime) {
+    return;
+  }
+  for (unordered_map<unsigned, Guard>::iterator gi = guards.begin(); gi != guards.end();) {
+    if (traceNum - gi->second.lastUse > KleemGuardLifetime) {
+      // a false guard lets the solver drop the implication when it simplifies
+      z3_solver.add(!gi->second.literal);
+      gi = guards.erase(gi);
+      retiredNum++;
+    } else {
+      gi++;
+    }
+  }
+  if (retiredNum >= minRebuildGuards && retiredNum > guards.size()) {
+    rebuild();
+  }
+}
+
+// Only the guard implications live outside the scopes, so a fresh solver with
+// the live ones is equivalent for every check.
+void IncrementalSolver::rebuild() {
+  z3_solver.reset();
+  for (auto &guard : guards) {
+    z3_solver.add(implies(guard.second.literal, guard.second.formula));
+  }
+  retiredNum = 0;
+}
+
+void IncrementalSolver::push() {
+  z3_solver.push();
+  scopes.push_back(vector<unsigned>());
+}
+
+void IncrementalSolver::pop() {
+  assert(!scopes.empty() && "pop without push");
+  z3_solver.pop();
+  // the implications asserted in this scope are gone with it
+  for (auto id : scopes.back()) {
+    guards.erase(id);
+  }
+  scopes.pop_back();
+}
+
+} // namespace klee
@@ -22,9 +22,9 @@ using namespace z3;
 
 // constructor
 KQuery2Z3::KQuery2Z3(std::vector<ref<Expr>> &_kqueryExpr, z3::context &_z3_ctx)
-    : kqueryExpr(_kqueryExpr), z3_ctx(_z3_ctx) {}
+    : kqueryExpr(_kqueryExpr), z3_ctx(_z3_ctx), generation(0) {}
 
-KQuery2Z3::KQuery2Z3(z3::context &_z3_ctx) : z3_ctx(_z3_ctx) {}
+KQuery2Z3::KQuery2Z3(z3::context &_z3_ctx) : z3_ctx(_z3_ctx), generation(0) {}
 
 KQuery2Z3::~KQuery2Z3() {}
 
@@ -82,7 +82,43 @@ void KQuery2Z3::getZ3Expr() {
   }
 }
 
+void KQuery2Z3::markFloat(ref<Expr> &e) {
+  if (!e->isFloat) {
+    e->isFloat = true;
+    // translations built before this change may have treated e as an integer
+    generation++;
+  }
+}
+
+unsigned KQuery2Z3::getFloatMask(const ref<Expr> &e) {
+  unsigned mask = e->isFloat ? 1 : 0;
+  unsigned numKids = e->getNumKids();
+  for (unsigned i = 0; i < numKids && i < 31; i++) {
+    if (e->getKid(i)->isFloat) {
+      mask |= 1u << (i + 1);
+    }
+  }
+  return mask;
+}
+
 z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
+  std::unordered_map<const Expr *, CacheEntry>::iterator it = cache.find(ele.get());
+  if (it != cache.end() && it->second.generation == generation &&
+      it->second.floatMask == getFloatMask(ele)) {
+    return it->second.result;
+  }
+  z3::expr res = translate(ele);
+  // the float flags are read after translating, as translate() may set them on the kids
+  CacheEntry entry(ele, getFloatMask(ele), generation, res);
+  if (it != cache.end()) {
+    it->second = entry;
+  } else {
+    cache.insert(std::make_pair(ele.get(), entry));
+  }
+  return res;
+}
+
+z3::expr KQuery2Z3::translate(ref<Expr> &ele) {
   z3::expr res = z3_ctx.bool_val(true);
 
   switch (ele->getKind()) {
@@ -321,8 +357,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
       // if one of the operand is a float point number
       // then the left and right are all float point number.
       if (ae->left.get()->isFloat || ae->right.get()->isFloat) {
-        ae->left.get()->isFloat = true;
-        ae->right.get()->isFloat = true;
+        markFloat(ae->left);
+        markFloat(ae->right);
       }
       z3::expr left = eachExprToZ3(ae->left);
       z3::expr right = eachExprToZ3(ae->right);
@@ -336,8 +372,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Sub: {
       SubExpr *se = cast<SubExpr>(ele);
       if (se->left.get()->isFloat || se->right.get()->isFloat) {
-        se->left.get()->isFloat = true;
-        se->right.get()->isFloat = true;
+        markFloat(se->left);
+        markFloat(se->right);
       }
       z3::expr left = eachExprToZ3(se->left);
       z3::expr right = eachExprToZ3(se->right);
@@ -351,8 +387,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Mul: {
       MulExpr *me = cast<MulExpr>(ele);
       if (me->left.get()->isFloat || me->right.get()->isFloat) {
-        me->left.get()->isFloat = true;
-        me->right.get()->isFloat = true;
+        markFloat(me->left);
+        markFloat(me->right);
       }
       z3::expr left = eachExprToZ3(me->left);
       z3::expr right = eachExprToZ3(me->right);
@@ -368,8 +404,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
       // could handled with SDiv, but for test just do in here.
       UDivExpr *ue = cast<UDivExpr>(ele);
       if (ue->left.get()->isFloat || ue->right.get()->isFloat) {
-        ue->left.get()->isFloat = true;
-        ue->right.get()->isFloat = true;
+        markFloat(ue->left);
+        markFloat(ue->right);
       }
       z3::expr left = eachExprToZ3(ue->left);
       z3::expr right = eachExprToZ3(ue->right);
@@ -388,8 +424,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::SDiv: {
       SDivExpr *se = cast<SDivExpr>(ele);
       if (se->left.get()->isFloat || se->right.get()->isFloat) {
-        se->left.get()->isFloat = true;
-        se->right.get()->isFloat = true;
+        markFloat(se->left);
+        markFloat(se->right);
       }
       z3::expr left = eachExprToZ3(se->left);
       z3::expr right = eachExprToZ3(se->right);
@@ -409,8 +445,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::URem: {
       URemExpr *ur = cast<URemExpr>(ele);
       if (ur->left.get()->isFloat || ur->right.get()->isFloat) {
-        ur->left.get()->isFloat = true;
-        ur->right.get()->isFloat = true;
+        markFloat(ur->left);
+        markFloat(ur->right);
       }
       z3::expr left = eachExprToZ3(ur->left);
       z3::expr right = eachExprToZ3(ur->right);
@@ -431,8 +467,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::SRem: {
       SRemExpr *sr = cast<SRemExpr>(ele);
       if (sr->left.get()->isFloat || sr->right.get()->isFloat) {
-        sr->left.get()->isFloat = true;
-        sr->right.get()->isFloat = true;
+        markFloat(sr->left);
+        markFloat(sr->right);
       }
       z3::expr left = eachExprToZ3(sr->left);
       z3::expr right = eachExprToZ3(sr->right);
@@ -468,8 +504,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::And: {
       AndExpr *ae = cast<AndExpr>(ele);
       if (ae->left.get()->isFloat || ae->right.get()->isFloat) {
-        ae->left.get()->isFloat = true;
-        ae->right.get()->isFloat = true;
+        markFloat(ae->left);
+        markFloat(ae->right);
       }
       z3::expr left = eachExprToZ3(ae->left);
       z3::expr right = eachExprToZ3(ae->right);
@@ -506,8 +542,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Or: {
       OrExpr *oe = cast<OrExpr>(ele);
       if (oe->left.get()->isFloat || oe->right.get()->isFloat) {
-        oe->left.get()->isFloat = true;
-        oe->right.get()->isFloat = true;
+        markFloat(oe->left);
+        markFloat(oe->right);
       }
       z3::expr left = eachExprToZ3(oe->left);
       z3::expr right = eachExprToZ3(oe->right);
@@ -537,8 +573,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Xor: {
       XorExpr *xe = cast<XorExpr>(ele);
       if (xe->left.get()->isFloat || xe->right.get()->isFloat) {
-        xe->left.get()->isFloat = true;
-        xe->right.get()->isFloat = true;
+        markFloat(xe->left);
+        markFloat(xe->right);
       }
       z3::expr left = eachExprToZ3(xe->left);
       z3::expr right = eachExprToZ3(xe->right);
@@ -619,8 +655,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Eq: {
       EqExpr *ee = cast<EqExpr>(ele);
       if (ee->left.get()->isFloat || ee->right.get()->isFloat) {
-        ee->left.get()->isFloat = true;
-        ee->right.get()->isFloat = true;
+        markFloat(ee->left);
+        markFloat(ee->right);
       }
       // std::cerr << "ele = " << ele << std::endl;
       z3::expr left = eachExprToZ3(ee->left);
@@ -634,8 +670,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
       // probably can float point value's comparison.
       UltExpr *ue = cast<UltExpr>(ele);
       if (ue->left.get()->isFloat || ue->right.get()->isFloat) {
-        ue->left.get()->isFloat = true;
-        ue->right.get()->isFloat = true;
+        markFloat(ue->left);
+        markFloat(ue->right);
       }
       z3::expr left = eachExprToZ3(ue->left);
       z3::expr right = eachExprToZ3(ue->right);
@@ -654,8 +690,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Ule: {
       UleExpr *ue = cast<UleExpr>(ele);
       if (ue->left.get()->isFloat || ue->right.get()->isFloat) {
-        ue->left.get()->isFloat = true;
-        ue->right.get()->isFloat = true;
+        markFloat(ue->left);
+        markFloat(ue->right);
       }
       z3::expr left = eachExprToZ3(ue->left);
       z3::expr right = eachExprToZ3(ue->right);
@@ -673,8 +709,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Slt: {
       SltExpr *se = cast<SltExpr>(ele);
       if (se->left.get()->isFloat || se->right.get()->isFloat) {
-        se->left.get()->isFloat = true;
-        se->right.get()->isFloat = true;
+        markFloat(se->left);
+        markFloat(se->right);
       }
       z3::expr left = eachExprToZ3(se->left);
       z3::expr right = eachExprToZ3(se->right);
@@ -692,8 +728,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Sle: {
       SleExpr *se = cast<SleExpr>(ele);
       if (se->left.get()->isFloat || se->right.get()->isFloat) {
-        se->left.get()->isFloat = true;
-        se->right.get()->isFloat = true;
+        markFloat(se->left);
+        markFloat(se->right);
       }
       z3::expr left = eachExprToZ3(se->left);
       z3::expr right = eachExprToZ3(se->right);
@@ -712,8 +748,8 @@ z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
     case Expr::Ne: {
       NeExpr *ne = cast<NeExpr>(ele);
       if (ne->left.get()->isFloat || ne->right.get()->isFloat) {
-        ne->left.get()->isFloat = true;
-        ne->right.get()->isFloat = true;
+        markFloat(ne->left);
+        markFloat(ne->right);
       }
       z3::expr left = eachExprToZ3(ne->left);
       z3::expr right = eachExprToZ3(ne->right);
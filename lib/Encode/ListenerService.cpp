@@ -15,6 +15,7 @@
 #include <sys/time.h>
 
 #include "llvm/IR/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Intrinsics.h>
@@ -23,27 +24,53 @@
 
 #include "../Core/Executor.h"
 #include "../Core/ExternalDispatcher.h"
+#include "klee/Encode/DPOR.h"
 #include "klee/Encode/DTAM.h"
 #include "klee/Encode/Encode.h"
+#include "klee/Encode/IncrementalSolver.h"
 #include "klee/Encode/ListenerService.h"
 #include "klee/Encode/PSOListener.h"
 #include "klee/Encode/Prefix.h"
+#include "klee/Encode/PrefixScheduler.h"
 #include "klee/Encode/SymbolicListener.h"
 #include "klee/Encode/TaintListener.h"
+#include "klee/Encode/TraceLog.h"
 #include "klee/Thread/StackType.h"
 #include "klee/Config/DebugMacro.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
 
 extern void *__dso_handle __attribute__((__weak__));
 
+namespace {
+llvm::cl::opt<bool> KleemTraceLog("kleem-trace-log",
+                                  llvm::cl::desc("Append every trace of the run to traces.log in binary form, see "
+                                                 "TraceLog.h (default=false)"),
+                                  llvm::cl::init(false), llvm::cl::cat(klee::KleemCat));
+
+llvm::cl::opt<bool> KleemDPOR("kleem-dpor",
+                              llvm::cl::desc("Also add a prefix for every race of a new trace, ordered by the vector "
+                                             "clocks of its events, see DPOR.h (default=false)"),
+                              llvm::cl::init(false), llvm::cl::cat(klee::KleemCat));
+} // namespace
+
 namespace klee {
 
 ListenerService::ListenerService(Executor *executor) {
   rdManager = new RuntimeDataManager();
   interpreterHandler = executor->getHandlerPtr();
   encoder = NULL;
+  incrementalSolver = new IncrementalSolver();
   dtam = NULL;
   cost = 0;
+  traceLog = NULL;
+  if (KleemTraceLog) {
+    traceLog = new TraceLogWriter();
+    std::string path = interpreterHandler->getKleemOutputFilename("traces.log");
+    if (!traceLog->open(path)) {
+      kleem_note("Failed to open the trace log %s.", path.c_str());
+    }
+  }
 }
 
 ListenerService::~ListenerService() {
@@ -55,9 +82,11 @@ ListenerService::~ListenerService() {
   for (auto listener : bitcodeListeners) {
     delete listener;
   }
-  delete rdManager;
   delete encoder;
+  delete incrementalSolver;
+  delete rdManager;
   delete dtam;
+  delete traceLog;
 }
 
 void ListenerService::pushListener(BitcodeListener *bitcodeListener) {
@@ -106,61 +135,68 @@ void ListenerService::beforeRunMethodAsMain(Executor *executor, ExecutionState &
 
     for (unsigned i = 0, e = f->arg_size(); i != e; ++i)
       executor->bindArgument(executor->kmodule->functionMap[f], i, state, arguments[i]);
-    if (argvMO) {
-      const ObjectState *argvOSCurrent = state.currentThread->addressSpace->findObject(argvMO);
-      ObjectState *argvOS = executor->bindObjectInState(state, argvMO, false);
-      for (int i = 0; i < argc + 1 + envc + 1 + 1; i++) {
-        if (i == argc || i >= argc + 1 + envc) {
-          // Write NULL pointer
-          argvOS->write(i * NumPtrBytes, Expr::createPointer(0));
-        } else {
-          char *s = i < argc ? argv[i] : envp[i - (argc + 1)];
-          int j, len = strlen(s);
-          ref<Expr> argAddr = argvOSCurrent->read(i * NumPtrBytes, Context::get().getPointerWidth());
-          ObjectPair op;
-          bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, argAddr);
-          if (success) {
-            const MemoryObject *arg = op.first;
-            ObjectState *os = executor->bindObjectInState(state, arg, false);
-            for (j = 0; j < len + 1; j++) {
-              os->write8(j, s[j]);
+    AddressSpace *addressSpace = state.currentStack->addressSpace;
+    if (executor->initialShadowAddressSpace) {
+      addressSpace->copyFrom(*executor->initialShadowAddressSpace);
+    } else {
+      if (argvMO) {
+        const ObjectState *argvOSCurrent = state.currentThread->addressSpace->findObject(argvMO);
+        ObjectState *argvOS = executor->bindObjectInState(state, argvMO, false);
+        for (int i = 0; i < argc + 1 + envc + 1 + 1; i++) {
+          if (i == argc || i >= argc + 1 + envc) {
+            // Write NULL pointer
+            argvOS->write(i * NumPtrBytes, Expr::createPointer(0));
+          } else {
+            char *s = i < argc ? argv[i] : envp[i - (argc + 1)];
+            int j, len = strlen(s);
+            ref<Expr> argAddr = argvOSCurrent->read(i * NumPtrBytes, Context::get().getPointerWidth());
+            ObjectPair op;
+            bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, argAddr);
+            if (success) {
+              const MemoryObject *arg = op.first;
+              ObjectState *os = executor->bindObjectInState(state, arg, false);
+              for (j = 0; j < len + 1; j++) {
+                os->write8(j, s[j]);
+              }
+              argvOS->write(i * NumPtrBytes, arg->getBaseExpr());
             }
-            argvOS->write(i * NumPtrBytes, arg->getBaseExpr());
           }
         }
       }
-    }
 
-    for (llvm::Module::const_global_iterator gitr = m->global_begin(), e = m->global_end(); gitr != e; ++gitr) {
-      if (gitr->isDeclaration()) {
-        Type *ty = gitr->getType()->getElementType();
-        uint64_t size = executor->kmodule->targetData->getTypeStoreSize(ty);
-        MemoryObject *mo = executor->globalObjects.find(&*gitr)->second;
-        ObjectState *os = executor->bindObjectInState(state, mo, false);
-        if (size) {
-          void *addr;
-          if (gitr->getName() == "__dso_handle") {
-            addr = &__dso_handle; // wtf ?
-          } else {
-            addr = executor->externalDispatcher->resolveSymbol(gitr->getName());
+      for (llvm::Module::const_global_iterator gitr = m->global_begin(), e = m->global_end(); gitr != e; ++gitr) {
+        if (gitr->isDeclaration()) {
+          Type *ty = gitr->getType()->getElementType();
+          uint64_t size = executor->kmodule->targetData->getTypeStoreSize(ty);
+          MemoryObject *mo = executor->globalObjects.find(&*gitr)->second;
+          ObjectState *os = executor->bindObjectInState(state, mo, false);
+          if (size) {
+            void *addr;
+            if (gitr->getName() == "__dso_handle") {
+              addr = &__dso_handle; // wtf ?
+            } else {
+              addr = executor->externalDispatcher->resolveSymbol(gitr->getName());
+            }
+            for (unsigned offset = 0; offset < mo->size; offset++)
+              os->write8(offset, ((unsigned char *)addr)[offset]);
           }
-          for (unsigned offset = 0; offset < mo->size; offset++)
-            os->write8(offset, ((unsigned char *)addr)[offset]);
+        } else {
+          MemoryObject *mo = executor->globalObjects.find(&*gitr)->second;
+          ObjectState *os = executor->bindObjectInState(state, mo, false);
+          if (!gitr->hasInitializer())
+            os->initializeToRandom();
         }
-      } else {
-        MemoryObject *mo = executor->globalObjects.find(&*gitr)->second;
-        ObjectState *os = executor->bindObjectInState(state, mo, false);
-        if (!gitr->hasInitializer())
-          os->initializeToRandom();
       }
-    }
-    for (llvm::Module::const_global_iterator it = m->global_begin(), e = m->global_end(); it != e; ++it) {
-      if (it->hasInitializer()) {
-        MemoryObject *mo = executor->globalObjects.find(&*it)->second;
-        const ObjectState *os = state.currentStack->addressSpace->findObject(mo);
-        ObjectState *wos = state.currentStack->addressSpace->getWriteable(mo, os);
-        executor->initializeGlobalObject(state, wos, it->getInitializer(), 0);
+      for (llvm::Module::const_global_iterator it = m->global_begin(), e = m->global_end(); it != e; ++it) {
+        if (it->hasInitializer()) {
+          MemoryObject *mo = executor->globalObjects.find(&*it)->second;
+          const ObjectState *os = state.currentStack->addressSpace->findObject(mo);
+          ObjectState *wos = state.currentStack->addressSpace->getWriteable(mo, os);
+          executor->initializeGlobalObject(state, wos, it->getInitializer(), 0);
+        }
       }
+      // the first listener of the first execution builds the image of all
+      executor->initialShadowAddressSpace.reset(new AddressSpace(*addressSpace));
     }
 
     bit->beforeRunMethodAsMain(state);
@@ -169,6 +205,53 @@ void ListenerService::beforeRunMethodAsMain(Executor *executor, ExecutionState &
   }
 }
 
+// The call sites are classified once, the shadow call handling of every
+// listener and instruction only switches on the result.
+const ListenerService::CallInfo &ListenerService::getCallInfo(Executor *executor, ExecutionState &state,
+                                                              KInstruction *ki) {
+  std::unordered_map<KInstruction *, CallInfo>::iterator it = callInfos.find(ki);
+  if (it != callInfos.end()) {
+    return it->second;
+  }
+  CallSite cs(ki->inst);
+  Value *fp = cs.getCalledValue();
+  Function *f = executor->getTargetFunction(fp, state);
+  if (!f) {
+    assert(0 && "listenerSercive execute call");
+  }
+  CallInfo info;
+  info.function = f;
+  info.isDebugInfo = f->getName().contains("llvm.dbg.declare") || f->getName().contains("llvm.dbg.label");
+  const FunctionType *fType = dyn_cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+  const FunctionType *fpType = dyn_cast<FunctionType>(cast<PointerType>(fp->getType())->getElementType());
+  info.castArguments = fType != fpType;
+  if (!f->isDeclaration()) {
+    info.kind = DefinedCall;
+  } else if (f->getIntrinsicID() == Intrinsic::vastart) {
+    info.kind = VaStartCall;
+  } else if (f->getIntrinsicID() != Intrinsic::not_intrinsic) {
+    info.kind = IntrinsicCall;
+  } else {
+    std::string name = f->getName().str();
+    if (name == "pthread_create") {
+      info.kind = PthreadCreateCall;
+    } else if (name == "malloc" || name == "_ZdaPv" || name == "_Znaj" || name == "_Znam" || name == "valloc") {
+      info.kind = MallocCall;
+    } else if (name == "_ZdlPv" || name == "_Znwj" || name == "_Znwm" || name == "free") {
+      info.kind = FreeCall;
+    } else if (name == "calloc") {
+      info.kind = CallocCall;
+    } else if (name == "realloc") {
+      info.kind = ReallocCall;
+    } else {
+      info.kind = ExternalCall;
+    }
+  }
+  return callInfos.insert(std::make_pair(ki, info)).first->second;
+}
+
+// The listeners share no state, so each of them runs its hook and its shadow
+// execution of the instruction in turn with its stack switched in only once.
 void ListenerService::beforeExecuteInstruction(Executor *executor, ExecutionState &state, KInstruction *ki) {
 #if DEBUG_RUNTIME_LISTENER
   std::string instStr;
@@ -176,391 +259,365 @@ void ListenerService::beforeExecuteInstruction(Executor *executor, ExecutionStat
   ki->inst->print(str);
   kleem_debug("Thread %d, %s", state.currentThread->threadId, instStr.c_str());
 #endif
+  const CallInfo *call = NULL;
+  bool executeInShadow = false;
+  switch (ki->inst->getOpcode()) {
+    case Instruction::Ret:
+    case Instruction::Invoke:
+    case Instruction::Alloca:
+    case Instruction::Br:
+    case Instruction::Switch: {
+      break;
+    }
+    case Instruction::Call: {
+      call = &getCallInfo(executor, state, ki);
+      if (call->isDebugInfo)
+        call = NULL;
+      break;
+    }
+    default: {
+      executeInShadow = true;
+      break;
+    }
+  }
+
+  unsigned threadId = state.currentThread->threadId;
   for (auto bit : bitcodeListeners) {
-    state.currentStack = bit->stack[state.currentThread->threadId];
+    state.currentStack = bit->stack[threadId];
     bit->beforeExecuteInstruction(state, ki);
+    if (call) {
+      bindShadowArguments(executor, state, ki, *call, bit);
+    } else if (executeInShadow) {
+      executor->executeInstruction(state, ki);
+    }
     state.currentStack = state.currentThread->stack;
   }
+}
 
-  Instruction *llvmInst = ki->inst;
-  switch (llvmInst->getOpcode()) {
-    case Instruction::Ret: {
-      break;
-    }
-    case Instruction::Invoke: {
-      break;
-    }
-    case Instruction::Call: {
-      CallSite cs(llvmInst);
-      unsigned numArgs = cs.arg_size();
-      Value *fp = cs.getCalledValue();
-      Function *func = executor->getTargetFunction(fp, state);
-      if (!func) {
-        assert(0 && "listenerSercive execute call");
-      }
-      if (func->getName().contains("llvm.dbg.declare") || func->getName().contains("llvm.dbg.label"))
-        break;
-      for (auto listener : bitcodeListeners) {
-        state.currentStack = listener->stack[state.currentThread->threadId];
-        listener->arguments.reserve(numArgs);
-        for (unsigned j = 0; j < numArgs; ++j) {
-          listener->arguments.push_back(executor->eval(ki, j + 1, state).value);
-        }
-        const FunctionType *fType = dyn_cast<FunctionType>(cast<PointerType>(func->getType())->getElementType());
-        const FunctionType *fpType = dyn_cast<FunctionType>(cast<PointerType>(fp->getType())->getElementType());
-        if (fType != fpType) {
-          unsigned i = 0;
-          for (auto arg : listener->arguments) {
-            Expr::Width to, from = arg->getWidth();
-            if (i < fType->getNumParams()) {
-              to = executor->getWidthForLLVMType(fType->getParamType(i));
-              if (from != to) {
-                bool isSExt = cs.paramHasAttr(i + 1, llvm::Attribute::SExt);
-                if (isSExt) {
-                  listener->arguments[i] = SExtExpr::create(listener->arguments[i], to);
-                } else {
-                  listener->arguments[i] = ZExtExpr::create(listener->arguments[i], to);
-                }
-              }
-            }
-            i++;
-          }
-        }
-        if (func->isDeclaration()) {
-          switch (func->getIntrinsicID()) {
-            case Intrinsic::not_intrinsic: {
-              break;
-            }
-            case Intrinsic::vastart: {
-              StackFrame &sf = state.currentStack->realStack.back();
-              Expr::Width WordSize = Context::get().getPointerWidth();
-              if (WordSize == Expr::Int32) {
-                executor->executeMemoryOperation(state, true, listener->arguments[0], sf.varargs->getBaseExpr(), 0);
-              } else {
-                // gp_offset
-                executor->executeMemoryOperation(state, true, listener->arguments[0], ConstantExpr::create(48, 32), 0);
-                // fp_offset
-                executor->executeMemoryOperation(state, true,
-                                                 AddExpr::create(listener->arguments[0], ConstantExpr::create(4, 64)),
-                                                 ConstantExpr::create(304, 32), 0);
-                // overflow_arg_area
-                executor->executeMemoryOperation(state, true,
-                                                 AddExpr::create(listener->arguments[0], ConstantExpr::create(8, 64)),
-                                                 sf.varargs->getBaseExpr(), 0);
-                // reg_save_area
-                executor->executeMemoryOperation(state, true,
-                                                 AddExpr::create(listener->arguments[0], ConstantExpr::create(16, 64)),
-                                                 ConstantExpr::create(0, 64), 0);
-              }
-              break;
-            }
-            default:
-              break;
+void ListenerService::bindShadowArguments(Executor *executor, ExecutionState &state, KInstruction *ki,
+                                          const CallInfo &call, BitcodeListener *listener) {
+  CallSite cs(ki->inst);
+  unsigned numArgs = cs.arg_size();
+  listener->arguments.reserve(numArgs);
+  for (unsigned j = 0; j < numArgs; ++j) {
+    listener->arguments.push_back(executor->eval(ki, j + 1, state).value);
+  }
+  if (call.castArguments) {
+    const FunctionType *fType = dyn_cast<FunctionType>(cast<PointerType>(call.function->getType())->getElementType());
+    unsigned i = 0;
+    for (auto arg : listener->arguments) {
+      Expr::Width to, from = arg->getWidth();
+      if (i < fType->getNumParams()) {
+        to = executor->getWidthForLLVMType(fType->getParamType(i));
+        if (from != to) {
+          bool isSExt = cs.paramHasAttr(i + 1, llvm::Attribute::SExt);
+          if (isSExt) {
+            listener->arguments[i] = SExtExpr::create(listener->arguments[i], to);
+          } else {
+            listener->arguments[i] = ZExtExpr::create(listener->arguments[i], to);
           }
         }
-        state.currentStack = state.currentThread->stack;
       }
-      break;
+      i++;
     }
-
-    case Instruction::Alloca: {
-      break;
+  }
+  if (call.kind == VaStartCall) {
+    StackFrame &sf = state.currentStack->realStack.back();
+    Expr::Width WordSize = Context::get().getPointerWidth();
+    if (WordSize == Expr::Int32) {
+      executor->executeMemoryOperation(state, true, listener->arguments[0], sf.varargs->getBaseExpr(), 0);
+    } else {
+      // gp_offset
+      executor->executeMemoryOperation(state, true, listener->arguments[0], ConstantExpr::create(48, 32), 0);
+      // fp_offset
+      executor->executeMemoryOperation(state, true, AddExpr::create(listener->arguments[0], ConstantExpr::create(4, 64)),
+                                       ConstantExpr::create(304, 32), 0);
+      // overflow_arg_area
+      executor->executeMemoryOperation(state, true, AddExpr::create(listener->arguments[0], ConstantExpr::create(8, 64)),
+                                       sf.varargs->getBaseExpr(), 0);
+      // reg_save_area
+      executor->executeMemoryOperation(state, true, AddExpr::create(listener->arguments[0], ConstantExpr::create(16, 64)),
+                                       ConstantExpr::create(0, 64), 0);
     }
-    case Instruction::Br: {
+  }
+}
+
+void ListenerService::afterExecuteInstruction(Executor *executor, ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  const CallInfo *call = NULL;
+  // the object of an alloca is found once in the real address space
+  bool bindAlloca = false;
+  const MemoryObject *allocated = NULL;
+  switch (i->getOpcode()) {
+    case Instruction::Invoke:
+    case Instruction::Call: {
+      call = &getCallInfo(executor, state, ki);
       break;
     }
-    case Instruction::Switch: {
+
+    case Instruction::Alloca: {
+      AllocaInst *ai = cast<AllocaInst>(i);
+      unsigned elementSize = executor->kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
+      ref<Expr> size = Expr::createPointer(elementSize);
+      if (ai->isArrayAllocation()) {
+        ref<Expr> count = executor->eval(ki, 0, state).value;
+        count = Expr::createZExtToPointerWidth(count);
+        size = MulExpr::create(size, count);
+      }
+      size = executor->toUnique(state, size);
+      if (dyn_cast<ConstantExpr>(size)) {
+        bindAlloca = true;
+        ref<Expr> addr = executor->getDestCell(state, ki).value;
+        ObjectPair op;
+        bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addr);
+        if (success) {
+          allocated = op.first;
+        }
+      }
       break;
     }
 
     default: {
-      for (auto bit : bitcodeListeners) {
-        state.currentStack = bit->stack[state.currentThread->threadId];
-        executor->executeInstruction(state, ki);
-        state.currentStack = state.currentThread->stack;
-      }
       break;
     }
   }
-}
 
-void ListenerService::afterExecuteInstruction(Executor *executor, ExecutionState &state, KInstruction *ki) {
-  Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
-    case Instruction::Ret: {
-      for (auto bit : bitcodeListeners) {
-        state.currentStack = bit->stack[state.currentThread->threadId];
-        ReturnInst *ri = cast<ReturnInst>(i);
-        KInstIterator kcaller = state.currentStack->realStack.back().caller;
-        Instruction *caller = kcaller ? kcaller->inst : 0;
-        bool isVoidReturn = (ri->getNumOperands() == 0);
-        ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
-        if (!isVoidReturn) {
-          result = executor->eval(ki, 0, state).value;
+  unsigned threadId = state.currentThread->threadId;
+  for (auto bit : bitcodeListeners) {
+    state.currentStack = bit->stack[threadId];
+    switch (i->getOpcode()) {
+      case Instruction::Ret: {
+        returnInShadow(executor, state, ki);
+        break;
+      }
+      case Instruction::Invoke:
+      case Instruction::Call: {
+        callInShadow(executor, state, ki, *call, bit);
+        break;
+      }
+      case Instruction::Alloca: {
+        if (!bindAlloca) {
+          break;
         }
-        if (state.currentStack->realStack.size() <= 1) {
+        if (allocated) {
+          bool isLocal = true;
+          ObjectState *os = executor->bindObjectInState(state, allocated, isLocal);
+          os->initializeToRandom();
+          executor->bindLocal(ki, state, allocated->getBaseExpr());
+        } else {
+          executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    bit->afterExecuteInstruction(state, ki);
+    state.currentStack = state.currentThread->stack;
+  }
+}
 
+void ListenerService::returnInShadow(Executor *executor, ExecutionState &state, KInstruction *ki) {
+  ReturnInst *ri = cast<ReturnInst>(ki->inst);
+  KInstIterator kcaller = state.currentStack->realStack.back().caller;
+  Instruction *caller = kcaller ? kcaller->inst : 0;
+  bool isVoidReturn = (ri->getNumOperands() == 0);
+  ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
+  if (!isVoidReturn) {
+    result = executor->eval(ki, 0, state).value;
+  }
+  if (state.currentStack->realStack.size() <= 1) {
+    return;
+  }
+  state.currentStack->popFrame();
+  if (!isVoidReturn) {
+    Type *t = caller->getType();
+    if (t != Type::getVoidTy(ri->getContext())) {
+      Expr::Width from = result->getWidth();
+      Expr::Width to = executor->getWidthForLLVMType(t);
+      if (from != to) {
+        CallSite cs = (isa<InvokeInst>(caller) ? CallSite(cast<InvokeInst>(caller)) : CallSite(cast<CallInst>(caller)));
+        bool isSExt = cs.paramHasAttr(0, llvm::Attribute::SExt);
+        if (isSExt) {
+          result = SExtExpr::create(result, to);
         } else {
-          state.currentStack->popFrame();
-          if (!isVoidReturn) {
-            Type *t = caller->getType();
-            if (t != Type::getVoidTy(i->getContext())) {
-              Expr::Width from = result->getWidth();
-              Expr::Width to = executor->getWidthForLLVMType(t);
-              if (from != to) {
-                CallSite cs =
-                    (isa<InvokeInst>(caller) ? CallSite(cast<InvokeInst>(caller)) : CallSite(cast<CallInst>(caller)));
-                bool isSExt = cs.paramHasAttr(0, llvm::Attribute::SExt);
-                if (isSExt) {
-                  result = SExtExpr::create(result, to);
-                } else {
-                  result = ZExtExpr::create(result, to);
-                }
-              }
-              executor->bindLocal(kcaller, state, result);
-            }
-          }
-          state.currentStack = state.currentThread->stack;
+          result = ZExtExpr::create(result, to);
         }
       }
-      break;
+      executor->bindLocal(kcaller, state, result);
     }
+  }
+}
 
-    case Instruction::Invoke:
-    case Instruction::Call: {
-      for (auto bit : bitcodeListeners) {
-        state.currentStack = bit->stack[state.currentThread->threadId];
-        CallSite cs(i);
-        Value *fp = cs.getCalledValue();
-        Function *f = executor->getTargetFunction(fp, state);
-        if (f) {
-          if (f && f->isDeclaration()) {
-            switch (f->getIntrinsicID()) {
-              case Intrinsic::not_intrinsic:
-
-                if (f->getName().str() == "pthread_create") {
-                  CallInst *calli = dyn_cast<CallInst>(ki->inst);
-                  Value *threadEntranceFP = calli->getArgOperand(2);
-                  Function *threadEntrance = executor->getTargetFunction(threadEntranceFP, state);
-                  if (!threadEntrance) {
-                    ref<Expr> param = executor->eval(ki, 3, state).value;
-                    ConstantExpr *functionPtr = dyn_cast<ConstantExpr>(param);
-                    threadEntrance = (Function *)(functionPtr->getZExtValue());
-                  }
-                  KFunction *kthreadEntrance = executor->kmodule->functionMap[threadEntrance];
-                  PointerType *pointerType = (PointerType *)(calli->getArgOperand(0)->getType());
-                  IntegerType *elementType = (IntegerType *)(pointerType->getElementType());
-                  Expr::Width type = elementType->getBitWidth();
-                  ref<Expr> address = bit->arguments[0];
-                  ObjectPair op;
-                  bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, address);
-                  if (success) {
-                    const MemoryObject *mo = op.first;
-                    ref<Expr> offset = mo->getOffsetExpr(address);
-                    const ObjectState *os = op.second;
-                    ref<Expr> threadID = os->read(offset, type);
-                    executor->executeMemoryOperation(state, true, address, threadID, 0);
-                    executor->bindLocal(ki, state, ConstantExpr::create(0, Expr::Int32));
-
-                    StackType *stack = new StackType(&(bit->addressSpace));
-                    bit->stack[dyn_cast<ConstantExpr>(threadID)->getAPValue().getSExtValue()] = stack;
-                    stack->realStack.reserve(10);
-                    stack->pushFrame(0, kthreadEntrance);
-                    state.currentStack = stack;
-                    executor->bindArgument(kthreadEntrance, 0, state, bit->arguments[3]);
+void ListenerService::callInShadow(Executor *executor, ExecutionState &state, KInstruction *ki, const CallInfo &call,
+                                   BitcodeListener *bit) {
+  Instruction *i = ki->inst;
+  Function *f = call.function;
+  switch (call.kind) {
+    case PthreadCreateCall: {
+      CallInst *calli = dyn_cast<CallInst>(ki->inst);
+      Value *threadEntranceFP = calli->getArgOperand(2);
+      Function *threadEntrance = executor->getTargetFunction(threadEntranceFP, state);
+      if (!threadEntrance) {
+        ref<Expr> param = executor->eval(ki, 3, state).value;
+        ConstantExpr *functionPtr = dyn_cast<ConstantExpr>(param);
+        threadEntrance = (Function *)(functionPtr->getZExtValue());
+      }
+      KFunction *kthreadEntrance = executor->kmodule->functionMap[threadEntrance];
+      PointerType *pointerType = (PointerType *)(calli->getArgOperand(0)->getType());
+      IntegerType *elementType = (IntegerType *)(pointerType->getElementType());
+      Expr::Width type = elementType->getBitWidth();
+      ref<Expr> address = bit->arguments[0];
+      ObjectPair op;
+      bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, address);
+      if (success) {
+        const MemoryObject *mo = op.first;
+        ref<Expr> offset = mo->getOffsetExpr(address);
+        const ObjectState *os = op.second;
+        ref<Expr> threadID = os->read(offset, type);
+        executor->executeMemoryOperation(state, true, address, threadID, 0);
+        executor->bindLocal(ki, state, ConstantExpr::create(0, Expr::Int32));
+
+        StackType *stack = new StackType(&(bit->addressSpace));
+        bit->stack[dyn_cast<ConstantExpr>(threadID)->getAPValue().getSExtValue()] = stack;
+        stack->realStack.reserve(10);
+        stack->pushFrame(0, kthreadEntrance);
+        state.currentStack = stack;
+        executor->bindArgument(kthreadEntrance, 0, state, bit->arguments[3]);
 #if DEBUG_RUNTIME_LISTENER
-                    llvm::errs() << "bit->arguments[3] : " << bit->arguments[3] << "\n";
+        llvm::errs() << "bit->arguments[3] : " << bit->arguments[3] << "\n";
 #endif
-                    state.currentStack = bit->stack[state.currentThread->threadId];
-                  }
-
-                } else if (f->getName().str() == "malloc" || f->getName().str() == "_ZdaPv" ||
-                           f->getName().str() == "_Znaj" || f->getName().str() == "_Znam" ||
-                           f->getName().str() == "valloc") {
-                  ref<Expr> size = bit->arguments[0];
-                  bool isLocal = false;
-                  size = executor->toUnique(state, size);
-                  if (dyn_cast<ConstantExpr>(size)) {
-                    ref<Expr> addr = state.currentThread->stack->realStack.back().locals[ki->dest].value;
-                    ObjectPair op;
-                    bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addr);
-                    if (success) {
-                      const MemoryObject *mo = op.first;
+        state.currentStack = bit->stack[state.currentThread->threadId];
+      }
+      break;
+    }
+    case MallocCall: {
+      ref<Expr> size = bit->arguments[0];
+      bool isLocal = false;
+      size = executor->toUnique(state, size);
+      if (dyn_cast<ConstantExpr>(size)) {
+        ref<Expr> addr = state.currentThread->stack->realStack.back().locals[ki->dest].value;
+        ObjectPair op;
+        bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addr);
+        if (success) {
+          const MemoryObject *mo = op.first;
 #if DEBUG_RUNTIME_LISTENER
-                      llvm::errs() << "mo address : " << mo->address << " mo size : " << mo->size << "\n";
+          llvm::errs() << "mo address : " << mo->address << " mo size : " << mo->size << "\n";
 #endif
-                      ObjectState *os = executor->bindObjectInState(state, mo, isLocal);
-                      os->initializeToRandom();
-                      executor->bindLocal(ki, state, mo->getBaseExpr());
-                    } else {
-                      executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
-                    }
-                  }
-                } else if (f->getName().str() == "_ZdlPv" || f->getName().str() == "_Znwj" ||
-                           f->getName().str() == "_Znwm" || f->getName().str() == "free") {
-                  ref<Expr> address = bit->arguments[0];
-                  // llvm::errs() << "address: " << address << "\n ";
-                  Executor::StatePair zeroPointer = executor->fork(state, Expr::createIsZero(address), true);
-                  if (zeroPointer.first) {
-                    if (ki)
-                      executor->bindLocal(ki, *zeroPointer.first, Expr::createPointer(0));
-                  }
-                  if (zeroPointer.second) { // address != 0
-                    Executor::ExactResolutionList rl;
-                    executor->resolveExact(*zeroPointer.second, address, rl, "free");
-                    for (Executor::ExactResolutionList::iterator it = rl.begin(), ie = rl.end(); it != ie; ++it) {
-                      const MemoryObject *mo = it->first.first;
-                      if (mo->isLocal) {
-                        executor->terminateStateOnError(*it->second, "free of alloca", Executor::Unhandled, "free.err",
-                                                        executor->getAddressInfo(*it->second, address));
-                      } else if (mo->isGlobal) {
-                        executor->terminateStateOnError(*it->second, "free of global", Executor::Unhandled, "free.err",
-                                                        executor->getAddressInfo(*it->second, address));
-                      } else {
-                        it->second->currentStack->addressSpace->unbindObject(mo);
-                        if (ki)
-                          executor->bindLocal(ki, *it->second, Expr::createPointer(0));
-                      }
-                    }
-                  }
-                } else if (f->getName().str() == "calloc") {
-                  ref<Expr> size = MulExpr::create(bit->arguments[0], bit->arguments[1]);
-                  bool isLocal = false;
-                  size = executor->toUnique(state, size);
-                  if (dyn_cast<ConstantExpr>(size)) {
-                    ref<Expr> addr = state.currentThread->stack->realStack.back().locals[ki->dest].value;
-                    // llvm::errs() << "calloc address : "; addr->dump();
-                    ObjectPair op;
-                    bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addr);
-                    if (success) {
-                      const MemoryObject *mo = op.first;
-                      // llvm::errs() << "calloc address ; " << mo->address << " calloc size : " << mo->size << "\n";
-                      ObjectState *os = executor->bindObjectInState(state, mo, isLocal);
-                      os->initializeToRandom();
-                      executor->bindLocal(ki, state, mo->getBaseExpr());
-                    } else {
-                      executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
-                    }
-                  }
-                } else if (f->getName().str() == "realloc") {
-                  assert(0 && "realloc");
-                } else {
-                  //										(*bit)->addressSpace.copyInConcretes();
-                  Type *resultType = ki->inst->getType();
-                  if (resultType != Type::getVoidTy(i->getContext())) {
-                    ref<Expr> e = state.currentThread->stack->realStack.back().locals[ki->dest].value;
-                    executor->bindLocal(ki, state, e);
-                  }
-                }
-                break;
-              case Intrinsic::vastart: {
-                break;
-              }
-              default:
-                break;
-            }
-          } else {
-            KFunction *kf = executor->kmodule->functionMap[f];
-            state.currentStack->pushFrame(state.currentThread->prevPC, kf);
-            unsigned callingArgs = bit->arguments.size();
-            unsigned funcArgs = f->arg_size();
-            if (f->isVarArg()) {
-              Expr::Width WordSize = Context::get().getPointerWidth();
-              StackFrame &sf = state.currentStack->realStack.back();
-              MemoryObject *mo = sf.varargs = state.currentThread->stack->realStack.back().varargs;
-              ObjectState *os = executor->bindObjectInState(state, mo, true);
-              unsigned offset = 0;
-              for (unsigned i = funcArgs; i < callingArgs; i++) {
-                if (WordSize == Expr::Int32) {
-                  os->write(offset, bit->arguments[i]);
-                  offset += Expr::getMinBytesForWidth(bit->arguments[i]->getWidth());
-                } else {
-                  Expr::Width argWidth = bit->arguments[i]->getWidth();
-                  if (argWidth > Expr::Int64) {
-                    offset = llvm::alignTo(offset, 16);
-                  }
-                  os->write(offset, bit->arguments[i]);
-                  offset += llvm::alignTo(argWidth, WordSize) / 8;
-                }
-              }
-            }
-            unsigned numFormals = f->arg_size();
-            for (unsigned i = 0; i < numFormals; ++i) {
-              executor->bindArgument(kf, i, state, bit->arguments[i]);
-            }
-          }
+          ObjectState *os = executor->bindObjectInState(state, mo, isLocal);
+          os->initializeToRandom();
+          executor->bindLocal(ki, state, mo->getBaseExpr());
         } else {
-          assert(0 && "listenerSercive execute call");
+          executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
         }
-        bit->arguments.clear();
-        state.currentStack = state.currentThread->stack;
       }
       break;
     }
-
-    case Instruction::Alloca: {
-      AllocaInst *ai = cast<AllocaInst>(i);
-      unsigned elementSize = executor->kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
-      ref<Expr> size = Expr::createPointer(elementSize);
-      if (ai->isArrayAllocation()) {
-        ref<Expr> count = executor->eval(ki, 0, state).value;
-        count = Expr::createZExtToPointerWidth(count);
-        size = MulExpr::create(size, count);
+    case FreeCall: {
+      ref<Expr> address = bit->arguments[0];
+      Executor::StatePair zeroPointer = executor->fork(state, Expr::createIsZero(address), true);
+      if (zeroPointer.first) {
+        if (ki)
+          executor->bindLocal(ki, *zeroPointer.first, Expr::createPointer(0));
+      }
+      if (zeroPointer.second) { // address != 0
+        Executor::ExactResolutionList rl;
+        executor->resolveExact(*zeroPointer.second, address, rl, "free");
+        for (Executor::ExactResolutionList::iterator it = rl.begin(), ie = rl.end(); it != ie; ++it) {
+          const MemoryObject *mo = it->first.first;
+          if (mo->isLocal) {
+            executor->terminateStateOnError(*it->second, "free of alloca", Executor::Unhandled, "free.err",
+                                            executor->getAddressInfo(*it->second, address));
+          } else if (mo->isGlobal) {
+            executor->terminateStateOnError(*it->second, "free of global", Executor::Unhandled, "free.err",
+                                            executor->getAddressInfo(*it->second, address));
+          } else {
+            it->second->currentStack->addressSpace->unbindObject(mo);
+            if (ki)
+              executor->bindLocal(ki, *it->second, Expr::createPointer(0));
+          }
+        }
       }
-      bool isLocal = true;
+      break;
+    }
+    case CallocCall: {
+      ref<Expr> size = MulExpr::create(bit->arguments[0], bit->arguments[1]);
+      bool isLocal = false;
       size = executor->toUnique(state, size);
       if (dyn_cast<ConstantExpr>(size)) {
-        ref<Expr> addr = executor->getDestCell(state, ki).value;
-        //					llvm::errs() << "alloc address : ";
-        //					addr->dump();
+        ref<Expr> addr = state.currentThread->stack->realStack.back().locals[ki->dest].value;
         ObjectPair op;
         bool success = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addr);
         if (success) {
           const MemoryObject *mo = op.first;
-          //						llvm::errs() << "alloc address ; " << mo->address << " alloc size
-          //:
-          //"
-          //<< mo->size << "\n";
-          for (auto bit : bitcodeListeners) {
-            state.currentStack = bit->stack[state.currentThread->threadId];
-            ObjectState *os = executor->bindObjectInState(state, mo, isLocal);
-            os->initializeToRandom();
-            executor->bindLocal(ki, state, mo->getBaseExpr());
-            state.currentStack = state.currentThread->stack;
-          }
+          ObjectState *os = executor->bindObjectInState(state, mo, isLocal);
+          os->initializeToRandom();
+          executor->bindLocal(ki, state, mo->getBaseExpr());
         } else {
-          for (auto bit : bitcodeListeners) {
-            state.currentStack = bit->stack[state.currentThread->threadId];
-            executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
-            state.currentStack = state.currentThread->stack;
-          }
+          executor->bindLocal(ki, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
         }
       }
       break;
     }
-
-    case Instruction::Br: {
+    case ReallocCall: {
+      assert(0 && "realloc");
       break;
     }
-    case Instruction::Switch: {
+    case ExternalCall: {
+      Type *resultType = ki->inst->getType();
+      if (resultType != Type::getVoidTy(i->getContext())) {
+        ref<Expr> e = state.currentThread->stack->realStack.back().locals[ki->dest].value;
+        executor->bindLocal(ki, state, e);
+      }
       break;
     }
-
-    default: {
+    case VaStartCall:
+    case IntrinsicCall: {
+      break;
+    }
+    case DefinedCall: {
+      KFunction *kf = executor->kmodule->functionMap[f];
+      state.currentStack->pushFrame(state.currentThread->prevPC, kf);
+      unsigned callingArgs = bit->arguments.size();
+      unsigned funcArgs = f->arg_size();
+      if (f->isVarArg()) {
+        Expr::Width WordSize = Context::get().getPointerWidth();
+        StackFrame &sf = state.currentStack->realStack.back();
+        MemoryObject *mo = sf.varargs = state.currentThread->stack->realStack.back().varargs;
+        ObjectState *os = executor->bindObjectInState(state, mo, true);
+        unsigned offset = 0;
+        for (unsigned i = funcArgs; i < callingArgs; i++) {
+          if (WordSize == Expr::Int32) {
+            os->write(offset, bit->arguments[i]);
+            offset += Expr::getMinBytesForWidth(bit->arguments[i]->getWidth());
+          } else {
+            Expr::Width argWidth = bit->arguments[i]->getWidth();
+            if (argWidth > Expr::Int64) {
+              offset = llvm::alignTo(offset, 16);
+            }
+            os->write(offset, bit->arguments[i]);
+            offset += llvm::alignTo(argWidth, WordSize) / 8;
+          }
+        }
+      }
+      unsigned numFormals = f->arg_size();
+      for (unsigned i = 0; i < numFormals; ++i) {
+        executor->bindArgument(kf, i, state, bit->arguments[i]);
+      }
       break;
     }
   }
-
-  for (auto bit : bitcodeListeners) {
-    state.currentStack = bit->stack[state.currentThread->threadId];
-    bit->afterExecuteInstruction(state, ki);
-    state.currentStack = state.currentThread->stack;
-  }
+  bit->arguments.clear();
 }
 
+// The executor releases the memory objects of the execution right after this,
+// the listeners are kept for the analysis of the trace but must not refer to
+// those objects any more.
 void ListenerService::afterRunMethodAsMain(ExecutionState &state) {
   for (auto bit : bitcodeListeners) {
     bit->afterRunMethodAsMain(state);
+    bit->releaseShadowMemory();
   }
 }
 
@@ -590,8 +647,19 @@ void ListenerService::startControl(Executor *executor) {
   gettimeofday(&start, NULL);
 }
 
+// Called in a process resumed from a snapshot: the listeners of the snapshot
+// keep recording, only the trace takes the id given by the coordinator.
+void ListenerService::resumeControl(Executor *executor, unsigned step) {
+  rdManager->getCurrentTrace()->Id = executor->executionNum;
+  kleem_execution("%dth execution, resumed from a snapshot at step %u, prefix is %s.", executor->executionNum, step,
+                  executor->prefix->getName().c_str());
+  gettimeofday(&start, NULL);
+}
+
 void ListenerService::taintAnalysis() {
   gettimeofday(&start, NULL);
+  // the analysis of the previous trace is no longer needed
+  delete dtam;
   dtam = new DTAM(rdManager);
   dtam->work();
   gettimeofday(&finish, NULL);
@@ -646,9 +714,18 @@ void ListenerService::endControl(Executor *executor) {
   if (executor->execStatus != Executor::SUCCESS) {
     kleem_execution("Failed to execute, abandon this execution.");
     // executor->isFinished = true;
+    rdManager->getCurrentTrace()->traceType = Trace::FAILED;
+    rdManager->getCurrentTrace()->isUntested = false;
+    releaseListeners();
+    rdManager->retireCurrentTrace();
     return;
   }
-  if (!rdManager->isCurrentTraceUntested()) {
+  analyzeTrace(executor, rdManager->isCurrentTraceUntested());
+}
+
+// isUntested--whether the dedup check decided that the current trace is a new path
+void ListenerService::analyzeTrace(Executor *executor, bool isUntested) {
+  if (!isUntested) {
     rdManager->getCurrentTrace()->traceType = Trace::REDUNDANT;
     kleem_execution("Found a old path.");
   } else {
@@ -674,7 +751,8 @@ void ListenerService::endControl(Executor *executor) {
     rdManager->allDTAMSerialCost.push_back(cost);
 
     gettimeofday(&start, NULL);
-    encoder = new Encode(rdManager, executor->getHandlerPtr());
+    incrementalSolver->startTrace();
+    encoder = new Encode(rdManager, executor->getHandlerPtr(), incrementalSolver);
     encoder->constraintEncoding();
 #if PRINT_DETAILED_TRACE
     printCurrentTrace(false);
@@ -684,6 +762,11 @@ void ListenerService::endControl(Executor *executor) {
     cost = (double)(finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
     rdManager->solvingCost += cost;
 
+    if (KleemDPOR) {
+      DPOR dpor(rdManager);
+      dpor.addRacePrefixes(executor->prefix);
+    }
+
 #if DO_ASSERT_VERIFICATION
     kleem_verifyassert("Verify the assertions on current trace.");
     encoder->verifyAssertion();
@@ -695,9 +778,22 @@ void ListenerService::endControl(Executor *executor) {
     taintAnalysis();
     kleem_dstam("Taint analysis is over.");
 #endif
+    // the encoder reports its statistics to rdManager when it is released
+    delete encoder;
+    encoder = NULL;
   }
 
-  while(!bitcodeListeners.empty()) {
+  if (traceLog) {
+    traceLog->write(rdManager->getCurrentTrace());
+  }
+  releaseListeners();
+  rdManager->retireCurrentTrace();
+}
+
+// the listeners of an execution hold its stacks, they are not reused
+void ListenerService::releaseListeners() {
+  while (!bitcodeListeners.empty()) {
+    delete bitcodeListeners.back();
     bitcodeListeners.pop_back();
   }
 }
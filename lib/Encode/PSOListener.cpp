@@ -81,6 +81,7 @@ void PSOListener::beforeExecuteInstruction(ExecutionState &state, KInstruction *
   } else {
     item = trace->createEvent(thread->threadId, ki, Event::IGNORE);
   }
+  item->isVisible = executor->isVisibleStep;
 
   // the virtual event which should be inserted before/behind item
   vector<Event *> frontVirtualEvents, backVirtualEvents;
@@ -7,100 +7,291 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <iterator>
+#include <algorithm>
+#include <cassert>
 
 #include "klee/Encode/Prefix.h"
 #include "klee/Module/InstructionInfoTable.h"
-#include <llvm/IR/Instruction.h>
 
 using namespace ::std;
 using namespace ::llvm;
 
 namespace klee {
 
-Prefix::Prefix(vector<Event *> &eventList, std::map<Event *, uint64_t> &threadIdMap, std::string name)
-    : eventList(eventList), threadIdMap(threadIdMap), name(name) {
-  position = this->eventList.begin();
+Prefix::Prefix(std::string name) : branchInstId(0), brCondition(false), name(name), dporState(0) {
+  seek(0);
 }
 
-void Prefix::reuse() {
-  position = this->eventList.begin();
+Prefix::Prefix(vector<Event *> &eventList, std::map<Event *, uint64_t> &threadIdMap, std::string name)
+    : branchInstId(0), brCondition(false), name(name), dporState(0) {
+  instIds.reserve(eventList.size());
+  for (auto event : eventList) {
+    if (!event->isVisible) {
+      continue;
+    }
+    if (runs.empty() || runs.back().threadId != event->threadId) {
+      Run run = {event->threadId, 0};
+      runs.push_back(run);
+    }
+    runs.back().count++;
+    map<Event *, uint64_t>::iterator ti = threadIdMap.find(event);
+    if (ti != threadIdMap.end()) {
+      children.push_back(make_pair((unsigned)instIds.size(), ti->second));
+    }
+    instIds.push_back(event->inst->info->id);
+  }
+  // the last event is the branch the prefix flips, it may be no step
+  if (!eventList.empty()) {
+    branchInstId = eventList.back()->inst->info->id;
+    brCondition = eventList.back()->brCondition;
+  }
+  seek(0);
 }
 
 Prefix::~Prefix() {}
 
-vector<Event *> *Prefix::getEventList() {
-  return &eventList;
+void Prefix::seek(unsigned position) {
+  this->position = std::min<size_t>(position, instIds.size());
+  runIndex = 0;
+  runOffset = this->position;
+  while (runIndex < runs.size() && runOffset >= runs[runIndex].count) {
+    runOffset -= runs[runIndex].count;
+    runIndex++;
+  }
+  childIndex = lower_bound(children.begin(), children.end(), make_pair(this->position, (uint64_t)0)) -
+               children.begin();
+}
+
+void Prefix::reuse() {
+  seek(0);
+}
+
+// Takes over the schedule of other and continues at the given position. The
+// object itself is kept, since the schedulers hold pointers to it.
+void Prefix::rebase(Prefix &other, unsigned position) {
+  runs.swap(other.runs);
+  instIds.swap(other.instIds);
+  children.swap(other.children);
+  branchInstId = other.branchInstId;
+  brCondition = other.brCondition;
+  name = other.name;
+  dporState = other.dporState;
+  dporThreads.swap(other.dporThreads);
+  sleepSet.swap(other.sleepSet);
+  other.runs.clear();
+  other.instIds.clear();
+  other.children.clear();
+  other.dporThreads.clear();
+  other.sleepSet.clear();
+  other.seek(0);
+  seek(position);
 }
 
 void Prefix::increasePosition() {
-  if (!isFinished()) {
-    position++;
+  if (isFinished()) {
+    return;
+  }
+  position++;
+  if (childIndex < children.size() && children[childIndex].first < position) {
+    childIndex++;
+  }
+  if (++runOffset == runs[runIndex].count) {
+    runIndex++;
+    runOffset = 0;
   }
 }
 
 bool Prefix::isFinished() {
-  return position == eventList.end();
+  return position == instIds.size();
+}
+
+unsigned Prefix::size() {
+  return instIds.size();
+}
+
+unsigned Prefix::getPosition() {
+  return position;
+}
+
+const vector<Prefix::Run> &Prefix::getRuns() {
+  return runs;
+}
+
+// index of the run the next step belongs to
+unsigned Prefix::getCurrentRun() {
+  return runIndex;
+}
+
+const vector<unsigned> &Prefix::getInstIds() {
+  return instIds;
 }
 
-Prefix::EventIterator Prefix::begin() {
-  return eventList.begin();
+const vector<pair<unsigned, uint64_t>> &Prefix::getChildren() {
+  return children;
 }
 
-Prefix::EventIterator Prefix::end() {
-  return eventList.end();
+unsigned Prefix::getBranchInstId() {
+  return branchInstId;
 }
 
-Prefix::EventIterator Prefix::current() {
-  return Prefix::EventIterator(position);
+bool Prefix::getBrCondition() {
+  return brCondition;
 }
 
 uint64_t Prefix::getNextThreadId() {
   assert(!isFinished());
-  Event *event = *position;
-  map<Event *, uint64_t>::iterator ti = threadIdMap.find(event);
-  return ti->second;
+  assert(childIndex < children.size() && children[childIndex].first == position);
+  return children[childIndex].second;
 }
 
 unsigned Prefix::getCurrentEventThreadId() {
   assert(!isFinished());
-  Event *event = *position;
-  return event->threadId;
+  return runs[runIndex].threadId;
+}
+
+unsigned Prefix::getCurrentInstId() {
+  assert(!isFinished());
+  return instIds[position];
 }
 
 void Prefix::print(ostream &out) {
-  for (vector<Event *>::iterator ei = eventList.begin(), ee = eventList.end(); ei != ee; ei++) {
-    Event *event = *ei;
-    out << "thread" << event->threadId << " " << event->inst->info->file << " " << event->inst->info->line << ": "
-        << event->inst->inst->getOpcodeName();
-    map<Event *, uint64_t>::iterator ti = threadIdMap.find(event);
-    if (ti != threadIdMap.end()) {
-      out << "\n child threadId = " << ti->second;
+  unsigned step = 0, child = 0;
+  for (auto &run : runs) {
+    out << "thread" << run.threadId << " steps " << step << "-" << step + run.count - 1 << ":";
+    for (unsigned i = 0; i < run.count; i++) {
+      out << " " << instIds[step + i];
     }
     out << endl;
+    for (; child < children.size() && children[child].first < step + run.count; child++) {
+      out << " step " << children[child].first << " child threadId = " << children[child].second << endl;
+    }
+    step += run.count;
   }
 }
 
 void Prefix::print(raw_ostream &out) {
-  for (vector<Event *>::iterator ei = eventList.begin(), ee = eventList.end(); ei != ee; ei++) {
-    Event *event = *ei;
-    out << "thread" << event->threadId << " " << event->inst->info->file << " " << event->inst->info->line << ": ";
-    event->inst->inst->print(out);
-    map<Event *, uint64_t>::iterator ti = threadIdMap.find(event);
-    if (ti != threadIdMap.end()) {
-      out << "\n child threadId = " << ti->second;
+  unsigned step = 0, child = 0;
+  for (auto &run : runs) {
+    out << "thread" << run.threadId << " steps " << step << "-" << step + run.count - 1 << ":";
+    for (unsigned i = 0; i < run.count; i++) {
+      out << " " << instIds[step + i];
     }
     out << '\n';
+    for (; child < children.size() && children[child].first < step + run.count; child++) {
+      out << " step " << children[child].first << " child threadId = " << children[child].second << '\n';
+    }
+    step += run.count;
   }
 }
 
-KInstruction *Prefix::getCurrentInst() {
-  assert(!isFinished());
-  Event *event = *position;
-  return event->inst;
-}
 std::string Prefix::getName() {
   return name;
 }
 
+void Prefix::setDPOR(uint64_t state, vector<unsigned> &threads, vector<SleepAccess> &sleep) {
+  dporState = state;
+  dporThreads.swap(threads);
+  sleepSet.swap(sleep);
+}
+
+uint64_t Prefix::getDPORState() {
+  return dporState;
+}
+
+const vector<unsigned> &Prefix::getDPORThreads() {
+  return dporThreads;
+}
+
+const vector<Prefix::SleepAccess> &Prefix::getSleepSet() {
+  return sleepSet;
+}
+
+template <typename T> static void writeData(ostream &out, const T *data, uint32_t size) {
+  out.write((const char *)&size, sizeof(size));
+  out.write((const char *)data, size * sizeof(T));
+}
+
+// The size is not trusted, the data is read in chunks so that a corrupt size
+// fails at the end of the stream instead of allocating all of it first.
+template <typename T> static bool readData(istream &in, vector<T> &data) {
+  uint32_t size;
+  if (!in.read((char *)&size, sizeof(size)))
+    return false;
+  data.clear();
+  while (data.size() < size) {
+    size_t offset = data.size();
+    data.resize(offset + std::min<size_t>(size - offset, 4096));
+    if (!in.read((char *)(data.data() + offset), (data.size() - offset) * sizeof(T)))
+      return false;
+  }
+  return true;
+}
+
+// the two fields one by one, a pair has padding
+static void writeChildren(ostream &out, const vector<pair<unsigned, uint64_t>> &children) {
+  uint32_t size = children.size();
+  out.write((const char *)&size, sizeof(size));
+  for (auto &child : children) {
+    uint32_t step = child.first;
+    out.write((const char *)&step, sizeof(step));
+    out.write((const char *)&child.second, sizeof(child.second));
+  }
+}
+
+static bool readChildren(istream &in, vector<pair<unsigned, uint64_t>> &children) {
+  uint32_t size, step;
+  uint64_t threadId;
+  if (!in.read((char *)&size, sizeof(size)))
+    return false;
+  children.clear();
+  for (uint32_t i = 0; i < size; i++) {
+    if (!in.read((char *)&step, sizeof(step)) || !in.read((char *)&threadId, sizeof(threadId)))
+      return false;
+    children.push_back(make_pair(step, threadId));
+  }
+  return true;
+}
+
+void Prefix::write(ostream &out) {
+  writeData(out, name.data(), name.size());
+  writeData(out, runs.data(), runs.size());
+  writeData(out, instIds.data(), instIds.size());
+  writeChildren(out, children);
+  out.write((const char *)&branchInstId, sizeof(branchInstId));
+  uint8_t condition = brCondition;
+  out.write((const char *)&condition, sizeof(condition));
+  out.write((const char *)&dporState, sizeof(dporState));
+  writeData(out, dporThreads.data(), dporThreads.size());
+  writeData(out, sleepSet.data(), sleepSet.size());
+}
+
+Prefix *Prefix::read(istream &in) {
+  vector<char> name;
+  if (!readData(in, name))
+    return NULL;
+  Prefix *prefix = new Prefix(string(name.begin(), name.end()));
+  uint8_t condition;
+  if (!readData(in, prefix->runs) || !readData(in, prefix->instIds) || !readChildren(in, prefix->children) ||
+      !in.read((char *)&prefix->branchInstId, sizeof(prefix->branchInstId)) ||
+      !in.read((char *)&condition, sizeof(condition)) ||
+      !in.read((char *)&prefix->dporState, sizeof(prefix->dporState)) || !readData(in, prefix->dporThreads) ||
+      !readData(in, prefix->sleepSet)) {
+    delete prefix;
+    return NULL;
+  }
+  // the runs must cover the steps exactly
+  uint64_t steps = 0;
+  for (auto &run : prefix->runs) {
+    steps += run.count;
+  }
+  if (steps != prefix->instIds.size() ||
+      (!prefix->children.empty() && prefix->children.back().first >= prefix->instIds.size())) {
+    delete prefix;
+    return NULL;
+  }
+  prefix->brCondition = condition;
+  prefix->seek(0);
+  return prefix;
+}
+
 } /* namespace klee */
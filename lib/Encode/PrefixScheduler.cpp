@@ -0,0 +1,243 @@
+//===-- PrefixScheduler.cpp -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cassert>
+#include <string>
+
+#include "klee/Encode/PrefixScheduler.h"
+
+using namespace ::std;
+
+namespace klee {
+
+PrefixScheduler *getPrefixSchedulerByType(PrefixScheduler::PrefixSchedulerType type, unsigned bound, unsigned seed) {
+  PrefixScheduler *scheduler = NULL;
+  switch (type) {
+    case PrefixScheduler::FIFO: {
+      scheduler = new FIFOPrefixScheduler();
+      break;
+    }
+    case PrefixScheduler::Coverage: {
+      scheduler = new CoveragePrefixScheduler();
+      break;
+    }
+    case PrefixScheduler::Shortest: {
+      scheduler = new ShortestPrefixScheduler();
+      break;
+    }
+    case PrefixScheduler::Bounded: {
+      scheduler = new BoundedPrefixScheduler(bound);
+      break;
+    }
+    case PrefixScheduler::Random: {
+      scheduler = new RandomPrefixScheduler(seed);
+      break;
+    }
+    default: {
+      assert(0 && "PrefixSchedulerType error");
+    }
+  }
+  return scheduler;
+}
+
+PrefixScheduler::PrefixScheduler() {}
+
+PrefixScheduler::~PrefixScheduler() {}
+
+// the names are given by Encode::verifyAssertion and survive the worker pipes
+bool PrefixScheduler::isAssertionPrefix(Prefix *prefix) {
+  return prefix->getName().compare(0, 7, "assert_") == 0;
+}
+
+// the names are given by DPOR::addPrefix
+bool PrefixScheduler::isDPORPrefix(Prefix *prefix) {
+  return prefix->getName().compare(0, 5, "dpor_") == 0;
+}
+
+static void printPrefix(std::ostream &os, unsigned num, Prefix *prefix) {
+  os << "Prefix " << num << endl;
+  prefix->print(os);
+}
+
+FIFOPrefixScheduler::FIFOPrefixScheduler() {}
+
+FIFOPrefixScheduler::~FIFOPrefixScheduler() {}
+
+bool FIFOPrefixScheduler::addItem(Prefix *item) {
+  if (isAssertionPrefix(item)) {
+    assertQueue.push_back(item);
+  } else {
+    queue.push_back(item);
+  }
+  return true;
+}
+
+Prefix *FIFOPrefixScheduler::selectNextItem() {
+  std::deque<Prefix *> &from = assertQueue.empty() ? queue : assertQueue;
+  if (from.empty()) {
+    return NULL;
+  }
+  Prefix *prefix = from.front();
+  from.pop_front();
+  return prefix;
+}
+
+unsigned FIFOPrefixScheduler::itemNum() {
+  return assertQueue.size() + queue.size();
+}
+
+void FIFOPrefixScheduler::clear() {
+  assertQueue.clear();
+  queue.clear();
+}
+
+void FIFOPrefixScheduler::printAllItem(std::ostream &os) {
+  unsigned num = 1;
+  for (auto prefix : assertQueue) {
+    printPrefix(os, num++, prefix);
+  }
+  for (auto prefix : queue) {
+    printPrefix(os, num++, prefix);
+  }
+}
+
+PriorityPrefixScheduler::PriorityPrefixScheduler() : nextOrder(0) {}
+
+PriorityPrefixScheduler::~PriorityPrefixScheduler() {}
+
+bool PriorityPrefixScheduler::addItem(Prefix *item) {
+  Item entry = {isAssertionPrefix(item) ? 0 : getPriority(item) + 1, nextOrder++, item};
+  queue.push(entry);
+  return true;
+}
+
+Prefix *PriorityPrefixScheduler::selectNextItem() {
+  while (!queue.empty()) {
+    Item entry = queue.top();
+    queue.pop();
+    if (entry.priority) {
+      uint64_t priority = getPriority(entry.prefix) + 1;
+      if (priority > entry.priority) {
+        entry.priority = priority;
+        queue.push(entry);
+        continue;
+      }
+    }
+    onSelect(entry.prefix);
+    return entry.prefix;
+  }
+  return NULL;
+}
+
+unsigned PriorityPrefixScheduler::itemNum() {
+  return queue.size();
+}
+
+void PriorityPrefixScheduler::clear() {
+  queue = std::priority_queue<Item>();
+}
+
+void PriorityPrefixScheduler::printAllItem(std::ostream &os) {
+  std::priority_queue<Item> copy = queue;
+  unsigned num = 1;
+  while (!copy.empty()) {
+    printPrefix(os, num++, copy.top().prefix);
+    copy.pop();
+  }
+}
+
+// the last event of a prefix is the branch it flips, the prefix takes the
+// direction opposite to the one recorded in the event
+uint64_t CoveragePrefixScheduler::getTargetBranch(Prefix *prefix) {
+  if (prefix->getInstIds().empty()) {
+    return 0;
+  }
+  return ((uint64_t)prefix->getBranchInstId() + 1) << 1 | !prefix->getBrCondition();
+}
+
+uint64_t CoveragePrefixScheduler::getPriority(Prefix *prefix) {
+  return coveredBranches.count(getTargetBranch(prefix));
+}
+
+void CoveragePrefixScheduler::onSelect(Prefix *prefix) {
+  coveredBranches.insert(getTargetBranch(prefix));
+}
+
+uint64_t ShortestPrefixScheduler::getPriority(Prefix *prefix) {
+  return prefix->size();
+}
+
+BoundedPrefixScheduler::BoundedPrefixScheduler(unsigned bound) : bound(bound) {}
+
+unsigned BoundedPrefixScheduler::getContextSwitches(Prefix *prefix) {
+  unsigned runs = prefix->getRuns().size();
+  return runs ? runs - 1 : 0;
+}
+
+uint64_t BoundedPrefixScheduler::getPriority(Prefix *prefix) {
+  return getContextSwitches(prefix);
+}
+
+bool BoundedPrefixScheduler::addItem(Prefix *item) {
+  if (bound && !isAssertionPrefix(item) && getContextSwitches(item) > bound) {
+    delete item;
+    return false;
+  }
+  return PriorityPrefixScheduler::addItem(item);
+}
+
+RandomPrefixScheduler::RandomPrefixScheduler(unsigned seed) : rng(seed) {}
+
+RandomPrefixScheduler::~RandomPrefixScheduler() {}
+
+bool RandomPrefixScheduler::addItem(Prefix *item) {
+  if (isAssertionPrefix(item)) {
+    assertQueue.push_back(item);
+  } else {
+    pool.push_back(item);
+  }
+  return true;
+}
+
+Prefix *RandomPrefixScheduler::selectNextItem() {
+  if (!assertQueue.empty()) {
+    Prefix *prefix = assertQueue.front();
+    assertQueue.pop_front();
+    return prefix;
+  }
+  if (pool.empty()) {
+    return NULL;
+  }
+  unsigned index = std::uniform_int_distribution<unsigned>(0, pool.size() - 1)(rng);
+  Prefix *prefix = pool[index];
+  pool[index] = pool.back();
+  pool.pop_back();
+  return prefix;
+}
+
+unsigned RandomPrefixScheduler::itemNum() {
+  return assertQueue.size() + pool.size();
+}
+
+void RandomPrefixScheduler::clear() {
+  assertQueue.clear();
+  pool.clear();
+}
+
+void RandomPrefixScheduler::printAllItem(std::ostream &os) {
+  unsigned num = 1;
+  for (auto prefix : assertQueue) {
+    printPrefix(os, num++, prefix);
+  }
+  for (auto prefix : pool) {
+    printPrefix(os, num++, prefix);
+  }
+}
+
+} /* namespace klee */
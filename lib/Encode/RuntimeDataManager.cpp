@@ -9,10 +9,14 @@
 
 #include "klee/Encode/RuntimeDataManager.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
 
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <algorithm>
+#include <cassert>
 #include <fstream>
 #include <iterator>
 #include <map>
@@ -22,12 +26,41 @@
 using namespace std;
 using namespace llvm;
 
+namespace {
+cl::opt<klee::PrefixScheduler::PrefixSchedulerType> KleemPrefixScheduler(
+    "kleem-prefix-scheduler", cl::desc("Order in which the prefixes of the schedule set are replayed:"),
+    cl::values(clEnumValN(klee::PrefixScheduler::FIFO, "fifo", "in the order they are found (default)"),
+               clEnumValN(klee::PrefixScheduler::Coverage, "coverage",
+                          "branch directions no replayed prefix has flipped to first"),
+               clEnumValN(klee::PrefixScheduler::Shortest, "shortest", "fewest events first"),
+               clEnumValN(klee::PrefixScheduler::Bounded, "bounded",
+                          "fewest context switches first, dropping those over -kleem-prefix-bound"),
+               clEnumValN(klee::PrefixScheduler::Random, "random", "uniformly at random")),
+    cl::init(klee::PrefixScheduler::FIFO), cl::cat(klee::KleemCat));
+
+cl::opt<unsigned> KleemPrefixBound("kleem-prefix-bound",
+                                   cl::desc("Context switch bound of the bounded prefix scheduler (default=0, none)"),
+                                   cl::init(0), cl::cat(klee::KleemCat));
+
+cl::opt<unsigned> KleemPrefixSeed("kleem-prefix-seed", cl::desc("Seed of the random prefix scheduler (default=1)"),
+                                  cl::init(1), cl::cat(klee::KleemCat));
+} // namespace
+
 namespace klee {
 
-RuntimeDataManager::RuntimeDataManager() : currentTrace(NULL) {
+RuntimeDataManager::RuntimeDataManager() : traceNum(0), currentTrace(NULL) {
   traceList.reserve(20);
+  scheduleSet = getPrefixSchedulerByType(KleemPrefixScheduler, KleemPrefixBound, KleemPrefixSeed);
+  scheduledPrefixNum = 0;
+  prunedPrefixNum = 0;
+  maxPendingPrefixNum = 0;
+  assertPrefixNum = 0;
+  firstAssertPrefix = 0;
+  firstAssertTime = 0.0;
+  gettimeofday(&startTime, NULL);
 
   allFormulaNum = 0;
+  reusedFormulaNum = 0;
   solvingTimes = 0;
   allGlobal = 0;
   brGlobal = 0;
@@ -52,15 +85,17 @@ RuntimeDataManager::~RuntimeDataManager() {
   for (auto trace : traceList) {
     delete trace;
   }
-  }
+  delete scheduleSet;
+}
 
 std::string RuntimeDataManager::getResultString() {
   stringstream ss;
   ss << "AllFormulaNum:" << allFormulaNum << "\n";
+  ss << "ReusedFormulaNum:" << reusedFormulaNum << "\n";
   ss << "SovingTimes:" << solvingTimes << "\n";
   ss << "TotalNewPath:" << testedTraceList.size() << "\n";
-  ss << "TotalOldPath:" << traceList.size() - testedTraceList.size() << "\n";
-  ss << "TotalPath:" << traceList.size() << "\n";
+  ss << "TotalOldPath:" << traceNum - testedTraceList.size() << "\n";
+  ss << "TotalPath:" << traceNum << "\n";
   if (testedTraceList.size()) {
     ss << "allGlobal:" << allGlobal * 1.0 / testedTraceList.size() << "\n";
     ss << "brGlobal:" << brGlobal * 1.0 / testedTraceList.size() << "\n";
@@ -104,6 +139,17 @@ std::string RuntimeDataManager::getResultString() {
        << "\n";
   }
 
+  ss << "PrefixScheduler:";
+  scheduleSet->printName(ss);
+  ss << "\n";
+  ss << "ScheduledPrefix:" << scheduledPrefixNum << "\n";
+  ss << "PendingPrefix:" << scheduleSet->itemNum() << "\n";
+  ss << "MaxPendingPrefix:" << maxPendingPrefixNum << "\n";
+  ss << "PrunedPrefix:" << prunedPrefixNum << "\n";
+  ss << "AssertPrefix:" << assertPrefixNum << "\n";
+  ss << "FirstAssertPrefix:" << firstAssertPrefix << "\n";
+  ss << "FirstAssertTime:" << firstAssertTime << "\n";
+
   ss << "SolvingCost:" << solvingCost << "\n";
   ss << "RunningCost:" << runningCost << "\n";
 
@@ -156,10 +202,15 @@ unsigned RuntimeDataManager::getTestedPathsNumber() {
   return testedTraceList.size();
 }
 
+unsigned RuntimeDataManager::getPrunedPrefixNumber() {
+  return prunedPrefixNum;
+}
+
 Trace *RuntimeDataManager::createNewTrace(unsigned traceId) {
   currentTrace = new Trace();
   currentTrace->Id = traceId;
   traceList.push_back(currentTrace);
+  traceNum++;
   return currentTrace;
 }
 
@@ -167,28 +218,93 @@ Trace *RuntimeDataManager::getCurrentTrace() {
   return currentTrace;
 }
 
+// Called once the fate of the current trace is decided. Redundant and failed
+// traces are freed, unique ones are compacted to their abstract, which is all
+// the deduplication of later traces needs.
+void RuntimeDataManager::retireCurrentTrace() {
+  if (!currentTrace) {
+    return;
+  }
+  if (currentTrace->traceType == Trace::UNIQUE) {
+    currentTrace->compact();
+    return;
+  }
+  assert(!testedTraceList.count(currentTrace) && "a tested trace must be unique");
+  for (auto ti = traceList.rbegin(), te = traceList.rend(); ti != te; ti++) {
+    if (*ti == currentTrace) {
+      traceList.erase(std::next(ti).base());
+      break;
+    }
+  }
+  delete currentTrace;
+  currentTrace = NULL;
+}
+
+// A reversal is redundant if one of the threads it may run first was already
+// run or scheduled first at its state, by whichever trace.
+bool RuntimeDataManager::addToBacktrackSet(Prefix *prefix) {
+  const std::vector<unsigned> &threads = prefix->getDPORThreads();
+  if (threads.size() < 2) {
+    return true;
+  }
+  std::vector<unsigned> &backtrack = dporBacktrack[prefix->getDPORState()];
+  if (std::find(backtrack.begin(), backtrack.end(), threads[0]) == backtrack.end()) {
+    backtrack.push_back(threads[0]);
+  }
+  for (unsigned i = 1; i < threads.size(); i++) {
+    if (std::find(backtrack.begin(), backtrack.end(), threads[i]) != backtrack.end()) {
+      return false;
+    }
+  }
+  backtrack.push_back(threads[1]);
+  return true;
+}
+
 void RuntimeDataManager::addToScheduleSet(Prefix *prefix) {
-  scheduleSet.push_back(prefix);
+  // races reversed on different traces often lead to the same state
+  if (PrefixScheduler::isDPORPrefix(prefix) && !addToBacktrackSet(prefix)) {
+    delete prefix;
+    prunedPrefixNum++;
+    return;
+  }
+  if (!scheduleSet->addItem(prefix)) {
+    prunedPrefixNum++;
+    return;
+  }
+  maxPendingPrefixNum = std::max(maxPendingPrefixNum, scheduleSet->itemNum());
 }
 
 Prefix *RuntimeDataManager::getNextPrefix() {
-  if (scheduleSet.empty()) {
+  Prefix *prefix = scheduleSet->selectNextItem();
+  if (!prefix) {
     return NULL;
-  } else {
-    Prefix *prefix = scheduleSet.front();
-    scheduleSet.pop_front();
-    return prefix;
   }
+  scheduledPrefixNum++;
+  if (PrefixScheduler::isAssertionPrefix(prefix)) {
+    assertPrefixNum++;
+    if (!firstAssertPrefix) {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      firstAssertPrefix = scheduledPrefixNum;
+      firstAssertTime = (double)(now.tv_sec * 1000000UL + now.tv_usec - startTime.tv_sec * 1000000UL -
+                                 startTime.tv_usec) /
+                        1000000UL;
+    }
+  }
+  return prefix;
 }
 
 void RuntimeDataManager::clearAllPrefix() {
-  scheduleSet.clear();
+  scheduleSet->clear();
 }
 
 bool RuntimeDataManager::isCurrentTraceUntested() {
   bool result = true;
-  for (set<Trace *>::iterator ti = testedTraceList.begin(), te = testedTraceList.end(); ti != te; ti++) {
-    if (currentTrace->isEqual(*ti)) {
+  std::size_t signature = currentTrace->getAbstractSignature();
+  // only traces with the same signature can be equal, compare them in full to rule out hash collisions
+  auto range = testedTraceIndex.equal_range(signature);
+  for (auto ti = range.first; ti != range.second; ti++) {
+    if (currentTrace->isEqual(ti->second)) {
       result = false;
       break;
     }
@@ -196,23 +312,19 @@ bool RuntimeDataManager::isCurrentTraceUntested() {
   currentTrace->isUntested = result;
   if (result) {
     testedTraceList.insert(currentTrace);
+    testedTraceIndex.insert(make_pair(signature, currentTrace));
   }
   return result;
 }
 
 void RuntimeDataManager::printAllPrefix(ostream &out) {
-  out << "num of prefix: " << scheduleSet.size() << endl;
-  unsigned num = 1;
-  for (list<Prefix *>::iterator pi = scheduleSet.begin(), pe = scheduleSet.end(); pi != pe; pi++) {
-    out << "Prefix " << num << endl;
-    (*pi)->print(out);
-    num++;
-  }
+  out << "num of prefix: " << scheduleSet->itemNum() << endl;
+  scheduleSet->printAllItem(out);
 }
 
 void RuntimeDataManager::printAllTrace(ostream &out) {
   out << "\nTrace Info:\n";
-  out << "num of trace: " << traceList.size() << endl << endl;
+  out << "num of trace: " << traceNum << endl << endl;
   unsigned num = 1;
   for (vector<Trace *>::iterator ti = traceList.begin(), te = traceList.end(); ti != te; ti++) {
     Trace *trace = *ti;
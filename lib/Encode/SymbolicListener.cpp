@@ -47,29 +47,7 @@ SymbolicListener::~SymbolicListener() {}
 
 //消息响应函数，在被测程序解释执行之前调用
 void SymbolicListener::beforeRunMethodAsMain(ExecutionState &initialState) {
-
-  //收集assert
-  auto i = executor->kmodule->functions.begin(), e = executor->kmodule->functions.end();
-  for (; i != e; ++i) {
-    KInstruction **instructions = (*i)->instructions;
-    for (unsigned j = 0; j < (*i)->numInstructions; j++) {
-      KInstruction *ki = instructions[j];
-      Instruction *inst = ki->inst;
-      //			instructions[j]->inst->dump();
-      if (inst->getOpcode() == Instruction::Call) {
-        CallSite cs(inst);
-        Value *fp = cs.getCalledValue();
-        Function *f = executor->getTargetFunction(fp, initialState);
-        if (f && f->getName().str() == "__assert_fail") {
-          string fileName = ki->info->file;
-          unsigned line = ki->info->line;
-          assertMap[fileName].push_back(line);
-          //						printf("fileName : %s, line : %d\n",fileName.c_str(),line);
-          //						llvm::errs() << "call name : " << f->getName().str() << "\n";
-        }
-      }
-    }
-  }
+  // the assertion branches are marked once by KModule::markAssertBranches
 }
 
 void SymbolicListener::beforeExecuteInstruction(ExecutionState &state, KInstruction *ki) {
@@ -118,15 +96,7 @@ void SymbolicListener::beforeExecuteInstruction(ExecutionState &state, KInstruct
     case Instruction::Br: {
       BranchInst *bi = dyn_cast<BranchInst>(inst);
       if (!bi->isUnconditional()) {
-        unsigned isAssert = 0;
-        string fileName = ki->info->file;
-        std::map<string, std::vector<unsigned>>::iterator it = assertMap.find(fileName);
-        unsigned line = ki->info->line;
-        if (it != assertMap.end()) {
-          if (find(assertMap[fileName].begin(), assertMap[fileName].end(), line) != assertMap[fileName].end()) {
-            isAssert = 1;
-          }
-        }
+        bool isAssert = ki->isAssertBranch;
         ref<Expr> value1 = executor->eval(ki, 0, state).value;
         if (value1->getKind() != Expr::Constant) {
           Expr::Width width = value1->getWidth();
@@ -355,9 +325,7 @@ void SymbolicListener::afterExecuteInstruction(ExecutionState &state, KInstructi
 }
 
 //消息响应函数，在被测程序解释执行之后调用
-void SymbolicListener::afterRunMethodAsMain(ExecutionState &state) {
-  assertMap.clear();
-}
+void SymbolicListener::afterRunMethodAsMain(ExecutionState &state) {}
 
 //消息相应函数，在前缀执行出错之后程序推出之前调用
 void SymbolicListener::executionFailed(ExecutionState &state, KInstruction *ki) {}
@@ -253,9 +253,7 @@ void TaintListener::afterExecuteInstruction(ExecutionState &state, KInstruction
           isFloat = 1;
         }
         if (currentEvent->isGlobal) {
-          for (unsigned i = 0; i < thread->vectorClock.size(); i++) {
-            currentEvent->vectorClock.push_back(thread->vectorClock[i]);
-          }
+          currentEvent->vectorClock = thread->vectorClock;
 #if SUPPORT_PTR
           if (isFloat || id == Type::IntegerTyID || id == Type::PointerTyID) {
 #else
@@ -292,10 +290,7 @@ void TaintListener::afterExecuteInstruction(ExecutionState &state, KInstruction
       }
       case Instruction::Store: {
         if (currentEvent->isGlobal) {
-          for (unsigned i = 0; i < thread->vectorClock.size(); i++) {
-            currentEvent->vectorClock.push_back(thread->vectorClock[i]);
-            // llvm::errs() << "vectorClock " << i << " : " << currentEvent->vectorClock[i] << "\n";
-          }
+          currentEvent->vectorClock = thread->vectorClock;
         }
         break;
       }
@@ -331,19 +326,19 @@ void TaintListener::afterExecuteInstruction(ExecutionState &state, KInstruction
           trace->initTaintSymbolicExpr.insert(currentEvent->globalName);
 
         } else if (f->getName() == "pthread_create") {
-          thread->vectorClock[thread->threadId]++;
+          thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_join") {
-          thread->vectorClock[thread->threadId]++;
+          thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_cond_wait") {
-          thread->vectorClock[thread->threadId]++;
+          thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_cond_signal") {
-          thread->vectorClock[thread->threadId]++;
+          thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_cond_broadcast") {
-          thread->vectorClock[thread->threadId]++;
+          thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_mutex_lock") {
-          //				thread->vectorClock[thread->threadId]++;
+          //				thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_mutex_unlock") {
-          //				thread->vectorClock[thread->threadId]++;
+          //				thread->vectorClock.tick(thread->threadId);
         } else if (f->getName().str() == "pthread_barrier_wait") {
           assert(0 && "Unsupported pthread function");
         }
@@ -7,6 +7,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
 #include "klee/Encode/Trace.h"
@@ -29,22 +31,73 @@ using namespace llvm;
 
 namespace klee {
 
-Trace::Trace() : Id(0), nextEventId(0), eventList(20), isUntested(true) {}
+// a trace counts as failed until its execution has succeeded
+Trace::Trace() : Id(0), nextEventId(0), eventList(20), isUntested(true), traceType(FAILED) {}
 
-Trace::~Trace() {
-  for (auto li : all_lock_unlock) {
-    for (auto ei : li.second) {
-      delete ei;
-    }
-  }
-  for (auto wi : all_wait) {
-    for (auto ei : wi.second) {
-      delete ei;
-    }
-  }
-  for (auto event : path) {
-    delete event;
-  }
+Trace::~Trace() {}
+
+template <typename T> static void release(T &container) {
+  T().swap(container);
+}
+
+// Unique traces stay for the deduplication of later traces, which only needs
+// the abstract. Prefixes do not refer to events, so nothing else is kept.
+void Trace::compact() {
+  if (abstract.empty()) {
+    createAbstract();
+  }
+  release(eventList);
+  ss.str(std::string());
+  release(path);
+  release(storeSymbolicExpr);
+  release(taintExpr);
+  release(rwSymbolicExpr);
+  release(brSymbolicExpr);
+  release(assertSymbolicExpr);
+  release(pathCondition);
+  release(pathConditionRelatedToBranch);
+  release(brRelatedSymbolicExpr);
+  release(assertRelatedSymbolicExpr);
+  release(RelatedSymbolicExpr);
+  release(allRelatedSymbolicExprs);
+  release(varThread);
+  release(rwEvent);
+  release(brEvent);
+  release(assertEvent);
+  release(Send_Data_Expr);
+  release(initTaintSymbolicExpr);
+  release(taintSymbolicExpr);
+  release(unTaintSymbolicExpr);
+  release(potentialTaint);
+  release(DTAMSerial);
+  release(DTAMParallel);
+  release(DTAMhybrid);
+  release(PTS);
+  release(taintPTS);
+  release(noTaintPTS);
+  release(taintMap);
+  release(DTAMSerialMap);
+  release(DTAMParallelMap);
+  release(DTAMhybridMap);
+  release(createThreadPoint);
+  release(joinThreadPoint);
+  release(allReadSet);
+  release(allWriteSet);
+  release(readSet);
+  release(writeSet);
+  release(readSetRelatedToBranch);
+  release(writeSetRelatedToBranch);
+  release(all_lock_unlock);
+  release(all_wait);
+  release(all_signal);
+  release(all_barrier);
+  release(global_variable_initializer);
+  release(global_variable_initializer_RelatedToBranch);
+  release(global_variable_final);
+  release(printf_variable_value);
+  events.clear();
+  lockPairs.clear();
+  waitLocks.clear();
 }
 
 void Trace::printDetailedInfo(raw_ostream &out) {
@@ -102,14 +155,14 @@ void Trace::printWaitAndSignal(raw_ostream &out) {
 
 void Trace::printReadSetAndWriteSet(raw_ostream &out) {
   out << "< Global Read Events >\n";
-  for (map<string, vector<Event *>>::iterator ri = readSet.begin(), re = readSet.end(); ri != re; ri++) {
+  for (unordered_map<string, vector<Event *>>::iterator ri = readSet.begin(), re = readSet.end(); ri != re; ri++) {
     out << ri->first << " is readed at: " << "\n";
     for (vector<Event *>::iterator vi = ri->second.begin(), ve = ri->second.end(); vi != ve; vi++) {
       out << (*vi)->toString();
     }
   }
   out << "\n< Global Write Events>\n";
-  for (map<string, vector<Event *>>::iterator wi = writeSet.begin(), we = writeSet.end(); wi != we; wi++) {
+  for (unordered_map<string, vector<Event *>>::iterator wi = writeSet.begin(), we = writeSet.end(); wi != we; wi++) {
     out << wi->first << " is writed at: \n";
     for (vector<Event *>::iterator vi = wi->second.begin(), ve = wi->second.end(); vi != ve; vi++) {
       out << (*vi)->toString();
@@ -119,8 +172,8 @@ void Trace::printReadSetAndWriteSet(raw_ostream &out) {
 
 void Trace::printLockAndUnlock(raw_ostream &out) {
   out << "< Lock-Unlock Event Pairs>\n";
-  for (map<string, vector<LockPair *>>::iterator li = all_lock_unlock.begin(), le = all_lock_unlock.end(); li != le;
-       li++) {
+  for (unordered_map<string, vector<LockPair *>>::iterator li = all_lock_unlock.begin(), le = all_lock_unlock.end();
+       li != le; li++) {
     out << "Mutex:" << li->first << ":\n";
     for (vector<LockPair *>::iterator lpi = li->second.begin(), lpe = li->second.end(); lpi != lpe; lpi++) {
       out << "lock at " << (*lpi)->lockEvent->toString() << "\n";
@@ -189,23 +242,19 @@ void Trace::insertEvent(Event *event, unsigned threadId) {
 
 Event *Trace::createEvent(unsigned threadId, KInstruction *inst, uint64_t address, bool isLoad, int time,
                           Event::EventType eventType) {
-  ss.str("");
-  ss << 'G';
-  ss << address;
-  string globalVarName = ss.str();
-  if (isLoad) {
-    ss << 'L';
-  } else {
-    ss << 'S';
-  }
-  ss << time;
-  string globalVarFullName = ss.str();
-  return new Event(threadId, nextEventId, "E" + Transfer::uint64toString(nextEventId++), inst, globalVarName,
-                   globalVarFullName, eventType);
+  // built by appending, this runs for every global access of the trace
+  string globalVarName = "G" + std::to_string(address);
+  string globalVarFullName = globalVarName;
+  globalVarFullName += isLoad ? 'L' : 'S';
+  globalVarFullName += std::to_string(time);
+  unsigned eventId = nextEventId++;
+  return events.create(threadId, eventId, "E" + std::to_string(eventId), inst, globalVarName, globalVarFullName,
+                       eventType);
 }
 
 Event *Trace::createEvent(unsigned threadId, KInstruction *inst, Event::EventType eventType) {
-  return new Event(threadId, nextEventId, "E" + Transfer::uint64toString(nextEventId++), inst, "", "", eventType);
+  unsigned eventId = nextEventId++;
+  return events.create(threadId, eventId, "E" + std::to_string(eventId), inst, "", "", eventType);
 }
 
 void Trace::insertThreadCreateOrJoin(pair<Event *, uint64_t> item, bool isThreadCreate) {
@@ -217,7 +266,7 @@ void Trace::insertThreadCreateOrJoin(pair<Event *, uint64_t> item, bool isThread
 }
 
 void Trace::insertReadSet(string name, Event *item) {
-  map<string, vector<Event *>>::iterator mi = readSet.find(name);
+  unordered_map<string, vector<Event *>>::iterator mi = readSet.find(name);
   if (mi != readSet.end()) {
     mi->second.push_back(item);
   } else {
@@ -228,7 +277,7 @@ void Trace::insertReadSet(string name, Event *item) {
 }
 
 void Trace::insertWriteSet(string name, Event *item) {
-  map<string, vector<Event *>>::iterator mi = writeSet.find(name);
+  unordered_map<string, vector<Event *>>::iterator mi = writeSet.find(name);
   if (mi != writeSet.end()) {
     mi->second.push_back(item);
   } else {
@@ -239,7 +288,7 @@ void Trace::insertWriteSet(string name, Event *item) {
 }
 
 void Trace::insertWait(string condName, Event *wait, Event *associatedLock) {
-  Wait_Lock *wl = new Wait_Lock();
+  Wait_Lock *wl = waitLocks.create();
   wl->wait = wait;
   wl->lock_by_wait = associatedLock;
   map<string, vector<Wait_Lock *>>::iterator mi = all_wait.find(condName);
@@ -264,10 +313,10 @@ void Trace::insertSignal(string condName, Event *event) {
 }
 
 void Trace::insertLockOrUnlock(unsigned threadId, string mutex, Event *event, bool isLock) {
-  map<string, vector<LockPair *>>::iterator li = all_lock_unlock.find(mutex);
+  unordered_map<string, vector<LockPair *>>::iterator li = all_lock_unlock.find(mutex);
   if (li != all_lock_unlock.end()) {
     if (isLock) {
-      LockPair *lp = new LockPair();
+      LockPair *lp = lockPairs.create();
       lp->mutex = mutex;
       lp->lockEvent = event;
       lp->unlockEvent = NULL;
@@ -293,7 +342,7 @@ void Trace::insertLockOrUnlock(unsigned threadId, string mutex, Event *event, bo
   } else {
     if (isLock) {
       vector<LockPair *> lpVector;
-      LockPair *lp = new LockPair();
+      LockPair *lp = lockPairs.create();
       lp->mutex = mutex;
       lp->lockEvent = event;
       lp->unlockEvent = NULL;
@@ -392,24 +441,34 @@ bool Trace::isEqual(Trace *trace) {
   return same;
 }
 
-std::string Trace::getAssemblyLine(std::string name) {
-  std::stringstream varName;
-  std::stringstream AssemblyLineName;
-  varName.str("");
-  unsigned int i = 0;
-  while ((name.at(i) != 'S') && (name.at(i) != 'L')) {
-    varName << name.at(i);
-    i++;
+std::size_t Trace::getAbstractSignature() {
+  if (this->abstract.empty()) {
+    this->createAbstract();
   }
+  // the abstracts are compared as a multiset in isEqual, so sort them before hashing
+  vector<string> sortedAbstract(this->abstract);
+  std::sort(sortedAbstract.begin(), sortedAbstract.end());
+  std::hash<string> hasher;
+  std::size_t signature = sortedAbstract.size();
+  for (auto &threadAbstract : sortedAbstract) {
+    signature ^= hasher(threadAbstract) + 0x9e3779b9 + (signature << 6) + (signature >> 2);
+  }
+  return signature;
+}
+
+std::string Trace::getAssemblyLine(std::string name) {
+  std::string::size_type i = name.find_first_of("SL");
+  assert(i != std::string::npos && "global name without S/L");
+  std::string varName = name.substr(0, i);
   //	std::cerr << "getAssemblyLine name : " << name << "\n";
-  std::map<std::string, std::vector<Event *>>::iterator all;
+  std::unordered_map<std::string, std::vector<Event *>>::iterator all;
   if (name.at(i) == 'S') {
-    all = allWriteSet.find(varName.str());
+    all = allWriteSet.find(varName);
     if (all == allWriteSet.end()) {
       assert(0 && "allWriteSet getAssemblyLine can not find");
     }
   } else {
-    all = allReadSet.find(varName.str());
+    all = allReadSet.find(varName);
     if (all == allReadSet.end()) {
       assert(0 && "allReadSet getAssemblyLine can not find");
     }
@@ -426,22 +485,18 @@ std::string Trace::getAssemblyLine(std::string name) {
 }
 
 std::string Trace::getLine(std::string name) {
-  std::stringstream varName;
-  varName.str("");
-  unsigned int i = 0;
-  while ((name.at(i) != 'S') && (name.at(i) != 'L')) {
-    varName << name.at(i);
-    i++;
-  }
+  std::string::size_type i = name.find_first_of("SL");
+  assert(i != std::string::npos && "global name without S/L");
+  std::string varName = name.substr(0, i);
   //	std::cerr << "getLine name : " << name << "\n";
-  std::map<std::string, std::vector<Event *>>::iterator all;
+  std::unordered_map<std::string, std::vector<Event *>>::iterator all;
   if (name.at(i) == 'S') {
-    all = allWriteSet.find(varName.str());
+    all = allWriteSet.find(varName);
     if (all == allWriteSet.end()) {
       assert(0 && "allWriteSet getLine can not find");
     }
   } else {
-    all = allReadSet.find(varName.str());
+    all = allReadSet.find(varName);
     if (all == allReadSet.end()) {
       assert(0 && "allReadSet getLine can not find");
     }
@@ -456,23 +511,19 @@ std::string Trace::getLine(std::string name) {
 }
 
 Event *Trace::getEvent(std::string name) {
-  std::stringstream varName;
-  varName.str("");
-  unsigned int i = 0;
-  while ((name.at(i) != 'S') && (name.at(i) != 'L')) {
-    varName << name.at(i);
-    i++;
-  }
+  std::string::size_type i = name.find_first_of("SL");
+  assert(i != std::string::npos && "global name without S/L");
+  std::string varName = name.substr(0, i);
 
   //	std::cerr << "getEvent name : " << name << "\n";
-  std::map<std::string, std::vector<Event *>>::iterator all;
+  std::unordered_map<std::string, std::vector<Event *>>::iterator all;
   if (name.at(i) == 'S') {
-    all = allWriteSet.find(varName.str());
+    all = allWriteSet.find(varName);
     if (all == allWriteSet.end()) {
       assert(0 && "allWriteSet getEvent can not find");
     }
   } else {
-    all = allReadSet.find(varName.str());
+    all = allReadSet.find(varName);
     if (all == allReadSet.end()) {
       assert(0 && "allReadSet getEvent can not find");
     }
@@ -0,0 +1,325 @@
+//===-- TraceLog.cpp --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "klee/Encode/Trace.h"
+#include "klee/Encode/TraceLog.h"
+#include "klee/Module/InstructionInfoTable.h"
+
+namespace klee {
+
+TraceLogWriter::TraceLogWriter() : fd(-1), recordStart(0) {}
+
+TraceLogWriter::~TraceLogWriter() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+bool TraceLogWriter::open(const std::string &path) {
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size == 0) {
+    uint32_t magic = TraceLog::magic;
+    if (::write(fd, &magic, sizeof(magic)) != sizeof(magic)) {
+      ::close(fd);
+      fd = -1;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TraceLogWriter::isOpen() {
+  return fd >= 0;
+}
+
+void TraceLogWriter::put(uint8_t value) {
+  buffer.append((const char *)&value, sizeof(value));
+}
+
+void TraceLogWriter::put(uint32_t value) {
+  buffer.append((const char *)&value, sizeof(value));
+}
+
+void TraceLogWriter::put(uint64_t value) {
+  buffer.append((const char *)&value, sizeof(value));
+}
+
+void TraceLogWriter::put(const std::string &value) {
+  put((uint32_t)value.size());
+  buffer.append(value);
+}
+
+void TraceLogWriter::beginRecord(TraceLog::RecordKind kind) {
+  recordStart = buffer.size();
+  put((uint32_t)kind);
+  // the size is filled in by endRecord
+  put((uint32_t)0);
+}
+
+void TraceLogWriter::endRecord() {
+  uint32_t size = buffer.size() - recordStart - 2 * sizeof(uint32_t);
+  memcpy(&buffer[recordStart + sizeof(uint32_t)], &size, sizeof(size));
+  buffer.append((4 - buffer.size() % 4) % 4, '\0');
+}
+
+static uint32_t getEventId(Event *event) {
+  return event ? event->eventId : TraceLog::none;
+}
+
+void TraceLogWriter::write(Trace *trace) {
+  if (fd < 0) {
+    return;
+  }
+  buffer.clear();
+  beginRecord(TraceLog::TraceBegin);
+  // the size of the trace is filled in once it is known
+  put((uint32_t)0);
+  put((uint32_t)trace->Id);
+  put((uint8_t)trace->traceType);
+  put((uint32_t)trace->eventList.size());
+  put((uint32_t)trace->path.size());
+  endRecord();
+
+  for (auto event : trace->path) {
+    beginRecord(TraceLog::EventRecord);
+    put((uint32_t)event->eventId);
+    put((uint32_t)event->threadId);
+    put((uint32_t)event->threadEventId);
+    put((uint32_t)event->orderId);
+    put((uint32_t)(event->inst ? event->inst->info->id : TraceLog::none));
+    put((uint8_t)event->eventType);
+    put((uint8_t)event->isGlobal);
+    put((uint8_t)event->isConditionInst);
+    put((uint8_t)event->brCondition);
+    put(event->eventName);
+    put(event->name);
+    put(event->globalName);
+    endRecord();
+  }
+
+  // the filter of the encoder keeps the whole sets in allReadSet and allWriteSet
+  const std::unordered_map<std::string, std::vector<Event *>> &reads =
+      trace->allReadSet.empty() ? trace->readSet : trace->allReadSet;
+  const std::unordered_map<std::string, std::vector<Event *>> &writes =
+      trace->allWriteSet.empty() ? trace->writeSet : trace->allWriteSet;
+  for (auto &read : reads) {
+    beginRecord(TraceLog::ReadSet);
+    put(read.first);
+    put((uint32_t)read.second.size());
+    for (auto event : read.second) {
+      put(getEventId(event));
+    }
+    endRecord();
+  }
+  for (auto &write : writes) {
+    beginRecord(TraceLog::WriteSet);
+    put(write.first);
+    put((uint32_t)write.second.size());
+    for (auto event : write.second) {
+      put(getEventId(event));
+    }
+    endRecord();
+  }
+
+  for (auto &mutex : trace->all_lock_unlock) {
+    for (auto lockPair : mutex.second) {
+      beginRecord(TraceLog::LockPair);
+      put(lockPair->mutex);
+      put((uint32_t)lockPair->threadId);
+      put(getEventId(lockPair->lockEvent));
+      put(getEventId(lockPair->unlockEvent));
+      endRecord();
+    }
+  }
+
+  for (auto &create : trace->createThreadPoint) {
+    beginRecord(TraceLog::ThreadCreate);
+    put(getEventId(create.first));
+    put((uint64_t)create.second);
+    endRecord();
+  }
+  for (auto &join : trace->joinThreadPoint) {
+    beginRecord(TraceLog::ThreadJoin);
+    put(getEventId(join.first));
+    put((uint64_t)join.second);
+    endRecord();
+  }
+
+  beginRecord(TraceLog::TraceEnd);
+  endRecord();
+  uint32_t traceSize = buffer.size();
+  memcpy(&buffer[2 * sizeof(uint32_t)], &traceSize, sizeof(traceSize));
+
+  // A single write with O_APPEND is not interleaved with those of the other
+  // processes. The rest of a short write is not retried, since another trace
+  // may already follow it, and the reader skips the damaged trace.
+  ssize_t written;
+  do {
+    written = ::write(fd, buffer.data(), buffer.size());
+  } while (written < 0 && errno == EINTR);
+  if (written != (ssize_t)buffer.size()) {
+    // a log that cannot be written is given up, the run goes on
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool TraceLogReader::Cursor::read(uint8_t &value) {
+  if (end - pos < (std::ptrdiff_t)sizeof(value))
+    return false;
+  memcpy(&value, pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+bool TraceLogReader::Cursor::read(uint32_t &value) {
+  if (end - pos < (std::ptrdiff_t)sizeof(value))
+    return false;
+  memcpy(&value, pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+bool TraceLogReader::Cursor::read(uint64_t &value) {
+  if (end - pos < (std::ptrdiff_t)sizeof(value))
+    return false;
+  memcpy(&value, pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+bool TraceLogReader::Cursor::read(llvm::StringRef &value) {
+  uint32_t length;
+  if (!read(length) || (std::size_t)(end - pos) < length)
+    return false;
+  value = llvm::StringRef(pos, length);
+  pos += length;
+  return true;
+}
+
+TraceLogReader::TraceLogReader() : data(NULL), size(0), offset(0), traceEnd(0) {}
+
+TraceLogReader::~TraceLogReader() {
+  close();
+}
+
+bool TraceLogReader::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(uint32_t)) {
+    ::close(fd);
+    return false;
+  }
+  void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid without the descriptor
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  data = (const char *)mapping;
+  size = st.st_size;
+  uint32_t magic;
+  memcpy(&magic, data, sizeof(magic));
+  if (magic != TraceLog::magic) {
+    close();
+    return false;
+  }
+  rewind();
+  return true;
+}
+
+void TraceLogReader::close() {
+  if (data) {
+    munmap((void *)data, size);
+  }
+  data = NULL;
+  size = 0;
+  offset = 0;
+  traceEnd = 0;
+}
+
+// A whole trace starts with a TraceBegin record that holds its size, and that
+// size ends right after an empty TraceEnd record.
+std::size_t TraceLogReader::getTraceSize(std::size_t start) {
+  uint32_t header[3];
+  if (size - start < sizeof(header)) {
+    return 0;
+  }
+  memcpy(header, data + start, sizeof(header));
+  uint32_t traceSize = header[2];
+  if (header[0] != TraceLog::TraceBegin || traceSize % 4 || traceSize < 2 * sizeof(header) ||
+      size - start < traceSize) {
+    return 0;
+  }
+  uint32_t end[2];
+  memcpy(end, data + start + traceSize - sizeof(end), sizeof(end));
+  if (end[0] != TraceLog::TraceEnd || end[1] != 0) {
+    return 0;
+  }
+  return traceSize;
+}
+
+bool TraceLogReader::next(Record &record) {
+  if (!data) {
+    return false;
+  }
+  uint32_t header[2];
+  if (offset == traceEnd || traceEnd - offset < sizeof(header)) {
+    // look for the next whole trace past the damaged ones, a short write
+    // leaves the next trace at any offset
+    offset = traceEnd;
+    std::size_t traceSize = 0;
+    while (offset < size && !(traceSize = getTraceSize(offset))) {
+      offset++;
+    }
+    if (!traceSize) {
+      offset = traceEnd = size;
+      return false;
+    }
+    traceEnd = offset + traceSize;
+  }
+  memcpy(header, data + offset, sizeof(header));
+  if (traceEnd - offset - sizeof(header) < header[1]) {
+    // a record that overruns its trace, the rest of the trace is skipped
+    offset = traceEnd;
+    return next(record);
+  }
+  record.kind = (TraceLog::RecordKind)header[0];
+  record.data = data + offset + sizeof(header);
+  record.size = header[1];
+  offset += sizeof(header) + header[1];
+  // the records are padded from the start of their trace, which is 4 bytes
+  // from its end
+  offset += (traceEnd - offset) % 4;
+  if (offset > traceEnd) {
+    offset = traceEnd;
+  }
+  return true;
+}
+
+void TraceLogReader::rewind() {
+  offset = traceEnd = sizeof(uint32_t);
+}
+
+} /* namespace klee */
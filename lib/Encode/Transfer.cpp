@@ -21,9 +21,7 @@ namespace klee {
 std::stringstream Transfer::ss;
 
 string Transfer::uint64toString(uint64_t input) {
-  ss.str("");
-  ss << input;
-  return ss.str();
+  return std::to_string(input);
 }
 
 // 将ConstantExpr转换为对应的Constant类型
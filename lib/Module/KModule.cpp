@@ -351,6 +351,8 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
       escapingFunctions.insert(declaration);
   }
 
+  markAssertBranches();
+
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
     llvm::errs() << "KLEE: escaping functions: [";
     std::string delimiter = "";
@@ -362,6 +364,40 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
   }
 }
 
+/// The branches of an assertion are the conditional branches on the source
+/// line of a call to __assert_fail.
+void KModule::markAssertBranches() {
+  std::set<std::pair<std::string, unsigned>> assertLines;
+  for (auto &kf : functions) {
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      if (!isa<CallInst>(ki->inst))
+        continue;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(8, 0)
+      const CallBase &cs = cast<CallBase>(*ki->inst);
+      Value *val = cs.getCalledOperand();
+#else
+      const CallSite cs(ki->inst);
+      Value *val = cs.getCalledValue();
+#endif
+      Function *f = dyn_cast<Function>(val->stripPointerCasts());
+      if (f && f->getName() == "__assert_fail")
+        assertLines.insert(std::make_pair(ki->info->file, ki->info->line));
+    }
+  }
+  if (assertLines.empty())
+    return;
+  for (auto &kf : functions) {
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      BranchInst *bi = dyn_cast<BranchInst>(ki->inst);
+      if (bi && bi->isConditional() &&
+          assertLines.count(std::make_pair(ki->info->file, ki->info->line)))
+        ki->isAssertBranch = true;
+    }
+  }
+}
+
 void KModule::checkModule() {
   InstructionOperandTypeCheckPass *operandTypeCheckPass =
       new InstructionOperandTypeCheckPass();
@@ -11,6 +11,8 @@
 
 #include <iostream>
 
+#include "klee/Encode/Transfer.h"
+
 using namespace ::std;
 
 namespace klee {
@@ -21,69 +23,56 @@ BarrierManager::~BarrierManager() {
   clear();
 }
 
-bool BarrierManager::addBarrier(string barrierName, string &errorMsg) {
-  map<string, Barrier *>::iterator bi = barrierPool.find(barrierName);
-  if (bi != barrierPool.end()) {
-    errorMsg = "redefinition of barrier " + barrierName;
+bool BarrierManager::addBarrier(uint64_t address, string &errorMsg) {
+  if (getBarrier(address)) {
+    errorMsg = "redefinition of barrier " + Transfer::uint64toString(address);
     return false;
   } else {
-    Barrier *barrier = new Barrier(barrierName, Barrier::DEFAULTCOUNT);
-    barrierPool.insert(make_pair(barrierName, barrier));
+    getOrAddBarrier(address);
     return true;
   }
 }
 
-Barrier *BarrierManager::getBarrier(string barrierName) {
-  map<string, Barrier *>::iterator bi = barrierPool.find(barrierName);
-  if (bi != barrierPool.end()) {
-    return bi->second;
-  } else {
-    return NULL;
-  }
+Barrier *BarrierManager::getBarrier(uint64_t address) {
+  return barrierPool.find(address);
 }
 
-bool BarrierManager::init(string barrierName, unsigned count, string &errorMsg) {
-  Barrier *barrier = getBarrier(barrierName);
-  if (barrier == NULL) {
-    errorMsg = "barrier " + barrierName + " undefined";
-    return false;
-  } else {
-    barrier->setCount(count);
-    return true;
+Barrier *BarrierManager::getOrAddBarrier(uint64_t address) {
+  Barrier *barrier = barrierPool.find(address);
+  if (!barrier) {
+    barrier = new Barrier(Transfer::uint64toString(address), Barrier::DEFAULTCOUNT);
+    barrierPool.insert(address, barrier);
   }
+  return barrier;
 }
 
-bool BarrierManager::wait(std::string barrierName, unsigned threadId, bool &isReleased, vector<unsigned> &blockedList,
+bool BarrierManager::init(uint64_t address, unsigned count, string &errorMsg) {
+  getOrAddBarrier(address)->setCount(count);
+  return true;
+}
+
+bool BarrierManager::wait(uint64_t address, unsigned threadId, bool &isReleased, vector<unsigned> &blockedList,
                           std::string &errorMsg) {
-  Barrier *barrier = getBarrier(barrierName);
-  if (barrier == NULL) {
-    errorMsg = "barrier " + barrierName + " undefined";
-    return false;
+  Barrier *barrier = getOrAddBarrier(address);
+  barrier->wait(threadId);
+  if (barrier->isFull()) {
+    isReleased = true;
+    blockedList = barrier->getBlockedList();
+    barrier->reset();
   } else {
-    barrier->wait(threadId);
-    if (barrier->isFull()) {
-      isReleased = true;
-      blockedList = barrier->getBlockedList();
-      barrier->reset();
-    } else {
-      isReleased = false;
-    }
-    return true;
+    isReleased = false;
   }
+  return true;
 }
 
 void BarrierManager::clear() {
-  for (map<string, Barrier *>::iterator bi = barrierPool.begin(), be = barrierPool.end(); bi != be; bi++) {
-    delete bi->second;
-  }
+  barrierPool.forEach([](uint64_t address, Barrier *barrier) { delete barrier; });
   barrierPool.clear();
 }
 
 void BarrierManager::print(ostream &out) {
   out << "barrier pool\n";
-  for (map<string, Barrier *>::iterator bi = barrierPool.begin(), be = barrierPool.end(); bi != be; bi++) {
-    out << bi->first << endl;
-  }
+  barrierPool.forEach([&](uint64_t address, Barrier *barrier) { out << barrier->name << endl; });
 }
 
 } // namespace klee
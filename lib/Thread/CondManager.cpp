@@ -22,106 +22,94 @@ using namespace ::std;
 
 namespace klee {
 
-bool CondManager::wait(string condName, string mutexName, unsigned threadId, string &errorMsg) {
-  Mutex *mutex = mutexManager->getMutex(mutexName);
-  if (mutex == NULL) {
-    errorMsg = "mutex " + mutexName + " undefined";
-    return false;
-  }
-  Condition *cond = getCondition(condName);
-  if (cond == NULL) {
-    errorMsg = "condition " + condName + " undefined";
-    return false;
-  }
+bool CondManager::wait(uint64_t condAddress, uint64_t mutexAddress, unsigned threadId, string &errorMsg) {
+  Mutex *mutex = mutexManager->getOrAddMutex(mutexAddress);
+  Condition *cond = getOrAddCondition(condAddress);
   if (!mutex->isThreadOwnMutex(threadId)) {
-    errorMsg = Transfer::uint64toString(threadId) + " does not own mutex " + mutexName;
+    errorMsg = Transfer::uint64toString(threadId) + " does not own mutex " + mutex->name;
     return false;
   } else {
-    WaitParam *wp = new WaitParam(mutexName, threadId);
+    WaitParam *wp = new WaitParam(mutexAddress, threadId);
     cond->wait(wp);
-    return mutexManager->unlock(mutexName, errorMsg);
+    return mutexManager->unlock(mutex, errorMsg);
   }
 }
 
-bool CondManager::signal(string condName, unsigned &releasedThreadId, string &errorMsg) {
-  Condition *cond = getCondition(condName);
-  if (cond == NULL) {
-    errorMsg = "condition " + condName + " undefined";
-    return false;
+bool CondManager::signal(uint64_t condAddress, unsigned &releasedThreadId, string &errorMsg) {
+  Condition *cond = getOrAddCondition(condAddress);
+  WaitParam *wp = cond->signal();
+  if (wp != NULL) {
+    releasedThreadId = wp->threadId;
+    // change state
+    mutexManager->addBlockedThread(wp->threadId, wp->mutexAddress);
+    delete wp;
   } else {
-    WaitParam *wp = cond->signal();
-    if (wp != NULL) {
-      releasedThreadId = wp->threadId;
-      // change state
-      mutexManager->addBlockedThread(wp->threadId, wp->mutexName);
-      delete wp;
-    } else {
-      releasedThreadId = 0;
-    }
-    return true;
+    releasedThreadId = 0;
   }
+  return true;
 }
 
-bool CondManager::broadcast(string condName, vector<unsigned> &threads, string &errorMsg) {
-  Condition *cond = getCondition(condName);
-  if (cond == NULL) {
-    errorMsg = "condition " + condName + " undefined";
-    return false;
-  } else {
-    vector<WaitParam *> itemList;
-    cond->broadcast(itemList);
-    threads.resize(itemList.size());
-    vector<unsigned>::iterator ti = threads.begin();
-    for (vector<WaitParam *>::iterator wi = itemList.begin(), we = itemList.end(); wi != we; wi++, ti++) {
-      WaitParam *wp = *wi;
-      *ti = wp->threadId;
-      mutexManager->addBlockedThread(wp->threadId, wp->mutexName);
-      delete wp;
-    }
-    return true;
+bool CondManager::broadcast(uint64_t condAddress, vector<unsigned> &threads, string &errorMsg) {
+  Condition *cond = getOrAddCondition(condAddress);
+  vector<WaitParam *> itemList;
+  cond->broadcast(itemList);
+  threads.resize(itemList.size());
+  vector<unsigned>::iterator ti = threads.begin();
+  for (vector<WaitParam *>::iterator wi = itemList.begin(), we = itemList.end(); wi != we; wi++, ti++) {
+    WaitParam *wp = *wi;
+    *ti = wp->threadId;
+    mutexManager->addBlockedThread(wp->threadId, wp->mutexAddress);
+    delete wp;
   }
+  return true;
 }
 
-bool CondManager::addCondition(string condName, string &errorMsg) {
-  Condition *cond = getCondition(condName);
-  if (cond) {
-    errorMsg = "redefinition of condition " + condName;
+bool CondManager::addCondition(uint64_t condAddress, string &errorMsg) {
+  if (getCondition(condAddress)) {
+    errorMsg = "redefinition of condition " + Transfer::uint64toString(condAddress);
     return false;
   } else {
-    cond = new Condition(nextConditionId++, condName, CondScheduler::FIFS);
-    pair<string, Condition *> item(condName, cond);
-    condPool.insert(item);
+    Condition *cond = new Condition(nextConditionId++, Transfer::uint64toString(condAddress), CondScheduler::FIFS);
+    condPool.insert(condAddress, cond);
     return true;
   }
 }
 
-bool CondManager::addCondition(string condName, string &errorMsg, Prefix *prefix) {
-  Condition *cond = getCondition(condName);
-  if (cond) {
-    errorMsg = "redefinition of condition " + condName;
+bool CondManager::addCondition(uint64_t condAddress, string &errorMsg, Prefix *prefix) {
+  if (getCondition(condAddress)) {
+    errorMsg = "redefinition of condition " + Transfer::uint64toString(condAddress);
     return false;
   } else {
-    cond = new Condition(nextConditionId++, condName, CondScheduler::FIFS, prefix);
-    pair<string, Condition *> item(condName, cond);
-    condPool.insert(item);
+    Condition *cond =
+        new Condition(nextConditionId++, Transfer::uint64toString(condAddress), CondScheduler::FIFS, prefix);
+    condPool.insert(condAddress, cond);
     return true;
   }
 }
 
-Condition *CondManager::getCondition(string condName) {
-  map<string, Condition *>::iterator ci = condPool.find(condName);
-  if (ci == condPool.end()) {
-    return NULL;
-  } else {
-    return ci->second;
+Condition *CondManager::getCondition(uint64_t condAddress) {
+  return condPool.find(condAddress);
+}
+
+Condition *CondManager::getOrAddCondition(uint64_t condAddress) {
+  Condition *cond = condPool.find(condAddress);
+  if (!cond) {
+    std::string errorMsg;
+    if (prefix) {
+      addCondition(condAddress, errorMsg, prefix);
+    } else {
+      addCondition(condAddress, errorMsg);
+    }
+    cond = condPool.find(condAddress);
   }
+  return cond;
 }
 
-CondManager::CondManager() : nextConditionId(1) {
+CondManager::CondManager() : prefix(NULL), nextConditionId(1) {
   this->mutexManager = NULL;
 }
 
-CondManager::CondManager(MutexManager *_mutexManaget) : nextConditionId(1) {
+CondManager::CondManager(MutexManager *_mutexManaget) : prefix(NULL), nextConditionId(1) {
   this->mutexManager = _mutexManaget;
 }
 
@@ -130,18 +118,14 @@ CondManager::~CondManager() {
 }
 
 void CondManager::clear() {
-  for (map<string, Condition *>::iterator ci = condPool.begin(), ce = condPool.end(); ci != ce; ci++) {
-    delete ci->second;
-  }
+  condPool.forEach([](uint64_t address, Condition *cond) { delete cond; });
   condPool.clear();
   nextConditionId = 1;
 }
 
 void CondManager::print(ostream &out) {
   out << "condition pool\n";
-  for (map<string, Condition *>::iterator ci = condPool.begin(), ce = condPool.end(); ci != ce; ci++) {
-    out << ci->first << endl;
-  }
+  condPool.forEach([&](uint64_t address, Condition *cond) { out << cond->name << endl; });
 }
 
 unsigned CondManager::getNextConditionId() {
@@ -179,8 +179,9 @@ WaitParam *GuidedCondScheduler::selectNextItem() {
     unsigned lastThreadId = 0;
     unsigned threadId = 0;
     WaitParam *result = NULL;
-    for (Prefix::EventIterator ei = prefix->current(), ee = prefix->end(); ei != ee; ei++) {
-      threadId = (*ei)->threadId;
+    const std::vector<Prefix::Run> &runs = prefix->getRuns();
+    for (unsigned ri = prefix->getCurrentRun(), re = runs.size(); ri != re; ri++) {
+      threadId = runs[ri].threadId;
       if (threadId == lastThreadId) {
         continue;
       } else {
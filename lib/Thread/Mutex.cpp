@@ -9,6 +9,8 @@
 
 #include "klee/Thread/Mutex.h"
 
+#include <algorithm>
+
 using namespace ::std;
 
 namespace klee {
@@ -34,6 +36,32 @@ bool Mutex::isThreadOwnMutex(unsigned threadId) {
     return false;
   }
 }
+void Mutex::addWaitingThread(unsigned threadId) {
+  if (!isThreadWaiting(threadId)) {
+    waitingThreads.push_back(threadId);
+  }
+}
+
+void Mutex::removeWaitingThread(unsigned threadId) {
+  std::deque<unsigned>::iterator wi = std::find(waitingThreads.begin(), waitingThreads.end(), threadId);
+  if (wi != waitingThreads.end()) {
+    waitingThreads.erase(wi);
+  }
+}
+
+bool Mutex::isThreadWaiting(unsigned threadId) {
+  return std::find(waitingThreads.begin(), waitingThreads.end(), threadId) != waitingThreads.end();
+}
+
+unsigned Mutex::popWaitingThread() {
+  if (waitingThreads.empty()) {
+    return 0;
+  }
+  unsigned threadId = waitingThreads.front();
+  waitingThreads.pop_front();
+  return threadId;
+}
+
 // void Mutex::addToBlockedList(Thread* thread) {
 //	blockedList.push_front(thread);
 //}
@@ -18,20 +18,14 @@ MutexManager::MutexManager() : nextMutexId(1) {}
 
 MutexManager::~MutexManager() { clear(); }
 
-bool MutexManager::lock(string mutexName, unsigned threadId, bool &isBlocked, string &errorMsg) {
-  Mutex *mutex = getMutex(mutexName);
-  if (!mutex) {
-    errorMsg = "mutex " + mutexName + " undefined";
-    return false;
-  } else {
-    return lock(mutex, threadId, isBlocked, errorMsg);
-  }
+bool MutexManager::lock(uint64_t address, unsigned threadId, bool &isBlocked, string &errorMsg) {
+  return lock(getOrAddMutex(address), threadId, isBlocked, errorMsg);
 }
 
 bool MutexManager::lock(Mutex *mutex, unsigned threadId, bool &isBlocked, string &errorMsg) {
   if (mutex->isMutexLocked()) {
-    // mutex->addToBlockedList(thread);
     blockedThreadPool.insert(make_pair(threadId, mutex));
+    mutex->addWaitingThread(threadId);
     isBlocked = true;
   } else {
     mutex->lock(threadId);
@@ -39,20 +33,15 @@ bool MutexManager::lock(Mutex *mutex, unsigned threadId, bool &isBlocked, string
     map<unsigned, Mutex *>::iterator ti = blockedThreadPool.find(threadId);
     if (ti != blockedThreadPool.end()) {
       blockedThreadPool.erase(ti);
-      // mutex->removeFromBlockedList(thread);
+      // a prefix may pick a waiting thread before the mutex wakes it
+      mutex->removeWaitingThread(threadId);
     }
   }
   return true;
 }
 
-bool MutexManager::unlock(string mutexName, string &errorMsg) {
-  Mutex *mutex = getMutex(mutexName);
-  if (!mutex) {
-    errorMsg = "mutex " + mutexName + " undefined";
-    return false;
-  } else {
-    return unlock(mutex, errorMsg);
-  }
+bool MutexManager::unlock(uint64_t address, string &errorMsg) {
+  return unlock(getOrAddMutex(address), errorMsg);
 }
 
 bool MutexManager::unlock(Mutex *mutex, string &errorMsg) {
@@ -64,53 +53,55 @@ bool MutexManager::unlock(Mutex *mutex, string &errorMsg) {
     return true;
   } else {
     mutex->unlock();
+    unsigned threadId = mutex->popWaitingThread();
+    if (threadId) {
+      wokenThreads.push_back(threadId);
+    }
     return true;
   }
 }
 
-bool MutexManager::addMutex(string mutexName, string &errorMsg) {
-  Mutex *mutex = getMutex(mutexName);
-  if (mutex) {
-    errorMsg = "redefinition of mutex " + mutexName;
+bool MutexManager::addMutex(uint64_t address, string &errorMsg) {
+  if (getMutex(address)) {
+    errorMsg = "redefinition of mutex " + Transfer::uint64toString(address);
     return false;
   } else {
-    mutex = new Mutex(nextMutexId++, mutexName);
-    mutexPool.insert(make_pair(mutexName, mutex));
+    getOrAddMutex(address);
     return true;
   }
 }
 
-Mutex *MutexManager::getMutex(string mutexName) {
-  map<string, Mutex *>::iterator mi = mutexPool.find(mutexName);
-  if (mi == mutexPool.end()) {
-    return NULL;
-  } else {
-    return mi->second;
+Mutex *MutexManager::getMutex(uint64_t address) {
+  return mutexPool.find(address);
+}
+
+// the name is the decimal address, it only shows up in messages
+Mutex *MutexManager::getOrAddMutex(uint64_t address) {
+  Mutex *mutex = mutexPool.find(address);
+  if (!mutex) {
+    mutex = new Mutex(nextMutexId++, Transfer::uint64toString(address));
+    mutexPool.insert(address, mutex);
   }
+  return mutex;
 }
 
 void MutexManager::clear() {
-  for (map<string, Mutex *>::iterator mi = mutexPool.begin(), me = mutexPool.end(); mi != me; mi++) {
-    delete mi->second;
-  }
+  mutexPool.forEach([](uint64_t address, Mutex *mutex) { delete mutex; });
   mutexPool.clear();
   blockedThreadPool.clear();
+  wokenThreads.clear();
   nextMutexId = 1;
 }
 
 void MutexManager::print(ostream &out) {
   out << "mutex pool\n";
-  for (map<string, Mutex *>::iterator mi = mutexPool.begin(), me = mutexPool.end(); mi != me; mi++) {
-    out << mi->first << endl;
-  }
+  mutexPool.forEach([&](uint64_t address, Mutex *mutex) { out << mutex->name << endl; });
 }
 
 unsigned MutexManager::getNextMutexId() { return nextMutexId; }
 
-void MutexManager::addBlockedThread(unsigned threadId, std::string mutexName) {
-  Mutex *mutex = getMutex(mutexName);
-  assert(mutex);
-  blockedThreadPool.insert(make_pair(threadId, mutex));
+void MutexManager::addBlockedThread(unsigned threadId, uint64_t address) {
+  blockedThreadPool.insert(make_pair(threadId, getOrAddMutex(address)));
 }
 
 bool MutexManager::tryToLockForBlockedThread(unsigned threadId, bool &isBlocked, string &errorMsg) {
@@ -124,4 +115,19 @@ bool MutexManager::tryToLockForBlockedThread(unsigned threadId, bool &isBlocked,
   }
 }
 
+bool MutexManager::isThreadWaiting(unsigned threadId) {
+  Mutex *mutex = getBlockingMutex(threadId);
+  return mutex && mutex->isThreadWaiting(threadId);
+}
+
+Mutex *MutexManager::getBlockingMutex(unsigned threadId) {
+  map<unsigned, Mutex *>::iterator mi = blockedThreadPool.find(threadId);
+  return mi == blockedThreadPool.end() ? NULL : mi->second;
+}
+
+void MutexManager::takeWokenThreads(vector<unsigned> &threads) {
+  threads.clear();
+  threads.swap(wokenThreads);
+}
+
 } // namespace klee
@@ -14,9 +14,6 @@ namespace klee {
 Thread::Thread(unsigned threadId, Thread *parentThread, KFunction *kf, AddressSpace *addressSpace)
     : pc(kf->instructions), prevPC(pc), incomingBBIndex(0), threadId(threadId), parentThread(parentThread),
       threadState(Thread::RUNNABLE), addressSpace(addressSpace) {
-  for (unsigned i = 0; i < 17; i++) {
-    vectorClock.push_back(0);
-  }
   stack = new StackType(addressSpace);
   stack->realStack.reserve(10);
   stack->pushFrame(0, kf);
@@ -27,9 +24,6 @@ Thread::Thread(Thread &anotherThread, AddressSpace *addressSpace)
       threadId(anotherThread.threadId), parentThread(anotherThread.parentThread),
       threadState(anotherThread.threadState), addressSpace(addressSpace) {
   stack = new StackType(addressSpace, anotherThread.stack);
-  for (unsigned i = 0; i < 17; i++) {
-    vectorClock.push_back(0);
-  }
 }
 
 Thread::~Thread() {
@@ -0,0 +1,310 @@
+#include "klee/Encode/DPOR.h"
+#include "klee/Encode/Prefix.h"
+#include "klee/Encode/RuntimeDataManager.h"
+#include "klee/Encode/Trace.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+const std::string file = "test.c";
+
+// Every operation of a thread has its own instruction. A run of the program
+// follows the steps of a prefix, then keeps the last thread running while it
+// can and otherwise takes the first thread that can run.
+class DPORTest : public ::testing::Test {
+protected:
+  enum Kind { Read, Write, Lock, Unlock };
+  struct Operation {
+    Kind kind;
+    std::string object;
+    KInstruction *inst;
+  };
+
+  RuntimeDataManager data;
+  std::vector<std::vector<Operation>> threads; // by thread id, from 1
+  std::vector<std::unique_ptr<InstructionInfo>> infos;
+  std::vector<std::unique_ptr<KInstruction>> insts;
+  unsigned traceNum = 0;
+  unsigned raceNum = 0;
+  unsigned reversedNum = 0;
+  std::set<std::string> runs;    // the order of the operations of every run
+  std::set<std::set<std::pair<unsigned, unsigned>>> classes; // the order of the dependent operations
+
+  void add(unsigned threadId, Kind kind, const std::string &object) {
+    infos.emplace_back(new InstructionInfo(infos.size() + 1, file, 0, 0, 0));
+    insts.emplace_back(new KInstruction());
+    insts.back()->info = infos.back().get();
+    insts.back()->operands = NULL;
+    if (threads.size() <= threadId) {
+      threads.resize(threadId + 1);
+    }
+    Operation operation = {kind, object, insts.back().get()};
+    threads[threadId].push_back(operation);
+  }
+
+  void addCounter(unsigned threadId, bool isLocked) {
+    if (isLocked) {
+      add(threadId, Lock, "m");
+    }
+    add(threadId, Read, "count");
+    add(threadId, Write, "count");
+    if (isLocked) {
+      add(threadId, Unlock, "m");
+    }
+  }
+
+  // Appends an event of the given thread to the path, steps is the number of
+  // events each thread ran so far
+  void step(Trace *trace, unsigned threadId, std::vector<unsigned> &steps, std::string &order) {
+    Operation &operation = threads[threadId][steps[threadId]++];
+    Event *event = trace->createEvent(threadId, operation.inst, Event::NORMAL);
+    trace->insertPath(event);
+    switch (operation.kind) {
+      case Read: {
+        trace->insertReadSet(operation.object, event);
+        break;
+      }
+      case Write: {
+        trace->insertWriteSet(operation.object, event);
+        break;
+      }
+      default: {
+        trace->insertLockOrUnlock(threadId, operation.object, event, operation.kind == Lock);
+        break;
+      }
+    }
+    order += std::to_string(operation.inst->info->id) + " ";
+  }
+
+  bool isEnabled(unsigned threadId, std::vector<unsigned> &steps, std::set<std::string> &held) {
+    if (steps[threadId] == threads[threadId].size()) {
+      return false;
+    }
+    Operation &operation = threads[threadId][steps[threadId]];
+    return operation.kind != Lock || !held.count(operation.object);
+  }
+
+  // Runs with the same dependent operations in the same order are
+  // equivalent, operations depend if one of the two writes their object
+  std::set<std::pair<unsigned, unsigned>> getClass(Trace *trace) {
+    std::vector<Operation *> operations;
+    std::vector<unsigned> steps(threads.size(), 0);
+    for (auto event : trace->path) {
+      operations.push_back(&threads[event->threadId][steps[event->threadId]++]);
+    }
+    std::set<std::pair<unsigned, unsigned>> order;
+    for (unsigned i = 0; i < operations.size(); i++) {
+      for (unsigned j = i + 1; j < operations.size(); j++) {
+        if (operations[i]->object == operations[j]->object &&
+            (operations[i]->kind != Read || operations[j]->kind != Read)) {
+          order.insert(std::make_pair(operations[i]->inst->info->id, operations[j]->inst->info->id));
+        }
+      }
+    }
+    return order;
+  }
+
+  Trace *run(Prefix *prefix) {
+    Trace *trace = data.createNewTrace(++traceNum);
+    std::vector<unsigned> steps(threads.size(), 0);
+    std::set<std::string> held;
+    std::string order;
+    unsigned current = 1;
+    auto take = [&](unsigned threadId) {
+      Operation &operation = threads[threadId][steps[threadId]];
+      if (operation.kind == Lock) {
+        held.insert(operation.object);
+      } else if (operation.kind == Unlock) {
+        held.erase(operation.object);
+      }
+      step(trace, threadId, steps, order);
+      current = threadId;
+    };
+    if (prefix) {
+      unsigned position = 0;
+      for (auto &run : prefix->getRuns()) {
+        for (unsigned i = 0; i < run.count; i++, position++) {
+          EXPECT_TRUE(isEnabled(run.threadId, steps, held));
+          EXPECT_EQ(prefix->getInstIds()[position], threads[run.threadId][steps[run.threadId]].inst->info->id);
+          take(run.threadId);
+        }
+      }
+    }
+    while (true) {
+      unsigned next = current;
+      for (unsigned threadId = 1; !isEnabled(next, steps, held) && threadId < threads.size(); threadId++) {
+        next = threadId;
+      }
+      if (!isEnabled(next, steps, held)) {
+        break;
+      }
+      take(next);
+    }
+    EXPECT_TRUE(runs.insert(order).second) << "run twice: " << order;
+    classes.insert(getClass(trace));
+
+    DPOR dpor(&data);
+    dpor.addRacePrefixes(prefix);
+    raceNum += dpor.getRaceNumber();
+    return trace;
+  }
+
+  void explore() {
+    run(NULL);
+    while (Prefix *prefix = data.getNextPrefix()) {
+      reversedNum++;
+      run(prefix);
+      delete prefix;
+    }
+  }
+
+  // runs the events of the given threads in that order
+  Trace *runPath(std::vector<unsigned> order, Prefix *prefix) {
+    Trace *trace = data.createNewTrace(++traceNum);
+    std::vector<unsigned> steps(threads.size(), 0);
+    std::string path;
+    for (auto threadId : order) {
+      step(trace, threadId, steps, path);
+    }
+    DPOR dpor(&data);
+    dpor.addRacePrefixes(prefix);
+    raceNum += dpor.getRaceNumber();
+    return trace;
+  }
+
+  std::vector<Prefix *> takePrefixes() {
+    std::vector<Prefix *> prefixes;
+    while (Prefix *prefix = data.getNextPrefix()) {
+      prefixes.push_back(prefix);
+    }
+    return prefixes;
+  }
+};
+
+// one thread writes x, two read it
+TEST_F(DPORTest, WriteAndTwoReads) {
+  add(1, Write, "x");
+  add(2, Read, "x");
+  add(3, Read, "x");
+
+  runPath({1, 2, 3}, NULL);
+  EXPECT_EQ(2u, raceNum);
+  std::vector<Prefix *> prefixes = takePrefixes();
+  ASSERT_EQ(2u, prefixes.size());
+  Prefix *third = NULL;
+  for (auto prefix : prefixes) {
+    ASSERT_EQ(2u, prefix->getDPORThreads().size());
+    EXPECT_EQ(1u, prefix->getDPORThreads()[0]);
+    if (prefix->getDPORThreads()[1] == 3) {
+      third = prefix;
+    }
+  }
+  ASSERT_TRUE(third);
+  // the read of the second thread commutes with the one of the third
+  ASSERT_EQ(1u, third->getSleepSet().size());
+  EXPECT_EQ(2u, third->getSleepSet()[0].threadId);
+
+  // the read of the third thread first leaves the race of the write and the
+  // other read, which the first reversal explores already
+  runPath({3, 1, 2}, third);
+  EXPECT_EQ(3u, raceNum);
+  EXPECT_TRUE(takePrefixes().empty());
+  EXPECT_EQ(0u, data.getPrunedPrefixNumber());
+
+  for (auto prefix : prefixes) {
+    delete prefix;
+  }
+}
+
+TEST_F(DPORTest, BacktrackSetAcrossTraces) {
+  add(1, Write, "x");
+  add(2, Read, "x");
+  add(3, Read, "x");
+
+  runPath({1, 2, 3}, NULL);
+  for (auto prefix : takePrefixes()) {
+    delete prefix;
+  }
+
+  // without the sleep set the state before the read of the third thread
+  // still has the third thread in its backtrack set
+  runPath({3, 1, 2}, NULL);
+  EXPECT_EQ(1u, data.getPrunedPrefixNumber());
+  std::vector<Prefix *> prefixes = takePrefixes();
+  ASSERT_EQ(1u, prefixes.size());
+  EXPECT_EQ(1u, prefixes[0]->getDPORThreads()[0]);
+  EXPECT_EQ(2u, prefixes[0]->getDPORThreads()[1]);
+  delete prefixes[0];
+}
+
+TEST_F(DPORTest, LockedCounter) {
+  addCounter(1, true);
+  addCounter(2, true);
+
+  explore();
+  // only the order of the critical sections
+  EXPECT_EQ(2u, runs.size());
+  EXPECT_EQ(2u, classes.size());
+  EXPECT_EQ(1u, raceNum);
+  EXPECT_EQ(1u, reversedNum);
+  EXPECT_EQ(0u, data.getPrunedPrefixNumber());
+}
+
+TEST_F(DPORTest, UnlockedCounter) {
+  addCounter(1, false);
+  addCounter(2, false);
+
+  explore();
+  // the two reads commute, the other pairs of events do not
+  EXPECT_EQ(4u, runs.size());
+  EXPECT_EQ(4u, classes.size());
+  EXPECT_EQ(4u, raceNum);
+  EXPECT_EQ(3u, reversedNum);
+  // after the prefix that puts the write of the second thread first, the
+  // write of the first thread races with the read of the second one again,
+  // the backtrack set knows that order from the first run
+  EXPECT_EQ(1u, data.getPrunedPrefixNumber());
+}
+
+// The critical sections of the first and the third thread only race once a
+// prefix moved the one of the second thread away.
+TEST_F(DPORTest, LockedCounterOfThreeThreads) {
+  addCounter(1, true);
+  addCounter(2, true);
+  addCounter(3, true);
+
+  explore();
+  EXPECT_EQ(6u, runs.size());
+  EXPECT_EQ(6u, classes.size());
+  EXPECT_EQ(7u, raceNum);
+  EXPECT_EQ(5u, reversedNum);
+  EXPECT_EQ(2u, data.getPrunedPrefixNumber());
+}
+
+TEST_F(DPORTest, UnlockedCounterOfThreeThreads) {
+  addCounter(1, false);
+  addCounter(2, false);
+  addCounter(3, false);
+
+  explore();
+  // every class is explored, but the races reversed before the end of a
+  // prefix have no sleep set, so some of them more than once
+  EXPECT_EQ(36u, classes.size());
+  EXPECT_EQ(84u, runs.size());
+  EXPECT_EQ(155u, raceNum);
+  EXPECT_EQ(83u, reversedNum);
+  EXPECT_EQ(72u, data.getPrunedPrefixNumber());
+}
+
+} // namespace
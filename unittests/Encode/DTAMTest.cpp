@@ -0,0 +1,195 @@
+#include "klee/Encode/DTAM.h"
+#include "klee/Encode/Event.h"
+#include "klee/Encode/RuntimeDataManager.h"
+#include "klee/Encode/Trace.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+const std::string file = "test.c";
+
+class DTAMTest : public ::testing::Test {
+protected:
+  RuntimeDataManager data;
+  Trace *trace;
+  unsigned traceNum = 0;
+  unsigned accessNum = 0;
+  ArrayCache cache;
+  InstructionInfo info{1, file, 0, 0, 0};
+  std::unique_ptr<KInstruction> inst;
+
+  void SetUp() override {
+    inst.reset(new KInstruction());
+    inst->info = &info;
+    trace = data.createNewTrace(++traceNum);
+  }
+
+  void TearDown() override {
+    setThreads(1);
+  }
+
+  void setThreads(unsigned threadNum) {
+    llvm::cl::Option *option = llvm::cl::getRegisteredOptions()["kleem-dtam-threads"];
+    ASSERT_TRUE(option);
+    static_cast<llvm::cl::opt<unsigned> *>(option)->setValue(threadNum);
+  }
+
+  // a global access to var at the given clock, a write is computed from the
+  // reads in related
+  Event *add(unsigned threadId, const std::string &var, bool isWrite, const std::vector<unsigned> &clock,
+             const std::vector<Event *> &related = {}) {
+    Event *event = trace->createEvent(threadId, inst.get(), Event::NORMAL);
+    event->name = var;
+    event->globalName = var + (isWrite ? "S" : "L") + std::to_string(++accessNum);
+    for (unsigned tid = 0; tid < clock.size(); tid++) {
+      for (unsigned i = 0; i < clock[tid]; i++) {
+        event->vectorClock.tick(tid);
+      }
+    }
+    for (auto read : related) {
+      const Array *array = cache.CreateArray(read->globalName, 1);
+      event->relatedSymbolicExpr.push_back(
+          ReadExpr::create(UpdateList(array, 0), ConstantExpr::create(0, Expr::Int32)));
+    }
+    if (isWrite) {
+      trace->allWriteSet[var].push_back(event);
+    } else {
+      trace->allReadSet[var].push_back(event);
+    }
+    return event;
+  }
+
+  // the taint as the DTAMPoint graph spread it before: a read taints the
+  // writes computed from it, a write the reads of its variable; the hybrid
+  // graph leaves out the reads that happen before the write
+  std::set<std::string> propagateAsBefore(bool isHybrid) {
+    std::map<std::string, std::vector<std::string>> affecting;
+    for (auto &var : trace->allWriteSet) {
+      for (auto write : var.second) {
+        for (auto &related : write->relatedSymbolicExpr) {
+          affecting[FilterSymbolicExpr::getGlobalName(related)].push_back(write->globalName);
+        }
+        for (auto read : trace->allReadSet[write->name]) {
+          if (!isHybrid || !write->vectorClock.dominates(read->vectorClock)) {
+            affecting[write->globalName].push_back(read->globalName);
+          }
+        }
+      }
+    }
+    std::set<std::string> taint;
+    std::vector<std::string> remain;
+    for (auto *all : {&trace->allReadSet, &trace->allWriteSet}) {
+      for (auto &var : *all) {
+        for (auto event : var.second) {
+          if (trace->DTAMSerial.count(event->globalName) && taint.insert(event->globalName).second) {
+            remain.push_back(event->globalName);
+          }
+        }
+      }
+    }
+    while (!remain.empty()) {
+      std::string name = remain.back();
+      remain.pop_back();
+      for (auto &affected : affecting[name]) {
+        if (taint.insert(affected).second) {
+          remain.push_back(affected);
+        }
+      }
+    }
+    return taint;
+  }
+
+  // every variable is read and written a few times by four threads at
+  // random clocks, a write is computed from up to two random reads
+  void addRandomAccesses(unsigned seed, unsigned varNum, unsigned taintNum) {
+    std::mt19937 random(seed);
+    std::vector<Event *> reads;
+    std::vector<Event *> events;
+    auto randomClock = [&]() {
+      std::vector<unsigned> clock;
+      for (unsigned tid = 0; tid < 4; tid++) {
+        clock.push_back(random() % 4);
+      }
+      return clock;
+    };
+    for (unsigned v = 0; v < varNum; v++) {
+      for (unsigned i = 0, n = 1 + random() % 3; i < n; i++) {
+        reads.push_back(add(random() % 4, "v" + std::to_string(v), false, randomClock()));
+        events.push_back(reads.back());
+      }
+    }
+    for (unsigned v = 0; v < varNum; v++) {
+      for (unsigned i = 0, n = 1 + random() % 3; i < n; i++) {
+        std::vector<Event *> related;
+        for (unsigned k = 0, m = random() % 3; k < m; k++) {
+          related.push_back(reads[random() % reads.size()]);
+        }
+        events.push_back(add(random() % 4, "v" + std::to_string(v), true, randomClock(), related));
+      }
+    }
+    for (unsigned i = 0; i < taintNum; i++) {
+      trace->DTAMSerial.insert(events[random() % events.size()]->globalName);
+    }
+  }
+};
+
+// Thread 0 reads x and computes y from it after thread 1 read y. Thread 1
+// computes z from its first read of y and w from its second one.
+TEST_F(DTAMTest, PropagateAsBefore) {
+  Event *readX = add(0, "x", false, {1, 0});
+  Event *firstReadY = add(1, "y", false, {0, 1});
+  add(0, "y", true, {2, 1}, {readX});
+  add(1, "z", true, {0, 2}, {firstReadY});
+  Event *secondReadY = add(1, "y", false, {2, 3});
+  add(1, "w", true, {2, 4}, {secondReadY});
+  trace->DTAMSerial.insert(readX->globalName);
+
+  std::set<std::string> parallel = propagateAsBefore(false);
+  std::set<std::string> hybrid = propagateAsBefore(true);
+  DTAM dtam(&data);
+  dtam.work();
+  EXPECT_EQ(parallel, trace->DTAMParallel);
+  EXPECT_EQ(hybrid, trace->DTAMhybrid);
+  EXPECT_EQ((std::set<std::string>{"xL1", "yL2", "yS3", "zS4", "yL5", "wS6"}), trace->DTAMParallel);
+  // the write of y cannot reach the read before it
+  EXPECT_EQ((std::set<std::string>{"xL1", "yS3", "yL5", "wS6"}), trace->DTAMhybrid);
+}
+
+// The first frontier has more than 4 * 1024 nodes, so with four threads it
+// is split among them.
+TEST_F(DTAMTest, PropagateInParallelAsBefore) {
+  for (unsigned threadNum : {1, 4}) {
+    SCOPED_TRACE(threadNum);
+    setThreads(threadNum);
+    trace = data.createNewTrace(++traceNum);
+    addRandomAccesses(5, 6000, 5000);
+    ASSERT_LT(4096u, trace->DTAMSerial.size());
+
+    std::set<std::string> parallel = propagateAsBefore(false);
+    std::set<std::string> hybrid = propagateAsBefore(true);
+    DTAM dtam(&data);
+    dtam.work();
+    EXPECT_EQ(parallel, trace->DTAMParallel);
+    EXPECT_EQ(hybrid, trace->DTAMhybrid);
+    EXPECT_LT(hybrid.size(), parallel.size());
+    EXPECT_LT(trace->DTAMSerial.size(), hybrid.size());
+  }
+}
+
+} // namespace
@@ -0,0 +1,306 @@
+#include "klee/Encode/Encode.h"
+#include "klee/Encode/IncrementalSolver.h"
+#include "klee/Encode/RuntimeDataManager.h"
+#include "klee/Encode/Trace.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace klee {
+
+// Builds a trace by hand and runs the private passes of Encode on it.
+class EncodeTest : public ::testing::Test {
+protected:
+  RuntimeDataManager data;
+  IncrementalSolver incrementalSolver;
+  std::unique_ptr<Encode> encode;
+  Trace *trace;
+
+  void SetUp() override {
+    trace = data.createNewTrace(1);
+    encode.reset(new Encode(&data, NULL, &incrementalSolver));
+  }
+
+  void TearDown() override {
+    encode.reset();
+  }
+
+  z3::context &ctx() {
+    return encode->z3_ctx;
+  }
+
+  Event *addEvent(unsigned threadId) {
+    Event *event = trace->createEvent(threadId, NULL, Event::NORMAL);
+    trace->insertEvent(event, threadId);
+    return event;
+  }
+
+  z3::expr getOrderExpr(Event *event) {
+    return encode->getOrderExpr(event);
+  }
+
+  // the order of the events of a thread, as buildMemoryModelFormula gives it
+  void addMemoryModel(z3::solver &s) {
+    for (auto &thread : trace->eventList) {
+      for (unsigned i = 1; i < thread.size(); i++) {
+        if (thread[i - 1]->orderId != thread[i]->orderId) {
+          s.add(getOrderExpr(thread[i - 1]) < getOrderExpr(thread[i]));
+        }
+      }
+    }
+  }
+
+  void computeMustHappenBefore() {
+    encode->computeMustHappenBefore();
+  }
+
+  bool mustHappenBefore(Event *first, Event *second) {
+    return encode->mustHappenBefore(first, second);
+  }
+
+  bool pruneMayBeRead(Event *read, std::vector<Event *> &mayBeRead) {
+    return encode->pruneMayBeRead(read, mayBeRead);
+  }
+
+  // calls f with every order of the events that keeps program order, runs a
+  // thread after the event creating it and a join after the joined thread
+  void forEachSchedule(std::function<void(std::vector<Event *> &)> f) {
+    std::vector<unsigned> next(trace->eventList.size(), 0);
+    std::vector<Event *> schedule;
+    std::set<Event *> done;
+    std::map<unsigned, Event *> creator;
+    for (auto &create : trace->createThreadPoint) {
+      creator[create.second] = create.first;
+    }
+    std::function<void()> extend = [&]() {
+      bool isEnd = true;
+      for (unsigned tid = 0; tid < trace->eventList.size(); tid++) {
+        std::vector<Event *> &thread = trace->eventList[tid];
+        if (next[tid] == thread.size()) {
+          continue;
+        }
+        isEnd = false;
+        Event *event = thread[next[tid]];
+        if (!next[tid] && creator.count(tid) && !done.count(creator[tid])) {
+          continue;
+        }
+        auto join = trace->joinThreadPoint.find(event);
+        if (join != trace->joinThreadPoint.end() && next[join->second] < trace->eventList[join->second].size()) {
+          continue;
+        }
+        next[tid]++;
+        done.insert(event);
+        schedule.push_back(event);
+        extend();
+        schedule.pop_back();
+        done.erase(event);
+        next[tid]--;
+      }
+      if (isEnd) {
+        f(schedule);
+      }
+    };
+    extend();
+  }
+
+  void addBranch(Event *event, z3::expr condition) {
+    encode->ifFormula.push_back(std::make_pair(event, condition));
+  }
+
+  void buildFlipFormulas(std::vector<z3::expr> &keepFormulas, std::vector<z3::expr> &flipFormulas) {
+    encode->buildFlipFormulas(keepFormulas, flipFormulas);
+  }
+
+  // the flip of branch i as flipIfBranch added it before the keep and flip formulas
+  z3::expr buildFormerFlipFormula(unsigned i) {
+    std::vector<std::pair<Event *, z3::expr>> &ifFormula = encode->ifFormula;
+    z3::expr_vector formulas(ctx());
+    formulas.push_back(!ifFormula[i].second);
+    Event *curr = ifFormula[i].first;
+    for (unsigned j = 0; j < ifFormula.size(); j++) {
+      if (j == i) {
+        continue;
+      }
+      Event *temp = ifFormula[j].first;
+      z3::expr currIf = ctx().int_const(curr->eventName.c_str());
+      z3::expr tempIf = ctx().int_const(temp->eventName.c_str());
+      if (curr->threadId == temp->threadId) {
+        if (curr->eventId > temp->eventId) {
+          formulas.push_back(ifFormula[j].second);
+        }
+      } else {
+        formulas.push_back(z3::implies(tempIf < currIf, ifFormula[j].second));
+      }
+    }
+    return z3::mk_and(formulas);
+  }
+
+  // whether the keep formulas and flipFormula allow the same schedules and
+  // values as formerFlipFormula, with E_FLIP being the order of the branch
+  void expectEquivalent(Event *branch, std::vector<z3::expr> &keepFormulas, z3::expr flipFormula,
+                        z3::expr formerFlipFormula) {
+    z3::expr_vector formulas(ctx());
+    for (auto &keep : keepFormulas) {
+      formulas.push_back(keep);
+    }
+    formulas.push_back(flipFormula);
+    z3::expr flip = z3::mk_and(formulas);
+
+    z3::solver s(ctx());
+    addMemoryModel(s);
+    s.add(flip && !formerFlipFormula);
+    EXPECT_EQ(z3::unsat, s.check());
+
+    s.reset();
+    addMemoryModel(s);
+    s.add(ctx().int_const("E_FLIP") == getOrderExpr(branch));
+    s.add(formerFlipFormula && !flip);
+    EXPECT_EQ(z3::unsat, s.check());
+  }
+};
+
+} // namespace klee
+
+using namespace klee;
+
+namespace {
+
+// Thread 1 runs three branches, controlGranularity folded the second into the
+// step of the first. Thread 2 runs two branches. The conditions share x and y,
+// so some flips are unsatisfiable.
+TEST_F(EncodeTest, FlipFormulasAsBefore) {
+  Event *a = addEvent(1);
+  Event *b = addEvent(1);
+  Event *c = addEvent(1);
+  Event *d = addEvent(2);
+  Event *e = addEvent(2);
+  b->shareOrderWith(a);
+
+  z3::expr x = ctx().int_const("x");
+  z3::expr y = ctx().int_const("y");
+  addBranch(a, x > 0);
+  addBranch(b, y > 0);
+  addBranch(c, x + y > 1);
+  addBranch(d, x < 5);
+  addBranch(e, y == x);
+
+  std::vector<z3::expr> keepFormulas, flipFormulas;
+  buildFlipFormulas(keepFormulas, flipFormulas);
+  ASSERT_EQ(5u, keepFormulas.size());
+  ASSERT_EQ(5u, flipFormulas.size());
+
+  Event *branches[] = {a, b, c, d, e};
+  for (unsigned i = 0; i < 5; i++) {
+    SCOPED_TRACE(i);
+    expectEquivalent(branches[i], keepFormulas, flipFormulas[i], buildFormerFlipFormula(i));
+  }
+}
+
+// Thread 1 writes x, creates threads 2 and 3, reads x, joins thread 2 and
+// reads x again. Thread 2 writes, reads and writes x, thread 3 reads and
+// writes it.
+TEST_F(EncodeTest, PruneMayBeReadAsSchedules) {
+  Event *w1 = addEvent(1);
+  Event *create2 = addEvent(1);
+  Event *create3 = addEvent(1);
+  Event *r1 = addEvent(1);
+  Event *join2 = addEvent(1);
+  Event *r2 = addEvent(1);
+  Event *w2 = addEvent(2);
+  Event *r3 = addEvent(2);
+  Event *w3 = addEvent(2);
+  Event *r4 = addEvent(3);
+  Event *w4 = addEvent(3);
+  trace->insertThreadCreateOrJoin(std::make_pair(create2, 2), true);
+  trace->insertThreadCreateOrJoin(std::make_pair(create3, 3), true);
+  trace->insertThreadCreateOrJoin(std::make_pair(join2, 2), false);
+  computeMustHappenBefore();
+
+  // before means first comes before second in every schedule
+  std::vector<Event *> events;
+  for (auto &thread : trace->eventList) {
+    events.insert(events.end(), thread.begin(), thread.end());
+  }
+  std::set<std::pair<Event *, Event *>> before;
+  for (auto first : events) {
+    for (auto second : events) {
+      if (first != second) {
+        before.insert(std::make_pair(first, second));
+      }
+    }
+  }
+  unsigned scheduleNum = 0;
+  forEachSchedule([&](std::vector<Event *> &schedule) {
+    scheduleNum++;
+    for (unsigned i = 0; i < schedule.size(); i++) {
+      for (unsigned j = 0; j < i; j++) {
+        before.erase(std::make_pair(schedule[i], schedule[j]));
+      }
+    }
+  });
+  EXPECT_LT(1u, scheduleNum);
+  for (auto first : events) {
+    for (auto second : events) {
+      EXPECT_EQ(before.count(std::make_pair(first, second)) != 0, mustHappenBefore(first, second))
+          << first->eventName << " " << second->eventName;
+    }
+  }
+
+  // the candidates buildReadWriteFormula gives every read: the writes of the
+  // other threads and the latest write of its own thread; NULL is the
+  // initial value
+  std::vector<Event *> writes = {w1, w2, w3, w4};
+  std::vector<Event *> reads = {r1, r2, r3, r4};
+  std::vector<std::vector<Event *>> expected = {{w2, w3, w4, w1}, {w3, w4}, {w4, w2}, {w1, w2, w3}};
+  for (unsigned k = 0; k < reads.size(); k++) {
+    Event *read = reads[k];
+    SCOPED_TRACE(read->eventName);
+    std::vector<Event *> mayBeRead;
+    Event *latest = NULL;
+    for (auto write : writes) {
+      if (write->threadId != read->threadId) {
+        mayBeRead.push_back(write);
+      } else if (write->eventId < read->eventId) {
+        latest = write;
+      }
+    }
+    if (latest) {
+      mayBeRead.push_back(latest);
+    }
+    std::set<Event *> candidates(mayBeRead.begin(), mayBeRead.end());
+    bool mayReadInit = pruneMayBeRead(read, mayBeRead) && !latest;
+    EXPECT_EQ(expected[k], mayBeRead);
+
+    // the writes read takes its value from in some schedule, all of them
+    // stay candidates and on this trace nothing more can be pruned
+    std::set<Event *> readFrom;
+    forEachSchedule([&](std::vector<Event *> &schedule) {
+      Event *last = NULL;
+      for (auto event : schedule) {
+        if (event == read) {
+          break;
+        }
+        if (std::find(writes.begin(), writes.end(), event) != writes.end()) {
+          last = event;
+        }
+      }
+      EXPECT_TRUE(!last || candidates.count(last));
+      readFrom.insert(last);
+    });
+    std::set<Event *> kept(mayBeRead.begin(), mayBeRead.end());
+    if (mayReadInit) {
+      kept.insert(NULL);
+    }
+    EXPECT_EQ(readFrom, kept);
+  }
+}
+
+} // namespace
@@ -0,0 +1,158 @@
+#include "klee/Encode/FilterSymbolicExpr.h"
+#include "klee/Encode/Trace.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+class FilterSymbolicExprTest : public ::testing::Test {
+protected:
+  ArrayCache cache;
+
+  // a byte of the global variable, name is the variable followed by S or L
+  // and the number of the access
+  ref<Expr> read(const std::string &name) {
+    const Array *array = cache.CreateArray(name, 1);
+    return ReadExpr::create(UpdateList(array, 0), ConstantExpr::create(0, Expr::Int32));
+  }
+
+  ref<Expr> store(const std::string &name, ref<Expr> value) {
+    return EqExpr::alloc(value, read(name));
+  }
+
+  // resolveSymbolicExpr before it kept the nodes it had walked
+  void resolveAsBefore(ref<Expr> symbolicExpr, std::set<std::string> &relatedSymbolicExpr) {
+    if (symbolicExpr->getKind() == Expr::Read) {
+      relatedSymbolicExpr.insert(FilterSymbolicExpr::getName(symbolicExpr));
+      return;
+    }
+    unsigned kidsNum = symbolicExpr->getNumKids();
+    if (kidsNum == 2 && symbolicExpr->getKid(0) == symbolicExpr->getKid(1)) {
+      resolveAsBefore(symbolicExpr->getKid(0), relatedSymbolicExpr);
+    } else {
+      for (unsigned i = 0; i < kidsNum; i++) {
+        resolveAsBefore(symbolicExpr->getKid(i), relatedSymbolicExpr);
+      }
+    }
+  }
+
+  // the slicing of prepareData before the stores were bucketed by variable:
+  // every related variable scans the flat list of the remaining stores
+  void prepareAsBefore(Trace &trace, std::vector<ref<Expr>> &pathCondition,
+                       std::map<std::string, std::set<std::string>> &allRelatedSymbolicExprs,
+                       std::set<std::string> &related) {
+    std::vector<std::pair<std::string, ref<Expr>>> remainingExprs;
+    for (auto &it : trace.storeSymbolicExpr) {
+      remainingExprs.push_back(std::make_pair(FilterSymbolicExpr::getName(it->getKid(1)), it));
+    }
+    std::vector<std::string> pending;
+    auto relate = [&](const std::set<std::string> &names) {
+      for (auto &name : names) {
+        if (related.insert(name).second) {
+          pending.push_back(name);
+        }
+      }
+    };
+    for (auto &expr : trace.brSymbolicExpr) {
+      std::set<std::string> names;
+      resolveAsBefore(expr, names);
+      relate(names);
+    }
+    for (auto &expr : trace.assertSymbolicExpr) {
+      std::set<std::string> names;
+      resolveAsBefore(expr, names);
+      relate(names);
+    }
+    while (!pending.empty() && !remainingExprs.empty()) {
+      std::string name = pending.back();
+      pending.pop_back();
+      for (auto it = remainingExprs.begin(); it != remainingExprs.end();) {
+        if (name != it->first) {
+          ++it;
+          continue;
+        }
+        pathCondition.push_back(it->second);
+        std::set<std::string> names;
+        resolveAsBefore(it->second, names);
+        relate(names);
+        allRelatedSymbolicExprs[name].insert(names.begin(), names.end());
+        it = remainingExprs.erase(it);
+      }
+    }
+  }
+};
+
+TEST_F(FilterSymbolicExprTest, ResolveSharedSubtrees) {
+  // every level adds the one below twice, 2^20 paths lead to the reads
+  ref<Expr> expr = AddExpr::create(read("xL1"), read("yL2"));
+  for (unsigned i = 0; i < 20; i++) {
+    expr = AddExpr::create(expr, MulExpr::create(expr, read("zL" + std::to_string(i + 3))));
+  }
+  std::set<std::string> names;
+  FilterSymbolicExpr::resolveSymbolicExpr(expr, names);
+  EXPECT_EQ((std::set<std::string>{"x", "y", "z"}), names);
+}
+
+// The branch reads a, whose stores read b and c, whose stores read c and a
+// constant. The stores of d and e are not related to the branch; the store
+// of d reads e.
+TEST_F(FilterSymbolicExprTest, PrepareDataAsBefore) {
+  Trace trace;
+  ref<Expr> shared = MulExpr::create(read("cL3"), read("bL1"));
+  trace.storeSymbolicExpr = {
+      store("aS1", AddExpr::create(read("bL1"), ConstantExpr::create(1, Expr::Int8))),
+      store("bS2", read("cL3")),
+      store("dS3", read("eL4")),
+      store("cS4", ConstantExpr::create(5, Expr::Int8)),
+      store("aS5", AddExpr::create(shared, shared)),
+      store("eS6", ConstantExpr::create(1, Expr::Int8)),
+      store("bS7", SubExpr::create(read("bL8"), read("cL9"))),
+  };
+  trace.brSymbolicExpr = {UltExpr::create(ConstantExpr::create(0, Expr::Int8), read("aL10"))};
+  trace.assertSymbolicExpr = {EqExpr::create(read("fL11"), ConstantExpr::create(2, Expr::Int8))};
+  trace.rwSymbolicExpr = {store("aL10", read("aS5")), store("dL12", read("dS3")), store("cL9", read("cS4"))};
+
+  std::vector<ref<Expr>> pathCondition;
+  std::map<std::string, std::set<std::string>> allRelatedSymbolicExprs;
+  std::set<std::string> related;
+  prepareAsBefore(trace, pathCondition, allRelatedSymbolicExprs, related);
+  std::vector<ref<Expr>> rwSymbolicExpr;
+  for (auto &expr : trace.rwSymbolicExpr) {
+    if (related.count(FilterSymbolicExpr::getName(expr->getKid(1)))) {
+      rwSymbolicExpr.push_back(expr);
+    }
+  }
+
+  FilterSymbolicExpr filter;
+  filter.prepareData(&trace);
+  ASSERT_EQ(pathCondition.size(), trace.pathCondition.size());
+  for (unsigned i = 0; i < pathCondition.size(); i++) {
+    EXPECT_EQ(pathCondition[i].get(), trace.pathCondition[i].get()) << i;
+  }
+  EXPECT_EQ(allRelatedSymbolicExprs, trace.allRelatedSymbolicExprs);
+  for (auto name : {"a", "b", "c", "d", "e", "f"}) {
+    EXPECT_EQ(related.count(name) != 0, filter.isRelated(name)) << name;
+  }
+  ASSERT_EQ(rwSymbolicExpr.size(), trace.rwSymbolicExpr.size());
+  for (unsigned i = 0; i < rwSymbolicExpr.size(); i++) {
+    EXPECT_EQ(rwSymbolicExpr[i].get(), trace.rwSymbolicExpr[i].get()) << i;
+  }
+
+  // the slice itself
+  EXPECT_EQ(5u, pathCondition.size());
+  EXPECT_EQ((std::set<std::string>{"a", "b", "c", "f"}), related);
+  ASSERT_EQ(1u, trace.brRelatedSymbolicExpr.size());
+  EXPECT_EQ((std::set<std::string>{"a"}), trace.brRelatedSymbolicExpr[0]);
+}
+
+} // namespace
@@ -0,0 +1,93 @@
+#include "klee/Encode/KQuery2Z3.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+
+#include <string>
+#include <vector>
+#include <z3++.h>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+class KQuery2Z3Test : public ::testing::Test {
+protected:
+  z3::context ctx;
+  ArrayCache cache;
+
+  // a two byte global, translated to the constant named by its array
+  ref<Expr> concat(const std::string &name, bool isFloat = false) {
+    const Array *array = cache.CreateArray(name, 2);
+    ref<Expr> high = ReadExpr::create(UpdateList(array, 0), ConstantExpr::create(1, Expr::Int32));
+    ref<Expr> low = ReadExpr::create(UpdateList(array, 0), ConstantExpr::create(0, Expr::Int32));
+    ref<Expr> e = ConcatExpr::alloc(high, low);
+    e->isFloat = isFloat;
+    return e;
+  }
+
+  z3::expr bv(const std::string &name) {
+    return ctx.bv_const(name.c_str(), 64);
+  }
+
+  z3::expr real(const std::string &name) {
+    return ctx.real_const(name.c_str());
+  }
+
+  // the translation of a translator that has seen nothing before
+  z3::expr translateAlone(ref<Expr> e) {
+    KQuery2Z3 kq(ctx);
+    return kq.getZ3Expr(e);
+  }
+};
+
+// the globals are shared by the queries and inside them, every level doubles
+// the number of paths to them
+TEST_F(KQuery2Z3Test, SharedSubtrees) {
+  ref<Expr> a = concat("a");
+  ref<Expr> b = concat("b");
+  ref<Expr> e = AddExpr::alloc(a, b);
+  z3::expr expected = bv("a") + bv("b");
+  std::vector<ref<Expr>> queries;
+  std::vector<z3::expr> results;
+  for (unsigned i = 0; i < 40; i++) {
+    e = AddExpr::alloc(e, MulExpr::alloc(e, a));
+    expected = expected + expected * bv("a");
+    queries.push_back(EqExpr::alloc(e, b));
+    results.push_back(expected == bv("b"));
+  }
+
+  KQuery2Z3 kq(ctx);
+  for (unsigned i = 0; i < queries.size(); i++) {
+    z3::expr result = kq.getZ3Expr(queries[i]);
+    EXPECT_TRUE(z3::eq(results[i], result)) << i;
+  }
+  EXPECT_TRUE(z3::eq(results.back(), translateAlone(queries.back())));
+}
+
+// A query that makes x and y floats changes the translation of an earlier
+// query reading them below a node whose own flags stay the same.
+TEST_F(KQuery2Z3Test, FloatFlagInvalidates) {
+  ref<Expr> x = concat("x");
+  ref<Expr> y = concat("y");
+  ref<Expr> query = NotExpr::alloc(EqExpr::alloc(x, y));
+
+  KQuery2Z3 kq(ctx);
+  z3::expr before = kq.getZ3Expr(query);
+  EXPECT_TRUE(z3::eq(!(bv("x") == bv("y")), before));
+  EXPECT_TRUE(z3::eq(before, translateAlone(query)));
+
+  ref<Expr> floats = EqExpr::alloc(AddExpr::alloc(x, concat("f", true)), AddExpr::alloc(y, concat("g", true)));
+  z3::expr floatResult = kq.getZ3Expr(floats);
+  EXPECT_TRUE(z3::eq((real("x") + real("f")) == (real("y") + real("g")), floatResult));
+  EXPECT_TRUE(x->isFloat);
+  EXPECT_TRUE(y->isFloat);
+
+  z3::expr after = kq.getZ3Expr(query);
+  EXPECT_TRUE(z3::eq(!(real("x") == real("y")), after));
+  EXPECT_TRUE(z3::eq(after, translateAlone(query)));
+  EXPECT_TRUE(z3::eq(floatResult, translateAlone(floats)));
+}
+
+} // namespace
@@ -0,0 +1,147 @@
+#include "klee/Encode/Event.h"
+#include "klee/Encode/Prefix.h"
+#include "klee/Encode/PrefixScheduler.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+class PrefixSchedulerTest : public ::testing::Test {
+protected:
+  std::string file;
+  std::vector<std::unique_ptr<InstructionInfo>> infos;
+  std::vector<std::unique_ptr<KInstruction>> kinsts;
+
+  // a prefix with one step for every entry of threads, the last step is the
+  // branch at branchInstId
+  Prefix *createPrefix(const std::string &name, std::vector<unsigned> threads, unsigned branchInstId = 1,
+                       bool brCondition = false) {
+    std::vector<std::unique_ptr<Event>> events;
+    std::vector<Event *> eventList;
+    std::map<Event *, uint64_t> threadIdMap;
+    for (unsigned i = 0; i < threads.size(); i++) {
+      unsigned instId = i + 1 == threads.size() ? branchInstId : 100 + infos.size();
+      infos.emplace_back(new InstructionInfo(instId, file, 0, 0, 0));
+      kinsts.emplace_back(new KInstruction());
+      kinsts.back()->info = infos.back().get();
+      events.emplace_back(new Event(threads[i], i, "E", kinsts.back().get(), "", "", Event::NORMAL));
+      eventList.push_back(events.back().get());
+    }
+    eventList.back()->brCondition = brCondition;
+    return new Prefix(eventList, threadIdMap, name);
+  }
+
+  // selects the remaining prefixes, deletes them and returns their names
+  std::vector<std::string> drain(PrefixScheduler &scheduler) {
+    std::vector<std::string> names;
+    while (Prefix *prefix = scheduler.selectNextItem()) {
+      names.push_back(prefix->getName());
+      delete prefix;
+    }
+    EXPECT_TRUE(scheduler.isSchedulerEmpty());
+    return names;
+  }
+};
+
+TEST_F(PrefixSchedulerTest, AssertionFirst) {
+  PrefixScheduler::PrefixSchedulerType types[] = {PrefixScheduler::FIFO, PrefixScheduler::Coverage,
+                                                  PrefixScheduler::Shortest, PrefixScheduler::Bounded,
+                                                  PrefixScheduler::Random};
+  for (auto type : types) {
+    std::unique_ptr<PrefixScheduler> scheduler(getPrefixSchedulerByType(type, 1, 0));
+    EXPECT_TRUE(scheduler->addItem(createPrefix("a", {0}, 1)));
+    EXPECT_TRUE(scheduler->addItem(createPrefix("b", {0, 0}, 2)));
+    // more context switches than the bound, an assertion prefix is kept anyway
+    EXPECT_TRUE(scheduler->addItem(createPrefix("assert_c", {0, 1, 0, 1, 0}, 3)));
+    EXPECT_TRUE(scheduler->addItem(createPrefix("d", {0}, 4)));
+    EXPECT_TRUE(scheduler->addItem(createPrefix("assert_e", {0, 1, 0}, 5)));
+    EXPECT_EQ(5u, scheduler->itemNum());
+
+    std::vector<std::string> names = drain(*scheduler);
+    ASSERT_EQ(5u, names.size());
+    EXPECT_EQ("assert_c", names[0]);
+    EXPECT_EQ("assert_e", names[1]);
+  }
+}
+
+TEST_F(PrefixSchedulerTest, Fifo) {
+  FIFOPrefixScheduler scheduler;
+  scheduler.addItem(createPrefix("a", {0, 1}));
+  scheduler.addItem(createPrefix("b", {0}));
+  scheduler.addItem(createPrefix("c", {0, 1, 0}));
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), drain(scheduler));
+}
+
+TEST_F(PrefixSchedulerTest, Shortest) {
+  ShortestPrefixScheduler scheduler;
+  scheduler.addItem(createPrefix("a", {0, 1, 1}));
+  scheduler.addItem(createPrefix("b", {0}));
+  scheduler.addItem(createPrefix("c", {0, 1}));
+  scheduler.addItem(createPrefix("d", {1}));
+  EXPECT_EQ((std::vector<std::string>{"b", "d", "c", "a"}), drain(scheduler));
+}
+
+// b flips the branch a flips to the same direction, which is covered once a
+// is selected, so b goes back behind c
+TEST_F(PrefixSchedulerTest, CoverageRequeuesGrownPriority) {
+  CoveragePrefixScheduler scheduler;
+  scheduler.addItem(createPrefix("a", {0}, 7, false));
+  scheduler.addItem(createPrefix("b", {0, 1}, 7, false));
+  scheduler.addItem(createPrefix("c", {0}, 7, true));
+  scheduler.addItem(createPrefix("d", {0}, 8, false));
+
+  Prefix *prefix = scheduler.selectNextItem();
+  ASSERT_TRUE(prefix);
+  EXPECT_EQ("a", prefix->getName());
+  delete prefix;
+  EXPECT_EQ(3u, scheduler.itemNum());
+  EXPECT_EQ((std::vector<std::string>{"c", "d", "b"}), drain(scheduler));
+}
+
+TEST_F(PrefixSchedulerTest, Bounded) {
+  BoundedPrefixScheduler scheduler(1);
+  EXPECT_TRUE(scheduler.addItem(createPrefix("a", {0, 1})));
+  EXPECT_FALSE(scheduler.addItem(createPrefix("b", {0, 1, 0})));
+  EXPECT_TRUE(scheduler.addItem(createPrefix("c", {0, 0, 0})));
+  EXPECT_FALSE(scheduler.addItem(createPrefix("d", {1, 0, 1, 0})));
+  EXPECT_EQ(2u, scheduler.itemNum());
+  // fewest context switches first
+  EXPECT_EQ((std::vector<std::string>{"c", "a"}), drain(scheduler));
+}
+
+TEST_F(PrefixSchedulerTest, Unbounded) {
+  BoundedPrefixScheduler scheduler(0);
+  EXPECT_TRUE(scheduler.addItem(createPrefix("a", {0, 1, 0, 1})));
+  EXPECT_TRUE(scheduler.addItem(createPrefix("b", {0, 1})));
+  EXPECT_EQ((std::vector<std::string>{"b", "a"}), drain(scheduler));
+}
+
+TEST_F(PrefixSchedulerTest, RandomSeed) {
+  std::vector<std::vector<std::string>> orders;
+  for (unsigned seed : {5, 5, 6}) {
+    RandomPrefixScheduler scheduler(seed);
+    for (char name = 'a'; name <= 'h'; name++) {
+      scheduler.addItem(createPrefix(std::string(1, name), {0}));
+    }
+    orders.push_back(drain(scheduler));
+    ASSERT_EQ(8u, orders.back().size());
+  }
+  EXPECT_EQ(orders[0], orders[1]);
+  EXPECT_NE(orders[0], orders[2]);
+
+  std::vector<std::string> names = orders[0];
+  std::sort(names.begin(), names.end());
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c", "d", "e", "f", "g", "h"}), names);
+}
+
+} // namespace
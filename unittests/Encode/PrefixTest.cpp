@@ -0,0 +1,157 @@
+#include "klee/Encode/Event.h"
+#include "klee/Encode/Prefix.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+// thread 0 creates thread 1 at its second step, then the two threads
+// alternate and the last step is a branch
+class PrefixTest : public ::testing::Test {
+protected:
+  std::string file;
+  std::vector<std::unique_ptr<InstructionInfo>> infos;
+  std::vector<std::unique_ptr<KInstruction>> kinsts;
+  std::vector<std::unique_ptr<Event>> events;
+  std::vector<Event *> eventList;
+  std::map<Event *, uint64_t> threadIdMap;
+
+  void addEvent(unsigned threadId, unsigned instId) {
+    infos.emplace_back(new InstructionInfo(instId, file, 0, 0, 0));
+    kinsts.emplace_back(new KInstruction());
+    kinsts.back()->info = infos.back().get();
+    events.emplace_back(new Event(threadId, events.size(), "E", kinsts.back().get(), "", "", Event::NORMAL));
+    eventList.push_back(events.back().get());
+  }
+
+  void SetUp() override {
+    addEvent(0, 10);
+    addEvent(0, 11);
+    threadIdMap[eventList.back()] = 1;
+    addEvent(1, 20);
+    addEvent(1, 21);
+    addEvent(0, 12);
+    eventList.back()->brCondition = true;
+  }
+};
+
+void expectSamePrefix(Prefix &expected, Prefix &actual) {
+  EXPECT_EQ(expected.getName(), actual.getName());
+  ASSERT_EQ(expected.getRuns().size(), actual.getRuns().size());
+  for (unsigned i = 0; i < expected.getRuns().size(); i++) {
+    EXPECT_EQ(expected.getRuns()[i].threadId, actual.getRuns()[i].threadId);
+    EXPECT_EQ(expected.getRuns()[i].count, actual.getRuns()[i].count);
+  }
+  EXPECT_EQ(expected.getInstIds(), actual.getInstIds());
+  EXPECT_EQ(expected.getChildren(), actual.getChildren());
+  EXPECT_EQ(expected.getBranchInstId(), actual.getBranchInstId());
+  EXPECT_EQ(expected.getBrCondition(), actual.getBrCondition());
+  EXPECT_EQ(expected.getDPORState(), actual.getDPORState());
+  EXPECT_EQ(expected.getDPORThreads(), actual.getDPORThreads());
+  ASSERT_EQ(expected.getSleepSet().size(), actual.getSleepSet().size());
+  for (unsigned i = 0; i < expected.getSleepSet().size(); i++) {
+    EXPECT_EQ(expected.getSleepSet()[i].threadId, actual.getSleepSet()[i].threadId);
+    EXPECT_EQ(expected.getSleepSet()[i].kind, actual.getSleepSet()[i].kind);
+    EXPECT_EQ(expected.getSleepSet()[i].object, actual.getSleepSet()[i].object);
+  }
+}
+
+TEST_F(PrefixTest, Build) {
+  Prefix prefix(eventList, threadIdMap, "test");
+  ASSERT_EQ(3u, prefix.getRuns().size());
+  EXPECT_EQ(0u, prefix.getRuns()[0].threadId);
+  EXPECT_EQ(2u, prefix.getRuns()[0].count);
+  EXPECT_EQ(1u, prefix.getRuns()[1].threadId);
+  EXPECT_EQ(5u, prefix.size());
+  ASSERT_EQ(1u, prefix.getChildren().size());
+  EXPECT_EQ(1u, prefix.getChildren()[0].first);
+  EXPECT_EQ(1u, prefix.getChildren()[0].second);
+  EXPECT_EQ(12u, prefix.getBranchInstId());
+  EXPECT_TRUE(prefix.getBrCondition());
+
+  // the replay walks the runs
+  EXPECT_EQ(0u, prefix.getCurrentEventThreadId());
+  prefix.increasePosition();
+  EXPECT_EQ(1u, prefix.getNextThreadId());
+  prefix.increasePosition();
+  EXPECT_EQ(1u, prefix.getCurrentEventThreadId());
+  EXPECT_EQ(20u, prefix.getCurrentInstId());
+}
+
+TEST_F(PrefixTest, WriteRead) {
+  Prefix prefix(eventList, threadIdMap, "test");
+  std::vector<unsigned> threads = {0, 1};
+  std::vector<Prefix::SleepAccess> sleep = {{2, 1, 0x1234}};
+  prefix.setDPOR(42, threads, sleep);
+
+  std::stringstream stream;
+  prefix.write(stream);
+  std::unique_ptr<Prefix> read(Prefix::read(stream));
+  ASSERT_TRUE(read != nullptr);
+  expectSamePrefix(prefix, *read);
+  EXPECT_EQ(0u, read->getPosition());
+}
+
+TEST_F(PrefixTest, ReadTruncated) {
+  Prefix prefix(eventList, threadIdMap, "test");
+  std::stringstream stream;
+  prefix.write(stream);
+  std::string data = stream.str();
+  for (unsigned size = 0; size < data.size(); size++) {
+    std::istringstream truncated(data.substr(0, size));
+    std::unique_ptr<Prefix> read(Prefix::read(truncated));
+    EXPECT_TRUE(read == nullptr) << "read from " << size << " bytes";
+  }
+}
+
+// the children are written field by field, without the padding of a pair
+TEST_F(PrefixTest, WriteChildren) {
+  Prefix prefix(eventList, threadIdMap, "test");
+  std::stringstream stream;
+  prefix.write(stream);
+  std::string data = stream.str();
+  // name, three runs and five steps before the children
+  size_t offset = (4 + 4) + (4 + 3 * 8) + (4 + 5 * 4);
+  ASSERT_LT(offset + 16, data.size());
+  uint32_t size, step;
+  uint64_t threadId;
+  memcpy(&size, &data[offset], sizeof(size));
+  memcpy(&step, &data[offset + 4], sizeof(step));
+  memcpy(&threadId, &data[offset + 8], sizeof(threadId));
+  EXPECT_EQ(1u, size);
+  EXPECT_EQ(1u, step);
+  EXPECT_EQ(1u, threadId);
+  // the branch follows
+  uint32_t branchInstId;
+  memcpy(&branchInstId, &data[offset + 16], sizeof(branchInstId));
+  EXPECT_EQ(12u, branchInstId);
+}
+
+TEST_F(PrefixTest, ReadCorruptSize) {
+  Prefix prefix(eventList, threadIdMap, "test");
+  std::stringstream stream;
+  prefix.write(stream);
+  std::string data = stream.str();
+  // the sizes of the name, the runs, the steps and the children
+  size_t offsets[] = {0, 8, 36, 60};
+  for (auto offset : offsets) {
+    std::string corrupt = data;
+    uint32_t size = 0xffffffff;
+    memcpy(&corrupt[offset], &size, sizeof(size));
+    std::istringstream in(corrupt);
+    std::unique_ptr<Prefix> read(Prefix::read(in));
+    EXPECT_TRUE(read == nullptr) << "size at " << offset;
+  }
+}
+
+} // namespace
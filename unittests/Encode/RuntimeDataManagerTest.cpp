@@ -0,0 +1,81 @@
+#include "klee/Encode/RuntimeDataManager.h"
+#include "klee/Encode/Trace.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+// The abstract of a trace is the function of every thread and the directions
+// of its branches. Every sequence of up to three thread abstracts out of four
+// is a trace, so a trace comes again with its threads in another order.
+std::vector<std::vector<std::string>> getAbstracts() {
+  const char *threads[] = {"main:01", "main:10", "worker:", "worker:1"};
+  std::vector<std::vector<std::string>> abstracts;
+  for (unsigned size = 1; size <= 3; size++) {
+    unsigned count = 1;
+    for (unsigned i = 0; i < size; i++) {
+      count *= 4;
+    }
+    for (unsigned n = 0; n < count; n++) {
+      std::vector<std::string> abstract;
+      for (unsigned i = 0, rest = n; i < size; i++, rest /= 4) {
+        abstract.push_back(threads[rest % 4]);
+      }
+      abstracts.push_back(abstract);
+    }
+  }
+  return abstracts;
+}
+
+TEST(RuntimeDataManagerTest, SignatureOfEqualTraces) {
+  std::vector<std::vector<std::string>> abstracts = getAbstracts();
+  std::vector<Trace> traces(abstracts.size());
+  for (unsigned i = 0; i < traces.size(); i++) {
+    traces[i].abstract = abstracts[i];
+  }
+  for (auto &a : traces) {
+    for (auto &b : traces) {
+      if (a.isEqual(&b)) {
+        EXPECT_EQ(a.getAbstractSignature(), b.getAbstractSignature());
+      }
+    }
+  }
+}
+
+// the index gives the same answers as comparing with every tested trace,
+// which isCurrentTraceUntested did before
+TEST(RuntimeDataManagerTest, UntestedAsLinearScan) {
+  std::vector<std::vector<std::string>> abstracts = getAbstracts();
+  RuntimeDataManager data;
+  std::vector<Trace *> tested;
+  unsigned id = 0;
+  for (unsigned round = 0; round < 2; round++) {
+    // a fixed shuffle, 37 is prime to the number of traces
+    for (unsigned i = 0; i < abstracts.size(); i++) {
+      Trace *trace = data.createNewTrace(++id);
+      trace->abstract = abstracts[i * 37 % abstracts.size()];
+      bool expected = true;
+      for (auto other : tested) {
+        if (trace->isEqual(other)) {
+          expected = false;
+          break;
+        }
+      }
+      if (expected) {
+        tested.push_back(trace);
+      }
+      EXPECT_EQ(expected, data.isCurrentTraceUntested()) << "trace " << id;
+      EXPECT_EQ(expected, trace->isUntested);
+    }
+  }
+  // the multisets of up to three out of four thread abstracts
+  EXPECT_EQ(4u + 10u + 20u, tested.size());
+  EXPECT_EQ(tested.size(), data.getTestedPathsNumber());
+}
+
+} // namespace
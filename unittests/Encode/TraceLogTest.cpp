@@ -0,0 +1,171 @@
+#include "klee/Encode/Event.h"
+#include "klee/Encode/Trace.h"
+#include "klee/Encode/TraceLog.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+// two threads, the second one created by the first and storing to x
+struct TestTrace {
+  Trace trace;
+  Event create;
+  Event store;
+  Event load;
+
+  TestTrace(unsigned id)
+      : create(0, 0, "E0", NULL, "", "", Event::VIRTUAL), store(1, 1, "E1", NULL, "x", "x_S1", Event::NORMAL),
+        load(0, 2, "E2", NULL, "x", "x_L2", Event::NORMAL) {
+    trace.Id = id;
+    trace.traceType = Trace::UNIQUE;
+    store.isGlobal = true;
+    load.isGlobal = true;
+    trace.path.push_back(&create);
+    trace.path.push_back(&store);
+    trace.path.push_back(&load);
+    trace.writeSet["x"].push_back(&store);
+    trace.readSet["x"].push_back(&load);
+    trace.createThreadPoint[&create] = 1;
+  }
+};
+
+void expectTrace(TraceLogReader &reader, unsigned id) {
+  TraceLogReader::Record record;
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(TraceLog::TraceBegin, record.kind);
+  TraceLogReader::Cursor begin(record);
+  uint32_t traceSize, traceId, threadNum, eventNum;
+  uint8_t traceType;
+  ASSERT_TRUE(begin.read(traceSize) && begin.read(traceId) && begin.read(traceType) && begin.read(threadNum) &&
+              begin.read(eventNum));
+  EXPECT_TRUE(begin.atEnd());
+  EXPECT_EQ(id, traceId);
+  EXPECT_EQ((uint8_t)Trace::UNIQUE, traceType);
+  EXPECT_EQ(3u, eventNum);
+
+  const char *names[] = {"E0", "E1", "E2"};
+  for (unsigned i = 0; i < 3; i++) {
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQ(TraceLog::EventRecord, record.kind);
+    TraceLogReader::Cursor event(record);
+    uint32_t eventId, threadId, threadEventId, orderId, instId;
+    uint8_t eventType, isGlobal, isConditionInst, brCondition;
+    llvm::StringRef eventName, name, globalName;
+    ASSERT_TRUE(event.read(eventId) && event.read(threadId) && event.read(threadEventId) && event.read(orderId) &&
+                event.read(instId) && event.read(eventType) && event.read(isGlobal) &&
+                event.read(isConditionInst) && event.read(brCondition) && event.read(eventName) &&
+                event.read(name) && event.read(globalName));
+    EXPECT_TRUE(event.atEnd());
+    EXPECT_EQ(i, eventId);
+    EXPECT_EQ(TraceLog::none, instId);
+    EXPECT_EQ(names[i], eventName.str());
+  }
+
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(TraceLog::ReadSet, record.kind);
+  TraceLogReader::Cursor read(record);
+  llvm::StringRef variable;
+  uint32_t size, eventId;
+  ASSERT_TRUE(read.read(variable) && read.read(size) && read.read(eventId));
+  EXPECT_EQ("x", variable.str());
+  EXPECT_EQ(1u, size);
+  EXPECT_EQ(2u, eventId);
+
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(TraceLog::WriteSet, record.kind);
+  TraceLogReader::Cursor write(record);
+  ASSERT_TRUE(write.read(variable) && write.read(size) && write.read(eventId));
+  EXPECT_EQ(1u, eventId);
+
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(TraceLog::ThreadCreate, record.kind);
+  TraceLogReader::Cursor create(record);
+  uint64_t child;
+  ASSERT_TRUE(create.read(eventId) && create.read(child));
+  EXPECT_EQ(0u, eventId);
+  EXPECT_EQ(1u, child);
+
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(TraceLog::TraceEnd, record.kind);
+  EXPECT_EQ(0u, record.size);
+}
+
+TEST(TraceLogTest, RoundTrip) {
+  const char *path = "tracelog1.out";
+  unlink(path);
+  {
+    TraceLogWriter writer;
+    ASSERT_TRUE(writer.open(path));
+    TestTrace first(1), second(2);
+    writer.write(&first.trace);
+    writer.write(&second.trace);
+    ASSERT_TRUE(writer.isOpen());
+  }
+
+  TraceLogReader reader;
+  ASSERT_TRUE(reader.open(path));
+  for (unsigned pass = 0; pass < 2; pass++) {
+    expectTrace(reader, 1);
+    expectTrace(reader, 2);
+    TraceLogReader::Record record;
+    EXPECT_FALSE(reader.next(record));
+    reader.rewind();
+  }
+}
+
+// A trace cut short by a failed write is followed by the traces of other
+// processes, the reader skips it.
+TEST(TraceLogTest, SkipsDamagedTrace) {
+  const char *path = "tracelog2.out";
+  const char *whole = "tracelog3.out";
+  unlink(path);
+  unlink(whole);
+  {
+    TraceLogWriter writer;
+    ASSERT_TRUE(writer.open(whole));
+    TestTrace first(1);
+    writer.write(&first.trace);
+  }
+  std::string bytes;
+  {
+    FILE *file = fopen(whole, "rb");
+    ASSERT_NE((FILE *)NULL, file);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+      bytes.append(buf, n);
+    }
+    fclose(file);
+  }
+  ASSERT_GT(bytes.size(), 24u);
+  {
+    // the magic word and the first half of the trace
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    // not at a multiple of 4, the next trace is not aligned either
+    size_t cut = 4 + (bytes.size() - 4) / 2;
+    cut += cut % 4 ? 0 : 2;
+    ASSERT_EQ((ssize_t)cut, write(fd, bytes.data(), cut));
+    close(fd);
+  }
+  {
+    TraceLogWriter writer;
+    ASSERT_TRUE(writer.open(path));
+    TestTrace second(2);
+    writer.write(&second.trace);
+  }
+
+  TraceLogReader reader;
+  ASSERT_TRUE(reader.open(path));
+  expectTrace(reader, 2);
+  TraceLogReader::Record record;
+  EXPECT_FALSE(reader.next(record));
+}
+
+} // namespace
@@ -0,0 +1,61 @@
+#include "klee/Thread/AddressMap.h"
+
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(AddressMapTest, Empty) {
+  AddressMap<int> map;
+  EXPECT_EQ(0u, map.size());
+  EXPECT_EQ(NULL, map.find(0x1000));
+}
+
+TEST(AddressMapTest, InsertFind) {
+  AddressMap<int> map;
+  int a = 1, b = 2;
+  map.insert(0x1000, &a);
+  map.insert(0x1008, &b);
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(&a, map.find(0x1000));
+  EXPECT_EQ(&b, map.find(0x1008));
+  EXPECT_EQ(NULL, map.find(0x1004));
+}
+
+// enough entries to grow the table several times, at addresses that share
+// their low bits like the fields of one struct
+TEST(AddressMapTest, Grow) {
+  AddressMap<int> map;
+  std::vector<int> values(1000);
+  for (unsigned i = 0; i < values.size(); i++) {
+    values[i] = i;
+    map.insert(0x7f0000000000ULL + 64 * i, &values[i]);
+  }
+  EXPECT_EQ(values.size(), map.size());
+  for (unsigned i = 0; i < values.size(); i++) {
+    EXPECT_EQ(&values[i], map.find(0x7f0000000000ULL + 64 * i));
+    EXPECT_EQ(NULL, map.find(0x7f0000000000ULL + 64 * i + 8));
+  }
+
+  std::map<uint64_t, int *> seen;
+  map.forEach([&](uint64_t address, int *value) { seen[address] = value; });
+  EXPECT_EQ(values.size(), seen.size());
+  EXPECT_EQ(&values[999], seen[0x7f0000000000ULL + 64 * 999]);
+}
+
+TEST(AddressMapTest, Clear) {
+  AddressMap<int> map;
+  int a = 1;
+  map.insert(0x1000, &a);
+  map.clear();
+  EXPECT_EQ(0u, map.size());
+  EXPECT_EQ(NULL, map.find(0x1000));
+  map.insert(0x1000, &a);
+  EXPECT_EQ(&a, map.find(0x1000));
+}
+
+} // namespace
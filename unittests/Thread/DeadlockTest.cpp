@@ -0,0 +1,173 @@
+#include "Core/ExecutionState.h"
+#include "klee/Module/KModule.h"
+#include "klee/Thread/ThreadScheduler.h"
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+const uint64_t mutexA = 0x1000;
+const uint64_t mutexB = 0x2000;
+
+// A state with the main thread and two more, all running an empty function.
+// The helpers below do what the executor does for the pthread calls.
+class DeadlockTest : public ::testing::Test {
+protected:
+  llvm::LLVMContext context;
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<KFunction> kf;
+  std::unique_ptr<ExecutionState> state;
+  Thread *t1, *t2, *t3;
+
+  void SetUp() override {
+    module.reset(new llvm::Module("DeadlockTest", context));
+    llvm::Function *f = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(context), false),
+        llvm::Function::ExternalLinkage, "thread", module.get());
+    kf.reset(new KFunction(f, nullptr));
+    state.reset(new ExecutionState(kf.get()));
+    t1 = state->currentThread;
+    t2 = state->createThread(kf.get());
+    t3 = state->createThread(kf.get());
+  }
+
+  void TearDown() override {
+    state.reset();
+    kf.reset();
+  }
+
+  bool lock(Thread *thread, uint64_t address) {
+    std::string errorMsg;
+    bool isBlocked;
+    state->mutexManager.lock(address, thread->threadId, isBlocked, errorMsg);
+    if (isBlocked) {
+      state->switchThreadToMutexBlocked(thread);
+      state->swapOutThread(thread, false, false, false, false);
+    }
+    return !isBlocked;
+  }
+
+  void unlock(uint64_t address) {
+    std::string errorMsg;
+    state->mutexManager.unlock(address, errorMsg);
+    state->swapInWokenThreads();
+  }
+
+  void join(Thread *thread, Thread *joined) {
+    state->joinRecord[joined->threadId].push_back(thread->threadId);
+    state->swapOutThread(thread, false, false, true, false);
+  }
+
+  bool isScheduled(Thread *thread) {
+    std::vector<Thread *> items;
+    state->threadScheduler->popAllItem(items);
+    bool found = false;
+    for (auto item : items) {
+      found |= item == thread;
+      state->threadScheduler->addItem(item);
+    }
+    return found;
+  }
+};
+
+TEST_F(DeadlockTest, WokenThreadSwappedBackOut) {
+  ASSERT_TRUE(lock(t1, mutexA));
+  ASSERT_FALSE(lock(t2, mutexA));
+  EXPECT_FALSE(isScheduled(t2));
+
+  unlock(mutexA);
+  EXPECT_TRUE(t2->isMutexBlocked());
+  EXPECT_TRUE(isScheduled(t2));
+
+  // thread 3 runs first and takes the mutex
+  ASSERT_TRUE(lock(t3, mutexA));
+
+  // what the executor does when it schedules the woken thread
+  std::string errorMsg;
+  bool isBlocked;
+  bool isWaiting = state->mutexManager.isThreadWaiting(t2->threadId);
+  EXPECT_FALSE(isWaiting);
+  ASSERT_TRUE(state->mutexManager.tryToLockForBlockedThread(t2->threadId, isBlocked, errorMsg));
+  EXPECT_TRUE(isBlocked);
+  state->swapOutThread(t2, false, false, false, false);
+  EXPECT_FALSE(isScheduled(t2));
+  EXPECT_TRUE(state->mutexManager.isThreadWaiting(t2->threadId));
+
+  std::vector<Thread *> cycle;
+  EXPECT_FALSE(state->findDeadlock(t2, cycle));
+
+  // the next unlock wakes it again
+  unlock(mutexA);
+  EXPECT_TRUE(isScheduled(t2));
+  ASSERT_TRUE(state->mutexManager.tryToLockForBlockedThread(t2->threadId, isBlocked, errorMsg));
+  EXPECT_FALSE(isBlocked);
+  state->switchThreadToRunnable(t2);
+  EXPECT_TRUE(t2->isRunnable());
+}
+
+TEST_F(DeadlockTest, LockOrder) {
+  ASSERT_TRUE(lock(t1, mutexA));
+  ASSERT_TRUE(lock(t2, mutexB));
+  ASSERT_FALSE(lock(t1, mutexB));
+
+  std::vector<Thread *> cycle;
+  EXPECT_FALSE(state->findDeadlock(t1, cycle));
+
+  ASSERT_FALSE(lock(t2, mutexA));
+  ASSERT_TRUE(state->findDeadlock(t2, cycle));
+  ASSERT_EQ(2u, cycle.size());
+  EXPECT_EQ(t2, cycle[0]);
+  EXPECT_EQ(t1, cycle[1]);
+}
+
+TEST_F(DeadlockTest, JoinCycle) {
+  join(t2, t3);
+
+  std::vector<Thread *> cycle;
+  EXPECT_FALSE(state->findDeadlock(t2, cycle));
+
+  join(t3, t2);
+  ASSERT_TRUE(state->findDeadlock(t3, cycle));
+  ASSERT_EQ(2u, cycle.size());
+  EXPECT_EQ(t3, cycle[0]);
+  EXPECT_EQ(t2, cycle[1]);
+}
+
+TEST_F(DeadlockTest, MutexAndJoinCycle) {
+  ASSERT_TRUE(lock(t2, mutexA));
+  join(t2, t3);
+  ASSERT_FALSE(lock(t3, mutexA));
+
+  std::vector<Thread *> cycle;
+  ASSERT_TRUE(state->findDeadlock(t3, cycle));
+  ASSERT_EQ(2u, cycle.size());
+  EXPECT_EQ(t3, cycle[0]);
+  EXPECT_EQ(t2, cycle[1]);
+}
+
+TEST_F(DeadlockTest, ChainIntoOlderCycle) {
+  ASSERT_TRUE(lock(t1, mutexA));
+  ASSERT_TRUE(lock(t2, mutexB));
+  ASSERT_FALSE(lock(t1, mutexB));
+  ASSERT_FALSE(lock(t2, mutexA));
+
+  std::vector<Thread *> cycle;
+  ASSERT_TRUE(state->findDeadlock(t2, cycle));
+
+  // thread 3 waits for the cycle but is not part of it
+  ASSERT_FALSE(lock(t3, mutexA));
+  EXPECT_FALSE(state->findDeadlock(t3, cycle));
+}
+
+} // namespace
@@ -0,0 +1,125 @@
+#include "klee/Thread/CondManager.h"
+#include "klee/Thread/MutexManager.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+const uint64_t mutexAddress = 0x1000;
+const uint64_t condAddress = 0x2000;
+
+TEST(MutexManagerTest, WakeInFifoOrder) {
+  MutexManager manager;
+  std::string errorMsg;
+  bool isBlocked;
+  std::vector<unsigned> woken;
+
+  ASSERT_TRUE(manager.lock(mutexAddress, 1, isBlocked, errorMsg));
+  EXPECT_FALSE(isBlocked);
+  for (unsigned threadId : {3, 2, 4}) {
+    ASSERT_TRUE(manager.lock(mutexAddress, threadId, isBlocked, errorMsg));
+    EXPECT_TRUE(isBlocked);
+    EXPECT_TRUE(manager.isThreadWaiting(threadId));
+  }
+
+  // every unlock wakes the thread that waited longest, and only that one
+  for (unsigned threadId : {3, 2, 4}) {
+    ASSERT_TRUE(manager.unlock(mutexAddress, errorMsg));
+    manager.takeWokenThreads(woken);
+    ASSERT_EQ(1u, woken.size());
+    EXPECT_EQ(threadId, woken[0]);
+    EXPECT_FALSE(manager.isThreadWaiting(threadId));
+    ASSERT_TRUE(manager.tryToLockForBlockedThread(threadId, isBlocked, errorMsg));
+    EXPECT_FALSE(isBlocked);
+    EXPECT_EQ(threadId, manager.getMutex(mutexAddress)->getLockedThread());
+    EXPECT_EQ(nullptr, manager.getBlockingMutex(threadId));
+  }
+
+  ASSERT_TRUE(manager.unlock(mutexAddress, errorMsg));
+  manager.takeWokenThreads(woken);
+  EXPECT_TRUE(woken.empty());
+}
+
+TEST(MutexManagerTest, WokenThreadLosesRace) {
+  MutexManager manager;
+  std::string errorMsg;
+  bool isBlocked;
+  std::vector<unsigned> woken;
+
+  manager.lock(mutexAddress, 1, isBlocked, errorMsg);
+  manager.lock(mutexAddress, 2, isBlocked, errorMsg);
+  manager.lock(mutexAddress, 3, isBlocked, errorMsg);
+  manager.unlock(mutexAddress, errorMsg);
+  manager.takeWokenThreads(woken);
+  ASSERT_EQ(1u, woken.size());
+  ASSERT_EQ(2u, woken[0]);
+
+  // thread 4 takes the mutex before the woken thread gets to run
+  ASSERT_TRUE(manager.lock(mutexAddress, 4, isBlocked, errorMsg));
+  EXPECT_FALSE(isBlocked);
+
+  ASSERT_TRUE(manager.tryToLockForBlockedThread(2, isBlocked, errorMsg));
+  EXPECT_TRUE(isBlocked);
+  EXPECT_TRUE(manager.isThreadWaiting(2));
+
+  // it waits again behind the thread that kept waiting
+  manager.unlock(mutexAddress, errorMsg);
+  manager.takeWokenThreads(woken);
+  ASSERT_EQ(1u, woken.size());
+  EXPECT_EQ(3u, woken[0]);
+  manager.tryToLockForBlockedThread(3, isBlocked, errorMsg);
+  EXPECT_FALSE(isBlocked);
+  manager.unlock(mutexAddress, errorMsg);
+  manager.takeWokenThreads(woken);
+  ASSERT_EQ(1u, woken.size());
+  EXPECT_EQ(2u, woken[0]);
+}
+
+TEST(MutexManagerTest, CondWaitWakesMutexWaiter) {
+  MutexManager manager;
+  CondManager condManager(&manager);
+  std::string errorMsg;
+  bool isBlocked;
+  std::vector<unsigned> woken;
+
+  manager.lock(mutexAddress, 1, isBlocked, errorMsg);
+  manager.lock(mutexAddress, 2, isBlocked, errorMsg);
+  ASSERT_TRUE(isBlocked);
+
+  // waiting on the condition releases the mutex to the thread waiting on it
+  ASSERT_TRUE(condManager.wait(condAddress, mutexAddress, 1, errorMsg));
+  EXPECT_FALSE(manager.getMutex(mutexAddress)->isMutexLocked());
+  manager.takeWokenThreads(woken);
+  ASSERT_EQ(1u, woken.size());
+  EXPECT_EQ(2u, woken[0]);
+  manager.tryToLockForBlockedThread(2, isBlocked, errorMsg);
+  EXPECT_FALSE(isBlocked);
+
+  // the signalled thread has to take the mutex back before it runs
+  unsigned releasedThreadId;
+  ASSERT_TRUE(condManager.signal(condAddress, releasedThreadId, errorMsg));
+  EXPECT_EQ(1u, releasedThreadId);
+  EXPECT_EQ(manager.getMutex(mutexAddress), manager.getBlockingMutex(1));
+  manager.tryToLockForBlockedThread(1, isBlocked, errorMsg);
+  EXPECT_TRUE(isBlocked);
+  manager.unlock(mutexAddress, errorMsg);
+  manager.takeWokenThreads(woken);
+  ASSERT_EQ(1u, woken.size());
+  EXPECT_EQ(1u, woken[0]);
+}
+
+TEST(MutexManagerTest, CondWaitWithoutMutex) {
+  MutexManager manager;
+  CondManager condManager(&manager);
+  std::string errorMsg;
+
+  EXPECT_FALSE(condManager.wait(condAddress, mutexAddress, 1, errorMsg));
+  EXPECT_FALSE(errorMsg.empty());
+}
+
+} // namespace
@@ -0,0 +1,58 @@
+#include "klee/Thread/VectorClock.h"
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(VectorClockTest, Tick) {
+  VectorClock clock;
+  EXPECT_EQ(0u, clock.size());
+  EXPECT_EQ(0u, clock.get(3));
+  clock.tick(3);
+  clock.tick(3);
+  EXPECT_EQ(4u, clock.size());
+  EXPECT_EQ(2u, clock.get(3));
+  EXPECT_EQ(0u, clock.get(0));
+}
+
+TEST(VectorClockTest, Merge) {
+  VectorClock a, b;
+  a.tick(0);
+  a.tick(0);
+  b.tick(0);
+  b.tick(2);
+  a.merge(b);
+  EXPECT_EQ(3u, a.size());
+  EXPECT_EQ(2u, a.get(0));
+  EXPECT_EQ(0u, a.get(1));
+  EXPECT_EQ(1u, a.get(2));
+  // merging a shorter clock keeps the longer one
+  b.merge(a);
+  EXPECT_EQ(3u, b.size());
+  EXPECT_EQ(2u, b.get(0));
+}
+
+// thread 0 sends to thread 1, thread 2 runs on its own
+TEST(VectorClockTest, HappensBefore) {
+  VectorClock send, receive, other;
+  send.tick(0);
+  receive.tick(1);
+  receive.merge(send);
+  receive.tick(1);
+  other.tick(2);
+
+  EXPECT_TRUE(receive.dominates(send));
+  EXPECT_FALSE(send.dominates(receive));
+  EXPECT_FALSE(receive.dominates(other));
+  EXPECT_FALSE(other.dominates(receive));
+  // a clock does not happen before itself
+  EXPECT_FALSE(send.dominates(send));
+  // the trailing components of the longer clock count
+  VectorClock empty;
+  EXPECT_TRUE(other.dominates(empty));
+  EXPECT_FALSE(empty.dominates(other));
+}
+
+} // namespace